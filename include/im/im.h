@@ -81,7 +81,10 @@ typedef enum ImOrientationType {
   IM_ORIENTATION_UP    = 0 << 0,
   IM_ORIENTATION_DOWN  = 1 << 1,
   IM_ORIENTATION_LEFT  = 1 << 2,
-  IM_ORIENTATION_RIGHT = 1 << 3
+  IM_ORIENTATION_RIGHT = 1 << 3,
+
+  /* mirrored horizontally before rotation, EXIF orientations 2, 4, 5, 7 */
+  IM_ORIENTATION_MIRRORED = 1 << 4
 } ImOrientationType;
 
 /* same as CGImageAlphaInfo */
@@ -112,7 +115,10 @@ typedef enum ImFileFormatType {
   
   IM_FILEFORMATTYPE_HEIC,
   IM_FILEFORMATTYPE_JXL,
-  IM_FILEFORMATTYPE_JP2
+  IM_FILEFORMATTYPE_JP2,
+
+  IM_FILEFORMATTYPE_ICO,
+  IM_FILEFORMATTYPE_CUR
 } ImFileFormatType;
 
 typedef enum ImColorSpace {
@@ -201,6 +207,129 @@ typedef struct ImTimeStamp {
   uint8_t  second;
 } ImTimeStamp;
 
+typedef struct ImRational {
+  uint32_t num;
+  uint32_t den;
+} ImRational;
+
+/* EXIF (TIFF) metadata, strings are NUL-terminated copies */
+typedef struct ImExif {
+  char             *make;
+  char             *model;
+  char             *software;
+  char             *dateTime;
+  char             *dateTimeOriginal;
+  char             *artist;
+  char             *copyright;
+  ImRational        xResolution;
+  ImRational        yResolution;
+  ImRational        exposureTime;
+  ImRational        fNumber;
+  ImRational        focalLength;
+  uint32_t          pixelWidth;
+  uint32_t          pixelHeight;
+  uint16_t          resolutionUnit;
+  uint16_t          isoSpeed;
+  uint16_t          orientation;   /* 1-8 as in TIFF, 0: not present */
+
+  /* IFD1 JPEG thumbnail, points into ImImage.file, not a copy */
+  const ImByte     *thumbnail;
+  size_t            thumbnailSize;
+} ImExif;
+
+typedef enum ImJpegTransformType {
+  IM_JPEG_TRANSFORM_NONE       = 0, /* crop only                      */
+  IM_JPEG_TRANSFORM_FLIP_H     = 1, /* mirror left-right              */
+  IM_JPEG_TRANSFORM_FLIP_V     = 2, /* mirror top-bottom              */
+  IM_JPEG_TRANSFORM_TRANSPOSE  = 3, /* across top-left diagonal       */
+  IM_JPEG_TRANSFORM_TRANSVERSE = 4, /* across top-right diagonal      */
+  IM_JPEG_TRANSFORM_ROT_90     = 5, /* clockwise                      */
+  IM_JPEG_TRANSFORM_ROT_180    = 6,
+  IM_JPEG_TRANSFORM_ROT_270    = 7
+} ImJpegTransformType;
+
+/*
+ lossless JPEG transform. Crop rectangle is in output image, its origin is
+ rounded down to MCU boundary. Partial MCUs at edges that would move to the
+ top or left are trimmed, as jpegtran -trim does.
+ */
+typedef struct ImJpegTransform {
+  ImJpegTransformType type;
+  uint32_t            cropX;
+  uint32_t            cropY;
+  uint32_t            cropWidth;  /* 0: to right edge  */
+  uint32_t            cropHeight; /* 0: to bottom edge */
+  bool                optimizeHuffman;
+} ImJpegTransform;
+
+/* quantized DCT coefficients of one component */
+typedef struct ImJpegCoefPlane {
+  int16_t  *coef;       /* blocksWide * blocksHigh blocks, row major      */
+  uint16_t  quant[64];  /* zig-zag order, coef * quant is dequantized     */
+  uint32_t  id;         /* component identifier in frame header           */
+  uint32_t  H;          /* sampling factors                               */
+  uint32_t  V;
+  uint32_t  blocksWide; /* blocks inside the image, no MCU padding        */
+  uint32_t  blocksHigh;
+} ImJpegCoefPlane;
+
+/*
+ entropy decoded coefficients, nothing is reconstructed. Each block keeps its
+ first `count` coefficients in zig-zag order, DC first.
+ */
+typedef struct ImJpegCoefs {
+  uint32_t        width;
+  uint32_t        height;
+  uint32_t        count;
+  uint32_t        componentCount;
+  ImJpegCoefPlane comp[4];
+} ImJpegCoefs;
+
+typedef enum ImJpegSubsampling {
+  IM_JPEG_SUBSAMPLING_420 = 0,
+  IM_JPEG_SUBSAMPLING_422 = 1,
+  IM_JPEG_SUBSAMPLING_444 = 2
+} ImJpegSubsampling;
+
+/*
+ baseline encoder options, zero initialized struct is quality 75 at 4:2:0.
+ Restart intervals are encoded in parallel, so restartRows > 0 also lets the
+ encoder use more than one thread.
+ */
+typedef struct ImJpegEncode {
+  uint32_t          quality;     /* 1 - 100, 0: 75                         */
+  ImJpegSubsampling subsampling; /* ignored for gray images                */
+  uint32_t          restartRows; /* MCU rows per restart interval, 0: none */
+  bool              optimizeHuffman;
+} ImJpegEncode;
+
+/* decoder state that is kept between frames, see im_jpeg_stream_new() */
+typedef struct ImJpegStream ImJpegStream;
+
+typedef enum ImPlanarLayout {
+  IM_PLANAR_NONE = 0, /* interleaved pixels                            */
+  IM_PLANAR_YUV  = 1, /* Y, Cb, Cr planes at native subsampling e.g. I420 */
+  IM_PLANAR_NV12 = 2  /* Y plane then one plane of interleaved Cb, Cr    */
+} ImPlanarLayout;
+
+/* how components of bitsPerComponent bits are stored */
+typedef enum ImSampleType {
+  IM_SAMPLE_UINT  = 0, /* unsigned integer, default         */
+  IM_SAMPLE_HALF  = 1  /* IEEE 754 half float, 16-bit only  */
+} ImSampleType;
+
+/*
+ plane inside ImImage.data, offset and stride are in bytes. When planar is
+ set, bytesPerPixel is size of one sample in a plane and bitsPerPixel is the
+ average over all planes e.g. 12 for 4:2:0, use planes[] to address samples.
+ */
+typedef struct ImPlane {
+  size_t   offset;
+  uint32_t width;
+  uint32_t height;
+  uint32_t stride;
+} ImPlane;
+
 typedef struct ImImage {
   ImFileResult      file;
   ImImageData       data;
@@ -211,22 +340,35 @@ typedef struct ImImage {
   uint32_t          bitsPerPixel;
   uint32_t          bitsPerComponent;
   uint32_t          componentsPerPixel;
+  ImSampleType      sampleType;
   uint32_t          hres;
   uint32_t          vres;
   ImFormat          format; /* Pixel layout (RGB, RGBA, etc.) */
   ImOrientationType ori;
+  ImPlanarLayout    planar;
+  uint32_t          planeCount;
+  ImPlane           planes[3];
   ImAlphaInfo       alphaInfo;
   ImFileFormatType  fileFormatType;
   ImByteOrder       byteOrder;
   ImOpenIntent      openIntent;
   uint32_t          row_pad_last;
 
+  /*
+   bytes from start of a row to the next one, 0: not set. Negative when data
+   is a bottom-up view into file, then data points to the top row and rows
+   are not contiguous in increasing addresses, see IM_OPTION_TOP_DOWN_ROWS
+   */
+  int32_t           rowStride;
+
   ImColorSpace      colorSpace;
 
   /* Monochrome color table (between 0-255),
-     Default: BLACK and WHITE
+     Default: BLACK and WHITE. 1bpp sources are expanded through it, packed
+     bit values index it
    */
   ImByte            monochrome_colors[2];
+  ImBitOrder        bitOrder; /* packed 1bpp only, see IM_OPTION_PACKED_BITS */
   im_pal_t         *pal;
 
   /* Some PNG ancillary chunks but can be used with other formats too  */
@@ -242,6 +384,7 @@ typedef struct ImImage {
   size_t            iccProfileSize;
   ImPhysicalDim    *physicalDim;
   ImTimeStamp      *timeStamp;
+  ImExif           *exif;
 } ImImage;
 
 IM_EXPORT
@@ -255,6 +398,84 @@ im_load(ImImage         ** __restrict dest,
         im_option_base_t *            options[],
         ImOpenIntent                  openIntent);
 
+/*
+ decodes embedded EXIF thumbnail of a loaded image without touching the main
+ image data, use IM_OPTION_JPEG_METADATA_ONLY to load the source cheaply.
+ */
+IM_EXPORT
+ImResult
+im_load_thumbnail(ImImage         ** __restrict dest,
+                  ImImage          * __restrict im,
+                  im_option_base_t *            options[]);
+
+/* result is allocated with malloc(), release it with free() */
+IM_EXPORT
+ImResult
+im_jpeg_transform(ImByte               ** __restrict dest,
+                  size_t                * __restrict destSize,
+                  const char            * __restrict path,
+                  const ImJpegTransform * __restrict tr);
+
+IM_EXPORT
+ImResult
+im_jpeg_transform_mem(ImByte               ** __restrict dest,
+                      size_t                * __restrict destSize,
+                      const ImByte          * __restrict raw,
+                      size_t                             size,
+                      const ImJpegTransform * __restrict tr);
+
+/*
+ result is one allocation, release it with free(). Takes IM_OPTION_JPEG_*
+ options, IM_OPTION_JPEG_COEF_COUNT limits coefficients per block. Progressive
+ scans above that band are not decoded at all.
+ */
+IM_EXPORT
+ImResult
+im_jpeg_coefs(ImJpegCoefs     ** __restrict dest,
+              const char       * __restrict path,
+              im_option_base_t *            options[]);
+
+IM_EXPORT
+ImResult
+im_jpeg_coefs_mem(ImJpegCoefs     ** __restrict dest,
+                  const ImByte     * __restrict raw,
+                  size_t                        size,
+                  im_option_base_t *            options[]);
+
+/*
+ 8-bit GRAY, RGB, BGR (with alpha or padding) or YCbCr source. opt may be
+ NULL for defaults. Result is allocated with malloc(), release it with free().
+ */
+IM_EXPORT
+ImResult
+im_jpeg_encode(ImByte            ** __restrict dest,
+               size_t             * __restrict destSize,
+               const ImImage      * __restrict im,
+               const ImJpegEncode * __restrict opt);
+
+/*
+ Motion-JPEG and other frame sequences. Tables of a frame stay installed for
+ following frames, frames without DHT use Annex K tables. Frames are decoded
+ on caller's thread, returned image belongs to stream and is valid until
+ next frame. A tables-only frame returns IM_OK with *dest set to NULL. A
+ truncated, corrupt or unsupported frame returns IM_ERR with *dest set to
+ NULL, tables it defined before the error stay installed.
+ */
+IM_EXPORT
+ImJpegStream*
+im_jpeg_stream_new(im_option_base_t *options[]);
+
+IM_EXPORT
+ImResult
+im_jpeg_stream_decode(ImJpegStream  * __restrict stream,
+                      ImImage      ** __restrict dest,
+                      const ImByte  * __restrict raw,
+                      size_t                     size);
+
+IM_EXPORT
+void
+im_jpeg_stream_free(ImJpegStream *stream);
+
 IM_EXPORT
 ImImage*
 im_load_hex(const char * __restrict hexdata);
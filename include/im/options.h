@@ -29,10 +29,30 @@ typedef enum ImByteOrder {
   IM_BYTEORDER_ANY     = 3
 } ImByteOrder;
 
+/* IM_OPTION_BMP_SKIPPED_MODE, pixels RLE delta / end of line escapes skip */
+typedef enum ImBmpSkippedMode {
+  IM_BMP_SKIPPED_BLACK       = 0, /* default */
+  IM_BMP_SKIPPED_TRANSPARENT = 1, /* image is BGRA, skipped alpha is 0 */
+  IM_BMP_SKIPPED_INDEX0      = 2  /* palette color 0                   */
+} ImBmpSkippedMode;
+
+/* IM_OPTION_BMP_64BPP, output of 64bpp s2.13 images, both are linear BGRA */
+typedef enum ImBmp64Mode {
+  IM_BMP64_HALF   = 0, /* default, IEEE half float, out of 0 - 1 is kept */
+  IM_BMP64_UINT16 = 1  /* clamped to 0 - 1, scaled to 0 - 65535          */
+} ImBmp64Mode;
+
+/* IM_OPTION_PACKED_BITS, layout of 1bpp images */
+typedef enum ImBitOrder {
+  IM_BITORDER_NONE = 0, /* default, a byte per pixel                     */
+  IM_BITORDER_MSB  = 1, /* 8 pixels per byte, first pixel in highest bit */
+  IM_BITORDER_LSB  = 2  /* 8 pixels per byte, first pixel in lowest bit  */
+} ImBitOrder;
+
 typedef enum im_option_type_t {
   IM_OPTION_ROW_PAD_LAST           = 0,
   IM_OPTION_SUPPORTED_FORMATS      = 1,
-  IM_OPTION_SUPPORTED_ORIENTATIONS = 2,
+  IM_OPTION_SUPPORTED_ORIENTATIONS = 2, /* none, uint ImOrientationType bits */
   IM_OPTION_SUPPORTED_COMPRESSIONS = 3,
   IM_OPTION_USE_MMAP_FOR_WINDOWS   = 4,
   IM_OPTION_BYTE_ORDER             = 5, /* any  */
@@ -43,10 +63,65 @@ typedef enum im_option_type_t {
    from bmpsuite:
    Some viewers make undefined pixels transparent, others make them black,
    and others assign them palette color 0 (purple, in this case).
-   
-   STATUS: TODO.
+
+   uint, ImBmpSkippedMode
    */
   IM_OPTION_BMP_SKIPPED_MODE,
+
+  /* JPEG: MCU rows buffered between entropy decoding and reconstruction */
+  IM_OPTION_JPEG_PIPELINE_DEPTH,
+
+  /* JPEG: stop after first N scans of a progressive image, 0: all scans */
+  IM_OPTION_JPEG_MAX_SCANS,
+
+  /* JPEG: reconstruct and report image after each progressive scan */
+  IM_OPTION_JPEG_PREVIEW,
+
+  /* JPEG: decode at 1/N size in DCT domain, N is 1, 2, 4 or 8 */
+  IM_OPTION_JPEG_SCALE_DENOM,
+
+  /* JPEG: parse headers, size and EXIF only, no pixel data is decoded */
+  IM_OPTION_JPEG_METADATA_ONLY,
+
+  /* JPEG: ImPlanarLayout, YCbCr planes straight from IDCT, no conversion */
+  IM_OPTION_JPEG_PLANAR,
+
+  /* JPEG: CMYK / YCCK to RGB with fast approximation, no color management */
+  IM_OPTION_JPEG_CMYK_TO_RGB,
+
+  /* JPEG: im_jpeg_coefs() keeps first N zig-zag coefficients, 0: all 64 */
+  IM_OPTION_JPEG_COEF_COUNT,
+
+  /*
+   BMP: 2 - 8bpp images are 8-bit palette indices, BGR palette is attached
+   to ImImage::pal. Needs IM_OPTION_SUPPORTS_PALETTE, ignored with
+   IM_BMP_SKIPPED_TRANSPARENT. Default: false
+   */
+  IM_OPTION_BMP_PALETTE_INDICES,
+
+  /*
+   BMP, TGA: bottom-up images are decoded straight into top-down rows and
+   reported as IM_ORIENTATION_UP. Images that would point into the file are
+   a view with negative ImImage::rowStride instead. Default: false
+   */
+  IM_OPTION_TOP_DOWN_ROWS,
+
+  /*
+   ICO, CUR: uint, edge in pixels of wanted image. Smallest entry that is not
+   smaller is decoded, otherwise largest one; 0: largest. Only that entry is
+   decoded
+   */
+  IM_OPTION_ICO_SIZE,
+
+  /* BMP: uint, ImBmp64Mode. 16-bit components are in host byte order */
+  IM_OPTION_BMP_64BPP,
+
+  /*
+   PBM, BMP: uint, ImBitOrder. 1bpp images are kept packed, format is
+   IM_FORMAT_BLACKWHITE and bit values index ImImage::monochrome_colors. Bits
+   past width of a row are undefined. Default: IM_BITORDER_NONE
+   */
+  IM_OPTION_PACKED_BITS,
 } im_option_type_t;
 
 typedef struct im_option_base_t {
@@ -65,6 +140,25 @@ typedef struct im_option_rowpadding_t {
   uint32_t         pad;
 } im_option_rowpadding_t;
 
+typedef struct im_option_uint_t {
+  im_option_base_t base;
+  uint32_t         value;
+} im_option_uint_t;
+
+/*
+ called from decoder thread with partially decoded image, image is valid only
+ during the call. Return false to stop decoding, the last preview is returned.
+ */
+struct ImImage;
+
+typedef bool (*ImPreviewFunc)(struct ImImage *im, uint32_t nscans, void *obj);
+
+typedef struct im_option_preview_t {
+  im_option_base_t base;
+  ImPreviewFunc    func;
+  void            *obj;
+} im_option_preview_t;
+
 typedef struct im_option_byteorder_t {
   im_option_base_t base;
   ImByteOrder      order;
@@ -92,6 +186,29 @@ im_option_bool(im_option_type_t optype, bool on) {
   return opt;
 }
 
+IM_INLINE
+im_option_uint_t
+im_option_uint(im_option_type_t optype, uint32_t value) {
+  im_option_uint_t opt;
+
+  opt.base.type = optype;
+  opt.value     = value;
+
+  return opt;
+}
+
+IM_INLINE
+im_option_preview_t
+im_option_preview(ImPreviewFunc func, void *obj) {
+  im_option_preview_t opt;
+
+  opt.base.type = IM_OPTION_JPEG_PREVIEW;
+  opt.func      = func;
+  opt.obj       = obj;
+
+  return opt;
+}
+
 IM_INLINE
 im_option_byteorder_t
 im_option_row_byteorder(ImByteOrder order) {
@@ -49,6 +49,13 @@
 #  endif
 #endif
 
+#if defined(__SSSE3__)
+#  include <tmmintrin.h>
+#  ifndef IM_SIMD_x86
+#    define IM_SIMD_x86
+#  endif
+#endif
+
 #if defined(__SSE4_1__)
 #  include <smmintrin.h>
 #  ifndef IM_SIMD_x86
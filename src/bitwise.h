@@ -39,6 +39,40 @@ im_bitw_ctz(uint32_t x) {
 #endif
 }
 
+IM_INLINE
+uint32_t
+im_bitw_ctz64(uint64_t x) {
+#if __has_builtin(__builtin_ctzll)
+  return __builtin_ctzll(x);
+#else
+  uint32_t i;
+
+  i = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+IM_INLINE
+uint32_t
+im_bitw_clz64(uint64_t x) {
+#if __has_builtin(__builtin_clzll)
+  return __builtin_clzll(x);
+#else
+  uint32_t i;
+
+  i = 0;
+  while (!(x & (1ULL << 63))) {
+    x <<= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
 IM_INLINE
 uint32_t
 im_bitw_ffs(uint32_t x) {
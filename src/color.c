@@ -46,3 +46,285 @@ im_YCbCrToRGB(ImByte * __restrict src, uint32_t width, uint32_t height) {
     p += 3;
   }
 }
+
+IM_EXPORT
+void
+im_YCCKToCMYK(ImByte * __restrict src, uint32_t width, uint32_t height) {
+  ImByte  *p;
+  size_t   i, npixels;
+  float    Y, Cb, Cr;
+  int      R, G, B;
+
+  p       = src;
+  npixels = (size_t)width * height;
+  i       = 0;
+
+#if defined(__SSE2__)
+  {
+    __m128i v, m, r, g, b, k;
+    __m128  y, cb, cr, c128, zero, c255;
+
+    m    = _mm_set1_epi32(0xFF);
+    c128 = _mm_set1_ps(128.0f);
+    c255 = _mm_set1_ps(255.0f);
+    zero = _mm_setzero_ps();
+
+    /* 4 pixels, one pixel per 32-bit lane */
+    for (; i + 4 <= npixels; i += 4, p += 16) {
+      v  = _mm_loadu_si128((__m128i *)p);
+      y  = _mm_cvtepi32_ps(_mm_and_si128(v, m));
+      cb = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 8),  m));
+      cr = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 16), m));
+      cb = _mm_sub_ps(cb, c128);
+      cr = _mm_sub_ps(cr, c128);
+
+      r  = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(
+             _mm_add_ps(y, _mm_mul_ps(cr, _mm_set1_ps(1.402f))),
+             zero), c255));
+      g  = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(
+             _mm_sub_ps(_mm_sub_ps(y, _mm_mul_ps(cb, _mm_set1_ps(0.344136f))),
+                        _mm_mul_ps(cr, _mm_set1_ps(0.714136f))),
+             zero), c255));
+      b  = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(
+             _mm_add_ps(y, _mm_mul_ps(cb, _mm_set1_ps(1.772f))),
+             zero), c255));
+      k  = _mm_xor_si128(_mm_srli_epi32(v, 24), m);
+
+      /* YCbCr part encodes inverted CMY: C = 255 - (255 - R) */
+      v  = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                        _mm_or_si128(_mm_slli_epi32(b, 16),
+                                     _mm_slli_epi32(k, 24)));
+      _mm_storeu_si128((__m128i *)p, v);
+    }
+  }
+#endif
+
+  for (; i < npixels; i++, p += 4) {
+    Y    = p[0];
+    Cb   = p[1] - 128.0f;
+    Cr   = p[2] - 128.0f;
+
+    R    = im_clamp_i32(Y + 1.402f * Cr, 0, 255);
+    G    = im_clamp_i32(Y - 0.344136f * Cb - 0.714136f * Cr, 0, 255);
+    B    = im_clamp_i32(Y + 1.772f * Cb, 0, 255);
+
+    p[0] = R;
+    p[1] = G;
+    p[2] = B;
+    p[3] = 255 - p[3];
+  }
+}
+
+IM_EXPORT
+void
+im_CMYKInvert(ImByte * __restrict src, size_t len) {
+  size_t i;
+
+  i = 0;
+
+#if defined(__SSE2__)
+  {
+    __m128i ones;
+
+    ones = _mm_set1_epi8((char)0xFF);
+    for (; i + 16 <= len; i += 16) {
+      _mm_storeu_si128((__m128i *)(src + i),
+                       _mm_xor_si128(_mm_loadu_si128((__m128i *)(src + i)),
+                                     ones));
+    }
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= len; i += 16)
+    vst1q_u8(src + i, vmvnq_u8(vld1q_u8(src + i)));
+#endif
+
+  for (; i < len; i++)
+    src[i] = ~src[i];
+}
+
+IM_EXPORT
+void
+im_CMYKToRGB(ImByte * __restrict src,
+             uint32_t            width,
+             uint32_t            height,
+             bool                inverted) {
+  ImByte  *p, *d;
+  size_t   i, npixels;
+  uint32_t c, m, y, k, inv;
+
+  p       = src;
+  d       = src;
+  npixels = (size_t)width * height;
+  inv     = inverted ? 0 : 0xFF; /* work on 255 - ink */
+  i       = 0;
+
+#if defined(__SSE2__)
+  {
+    __m128i v, lo, hi, klo, khi, zero, c128, flip;
+    uint32_t px[4];
+
+    zero = _mm_setzero_si128();
+    c128 = _mm_set1_epi16(128);
+    flip = _mm_set1_epi8((char)inv);
+
+    /* destination never passes source: 12 bytes out per 16 bytes in */
+    for (; i + 4 <= npixels; i += 4, p += 16, d += 12) {
+      v   = _mm_xor_si128(_mm_loadu_si128((__m128i *)p), flip);
+      lo  = _mm_unpacklo_epi8(v, zero);
+      hi  = _mm_unpackhi_epi8(v, zero);
+      klo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+      khi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+
+      /* x * k / 255, rounded: t = x * k + 128, (t + (t >> 8)) >> 8 */
+      lo  = _mm_add_epi16(_mm_mullo_epi16(lo, klo), c128);
+      hi  = _mm_add_epi16(_mm_mullo_epi16(hi, khi), c128);
+      lo  = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+      hi  = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+      _mm_storeu_si128((__m128i *)px, _mm_packus_epi16(lo, hi));
+
+      /* 4 byte stores overlap, 4th byte of each is overwritten by next one,
+         last one lands on already consumed source */
+      memcpy(d,     &px[0], 4);
+      memcpy(d + 3, &px[1], 4);
+      memcpy(d + 6, &px[2], 4);
+      memcpy(d + 9, &px[3], 4);
+    }
+  }
+#endif
+
+  for (; i < npixels; i++, p += 4, d += 3) {
+    c    = p[0] ^ inv;
+    m    = p[1] ^ inv;
+    y    = p[2] ^ inv;
+    k    = p[3] ^ inv;
+
+    c    = c * k + 128;
+    m    = m * k + 128;
+    y    = y * k + 128;
+
+    d[0] = (c + (c >> 8)) >> 8;
+    d[1] = (m + (m >> 8)) >> 8;
+    d[2] = (y + (y >> 8)) >> 8;
+  }
+}
+
+IM_HIDE
+void
+im_bits_expand(const ImByte * __restrict src,
+               ImByte       * __restrict dst,
+               uint32_t                  width,
+               const ImByte              colors[2]) {
+  uint32_t x, b;
+  ImByte   c0, cx;
+
+  c0 = colors[0];
+  cx = colors[0] ^ colors[1];
+  x  = 0;
+
+#if defined(__SSE2__)
+  {
+    __m128i v, w, q0, q1, bit, vc0, vcx;
+    __m128i q[4];
+    int     k;
+
+    /* 8 source bytes are spread to 64 lanes, lane i tests bit 7 - i % 8 */
+    bit = _mm_set1_epi64x((long long)0x0102040810204080ULL);
+    vc0 = _mm_set1_epi8((char)c0);
+    vcx = _mm_set1_epi8((char)cx);
+
+    for (; x + 64 <= width; x += 64, src += 8, dst += 64) {
+      v    = _mm_loadl_epi64((const __m128i *)src);
+      v    = _mm_unpacklo_epi8(v, v);
+      w    = _mm_unpacklo_epi16(v, v);
+      v    = _mm_unpackhi_epi16(v, v);
+      q[0] = _mm_unpacklo_epi32(w, w);
+      q[1] = _mm_unpackhi_epi32(w, w);
+      q[2] = _mm_unpacklo_epi32(v, v);
+      q[3] = _mm_unpackhi_epi32(v, v);
+
+      for (k = 0; k < 4; k++) {
+        q0 = _mm_cmpeq_epi8(_mm_and_si128(q[k], bit), bit);
+        q1 = _mm_xor_si128(vc0, _mm_and_si128(q0, vcx));
+        _mm_storeu_si128((__m128i *)(dst + k * 16), q1);
+      }
+    }
+  }
+#elif defined(__ARM_NEON)
+  {
+    static const uint8_t bits[16] = {
+      0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+      0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+    };
+    uint8x16_t bit, vc0, vcx, m;
+    int        k;
+
+    bit = vld1q_u8(bits);
+    vc0 = vdupq_n_u8(c0);
+    vcx = vdupq_n_u8(cx);
+
+    for (; x + 64 <= width; x += 64, src += 8, dst += 64) {
+      for (k = 0; k < 4; k++) {
+        m = vtstq_u8(vcombine_u8(vdup_n_u8(src[k * 2]),
+                                 vdup_n_u8(src[k * 2 + 1])), bit);
+        vst1q_u8(dst + k * 16, veorq_u8(vc0, vandq_u8(m, vcx)));
+      }
+    }
+  }
+#endif
+
+  for (; x + 8 <= width; x += 8, dst += 8) {
+    b      = *src++;
+    dst[0] = c0 ^ (cx & -(ImByte)((b >> 7) & 1));
+    dst[1] = c0 ^ (cx & -(ImByte)((b >> 6) & 1));
+    dst[2] = c0 ^ (cx & -(ImByte)((b >> 5) & 1));
+    dst[3] = c0 ^ (cx & -(ImByte)((b >> 4) & 1));
+    dst[4] = c0 ^ (cx & -(ImByte)((b >> 3) & 1));
+    dst[5] = c0 ^ (cx & -(ImByte)((b >> 2) & 1));
+    dst[6] = c0 ^ (cx & -(ImByte)((b >> 1) & 1));
+    dst[7] = c0 ^ (cx & -(ImByte)(b & 1));
+  }
+
+  for (b = 0; x < width; x++, b++)
+    *dst++ = colors[(*src >> (7 - b)) & 1];
+}
+
+IM_HIDE
+void
+im_bits_reverse(const ImByte * __restrict src,
+                ImByte       * __restrict dst,
+                size_t                    len) {
+  size_t i;
+  ImByte b;
+
+  i = 0;
+
+#if defined(__SSSE3__)
+  {
+    __m128i lut, lo, hi, m4, v;
+
+    /* nibbles are reversed by table and swapped */
+    lut = _mm_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+                        0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+    m4  = _mm_set1_epi8(0x0F);
+
+    for (; i + 16 <= len; i += 16) {
+      v  = _mm_loadu_si128((const __m128i *)(src + i));
+      lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, m4));
+      hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), m4));
+      _mm_storeu_si128((__m128i *)(dst + i),
+                       _mm_or_si128(_mm_slli_epi16(lo, 4), hi));
+    }
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= len; i += 16)
+    vst1q_u8(dst + i, vrbitq_u8(vld1q_u8(src + i)));
+#endif
+
+  for (; i < len; i++) {
+    b      = src[i];
+    b      = (ImByte)((b & 0xF0) >> 4 | (b & 0x0F) << 4);
+    b      = (ImByte)((b & 0xCC) >> 2 | (b & 0x33) << 2);
+    dst[i] = (ImByte)((b & 0xAA) >> 1 | (b & 0x55) << 1);
+  }
+}
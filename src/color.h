@@ -23,6 +23,45 @@ IM_EXPORT
 void
 im_YCbCrToRGB(ImByte * __restrict src, uint32_t width, uint32_t height);
 
+/* Adobe YCCK to plain CMYK (0: no ink), in place */
+IM_EXPORT
+void
+im_YCCKToCMYK(ImByte * __restrict src, uint32_t width, uint32_t height);
+
+/* inverted (Adobe) CMYK to plain CMYK or back, len is in bytes */
+IM_EXPORT
+void
+im_CMYKInvert(ImByte * __restrict src, size_t len);
+
+/*
+ CMYK to RGB without color management: R = (1 - C) * (1 - K) and so on. Output
+ is packed to 3 bytes per pixel in place
+ */
+IM_EXPORT
+void
+im_CMYKToRGB(ImByte * __restrict src,
+             uint32_t            width,
+             uint32_t            height,
+             bool                inverted);
+
+/*
+ 1bpp rows, first pixel in high bit: a byte per pixel from colors[bit].
+ Bits past width are not read
+ */
+IM_HIDE
+void
+im_bits_expand(const ImByte * __restrict src,
+               ImByte       * __restrict dst,
+               uint32_t                  width,
+               const ImByte              colors[2]);
+
+/* reverses bit order of each byte, MSB first to LSB first or back */
+IM_HIDE
+void
+im_bits_reverse(const ImByte * __restrict src,
+                ImByte       * __restrict dst,
+                size_t                    len);
+
 IM_INLINE
 void
 im_YCbCrToRGB_8x8(ImByte blk[3][64], ImByte * __restrict dest) {
@@ -23,11 +23,13 @@
 #include "endian.h"
 #include "bitwise.h"
 #include "thread/thread.h"
+#include "thread/ring.h"
 #include "mm/mmap.h"
 #include "arch/intrin.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <setjmp.h>
 #include <math.h>
 
 #define IM_ARRAY_LEN(ARR) (sizeof(ARR) / sizeof(ARR[0]))
@@ -69,6 +71,22 @@ typedef struct im_open_config_t {
   bool              supportsPal;
   bool              releaseFile;
   bool              bgr2rgb;
+  uint32_t          pipelineDepth;
+  uint32_t          maxScans;
+  uint32_t          scaleDenom;
+  bool              metadataOnly;
+  uint32_t          planar;       /* ImPlanarLayout                        */
+  uint32_t          supportedOri; /* ImOrientationType bits caller applies */
+  bool              cmykToRGB;
+  uint32_t          coefCount;    /* zig-zag coefficients kept, 0: all     */
+  uint32_t          bmpSkipped;   /* ImBmpSkippedMode                      */
+  bool              bmpIndices;   /* keep BMP palette indices              */
+  bool              topDown;      /* bottom-up rows are written top-down   */
+  uint32_t          icoSize;      /* wanted ICO / CUR edge, 0: largest     */
+  uint32_t          bmp64;        /* ImBmp64Mode                           */
+  uint32_t          packedBits;   /* ImBitOrder, 1bpp layout               */
+  ImPreviewFunc     preview;
+  void             *previewObj;
   im_option_base_t **options;
 } im_open_config_t;
 
@@ -81,6 +99,7 @@ typedef struct ImHuffTbl {
   IM_ALIGN(16) uint8_t  huffval[256];
   IM_ALIGN(16) int32_t  maxcode[16];
   IM_ALIGN(16) int32_t  delta[16]; /* VALPTR(I) - MINCODE(I) */
+  uint8_t               bits[16];  /* BITS as in DHT, kept for re-encoding */
   bool                  valid;
 } ImHuffTbl;
 
@@ -97,6 +116,8 @@ typedef struct ImSampleFactor {
 typedef struct ImComponent {
   int32_t        id;
   int32_t        Tq;
+  int32_t        Td;  /* tables of last scan that coded the component */
+  int32_t        Ta;
   ImSampleFactor sf;
 } ImComponent;
 
@@ -117,22 +138,16 @@ typedef struct ImFrm {
   uint8_t       vmax;
   ImComponent   compo[256];
   uint8_t       samp[4];
+  bool          progressive;
 } ImFrm;
 
-typedef struct ImBlockComponent {
-  int16_t         blk[64];
-} ImBlockComponent;
-
-typedef struct ImThreadedBlock {
-  ImBlockComponent blk[4][4][4]; /* RGB, CMYK for 4 samplers */
-  ImSampleFactor   sf[4];
-  th_thread_mutex  mutex;
-  int32_t          mcuy;
-  int32_t          mcux;
-  int8_t           xi;
-  int8_t           yi;
-  bool             avail;
-} ImThreadedBlock;
+/* one MCU row of reconstructed samples, a plane per frame component */
+typedef struct ImJpegRow {
+  ImByte  *comp[4];
+  uint32_t stride[4];
+  ImByte  *pix;      /* interleaved pixels when orientation is applied */
+  int32_t  mcuy;
+} ImJpegRow;
 
 typedef struct ImScan {
   struct ImJpeg  *jpg;
@@ -151,6 +166,9 @@ typedef struct ImScan {
   uint8_t  offword;
   int32_t  cnt;
   uint8_t  b;
+  uint32_t eobrun;
+  bool     spec; /* worker thread, stop at markers instead of exit         */
+  bool     eos;  /* worker has reached a marker or end of data           */
   ImByte  *pRaw;
 } ImScan;
 
@@ -168,6 +186,16 @@ typedef enum ImJpegResult {
   IM_JPEG_INVALID_COMPONENT_COUNT_IN_SCAN = 3
 } ImJpegResult;
 
+/* color model of decoded samples, picks conversion at reconstruction */
+typedef enum ImJpegColor {
+  IM_JPEG_COLOR_GRAY  = 0,
+  IM_JPEG_COLOR_YCbCr = 1,
+  IM_JPEG_COLOR_RGB   = 2,
+  IM_JPEG_COLOR_CMYK  = 3, /* plain CMYK, 0: no ink       */
+  IM_JPEG_COLOR_CMYKI = 4, /* Adobe CMYK, stored inverted */
+  IM_JPEG_COLOR_YCCK  = 5  /* Adobe YCbCr + inverted K    */
+} ImJpegColor;
+
 typedef struct ImJpeg {
   ImQuantTbl        dqt[4];
   ImHuffTbl         dht[2][4]; /* class | table */
@@ -176,17 +204,45 @@ typedef struct ImJpeg {
   ImImage          *im;
   ImComment        *comments;
   ImJpegResult      result;
-  th_thread_cond    cond;
-  th_thread_cond    dec_cond;
-  th_thread_mutex   wrkmutex;
-  th_thread_mutex   decmutex;
+  ImByte           *pRawEnd;   /* end of mapped file                */
   uint32_t          nScans;
+  uint32_t          ri;        /* restart interval in MCUs, 0: none */
+  uint32_t          dctSize;   /* output samples per block side     */
   bool              failed;
-  
-  ImThreadedBlock   blkpool[3];
-  int               dec_index;
-  int               wrk_index;
-  int               avail_index;
+
+  /* APP0 / APP14 seen, Adobe transform: 0 RGB or CMYK, 1 YCbCr, 2 YCCK */
+  bool              jfif;
+  bool              adobe;
+  uint8_t           adobeTransform;
+  ImJpegColor       color;
+  uint8_t           ncomp;     /* output samples per pixel          */
+
+  /* EXIF orientation applied at writeout, pixel (x, y) of decoded frame goes
+     to orgn + x * ox + y * oy in the image */
+  uint32_t          width;     /* decoded size before orientation   */
+  uint32_t          height;
+  uint8_t           orient;    /* 1: as stored                      */
+  ptrdiff_t         orgn;
+  ptrdiff_t         ox;
+  ptrdiff_t         oy;
+
+  /* entropy decoding -> reconstruction handoff */
+  th_ring           ring;
+  ImJpegRow        *rows;
+  ImByte           *rowbuf;
+  size_t            rowcap;    /* bytes allocated for rowbuf        */
+  uint32_t          nrows;
+
+  /* set: decoding runs on caller's thread, rows are reconstructed in place
+     and jpg_dec_exit() jumps back here */
+  jmp_buf          *unwind;
+
+  /* coefficients of whole frame for progressive and non-interleaved scans */
+  im_open_config_t *conf;
+  int16_t          *coef[4];
+  uint32_t          coefScans;
+  bool              coefDirty;
+  bool              coefOnly;  /* keep coefficients, no pixels        */
 } ImJpeg;
 
 IM_INLINE
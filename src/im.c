@@ -31,6 +31,9 @@
 #include "sampler.h"
 
 #include "io/jpg/dec/dec.h"
+#include "io/jpg/trans.h"
+#include "io/jpg/coefs.h"
+#include "io/jpg/enc/enc.h"
 #include "io/apple/coreimg.h"
 #include "io/ppm/ppm.h"
 #include "io/ppm/pgm.h"
@@ -41,6 +44,7 @@
 #include "io/bmp/dib.h"
 #include "io/png/png.h"
 #include "io/tga/tga.h"
+#include "io/ico/ico.h"
 #include "io/qoi/qoi.h"
 #include "io/heic/heic.h"
 #include "io/jxl/jxl.h"
@@ -131,6 +135,7 @@ static const imloader extmap[256] = {
   [0x3C] = pbm_dec,         /* pbm  */
   [0x54] = heic_dec,        /* heic */
   [0x58] = jp2_dec,         /* jp2  */
+  [0x63] = ico_dec,         /* cur  */
   [0x64] = tga_dec,         /* icb  */
   [0x68] = pgm_dec,         /* pgm  */
   [0x79] = bmp_dec,         /* bmp  */
@@ -138,6 +143,7 @@ static const imloader extmap[256] = {
   [0x99] = qoi_dec,         /* qoi  */
   [0x9D] = tga_dec,         /* vst  */
   [0xA9] = png_dec,         /* png  */
+  [0xDF] = ico_dec,         /* ico  */
   [0xEA] = tga_dec,         /* tga  */
   [0xF0] = pam_dec,         /* pam  */
   [0xF7] = jpg_dec,         /* jpg  */
@@ -177,17 +183,95 @@ static void __attribute__((constructor)) verify_hashes(void) {
   print_ext_hash("jpeg");
   print_ext_hash("jxl");
   print_ext_hash("jp2");
+  print_ext_hash("ico");
+  print_ext_hash("cur");
   printf("-------------------\n");
 }
 #endif
 
+static
+void
+im_open_config(im_open_config_t  * __restrict conf,
+               im_option_base_t  *            options[],
+               ImOpenIntent                   openIntent) {
+  im_option_base_t *opt;
+
+  memset(conf, 0, sizeof(*conf));
+
+  conf->openIntent  = openIntent;
+  conf->byteOrder   = IM_BYTEORDER_ANY;
+  conf->rowPadding  = 0;
+  conf->supportsPal = true;
+  conf->options     = options;
+
+  if (!options)
+    return;
+
+  for (int i = 0; options[i]; i++) {
+    opt = options[i];
+    switch (opt->type) {
+      case IM_OPTION_ROW_PAD_LAST:     conf->rowPadding  = ((im_option_rowpadding_t*)opt)->pad;  break;
+      case IM_OPTION_BYTE_ORDER:       conf->byteOrder   = ((im_option_byteorder_t*)opt)->order; break;
+      case IM_OPTION_SUPPORTS_PALETTE: conf->supportsPal = ((im_option_bool_t*)opt)->on;         break;
+      case IM_OPTION_BGR_TO_RGB:       conf->bgr2rgb     = ((im_option_bool_t*)opt)->on;         break;
+      case IM_OPTION_JPEG_PIPELINE_DEPTH:
+        conf->pipelineDepth = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_JPEG_MAX_SCANS:
+        conf->maxScans = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_JPEG_SCALE_DENOM:
+        conf->scaleDenom = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_SUPPORTED_ORIENTATIONS:
+        conf->supportedOri = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_JPEG_PLANAR:
+        conf->planar = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_JPEG_METADATA_ONLY:
+        conf->metadataOnly = ((im_option_bool_t*)opt)->on;
+        break;
+      case IM_OPTION_JPEG_CMYK_TO_RGB:
+        conf->cmykToRGB = ((im_option_bool_t*)opt)->on;
+        break;
+      case IM_OPTION_JPEG_COEF_COUNT:
+        conf->coefCount = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_BMP_SKIPPED_MODE:
+        conf->bmpSkipped = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_BMP_PALETTE_INDICES:
+        conf->bmpIndices = ((im_option_bool_t*)opt)->on;
+        break;
+      case IM_OPTION_TOP_DOWN_ROWS:
+        conf->topDown = ((im_option_bool_t*)opt)->on;
+        break;
+      case IM_OPTION_ICO_SIZE:
+        conf->icoSize = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_BMP_64BPP:
+        conf->bmp64 = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_PACKED_BITS:
+        conf->packedBits = ((im_option_uint_t*)opt)->value;
+        break;
+      case IM_OPTION_JPEG_PREVIEW:
+        conf->preview    = ((im_option_preview_t*)opt)->func;
+        conf->previewObj = ((im_option_preview_t*)opt)->obj;
+        break;
+      default: break;
+    }
+  }
+}
+
 IM_EXPORT
 ImResult
 im_load(ImImage         ** __restrict dest,
         const char       * __restrict url,
         im_option_base_t *            options[],
         ImOpenIntent                  openIntent) {
-  im_option_base_t *opt;
+  im_open_config_t  conf;
   const char       *ext;
   imloader          fn;
   int               filetype;
@@ -197,26 +281,7 @@ im_load(ImImage         ** __restrict dest,
   /* TODO: currently file_type from file ext.  */
   filetype = IM_FILE_TYPE_AUTO;
 
-  im_open_config_t conf = {
-    .openIntent  = openIntent,
-    .byteOrder   = IM_BYTEORDER_ANY,
-    .rowPadding  = 0,
-    .supportsPal = true,
-    .options     = options
-  };
-
-  if (options) {
-    for (int i = 0; options[i]; i++) {
-      opt = options[i];
-      switch (opt->type) {
-        case IM_OPTION_ROW_PAD_LAST:     conf.rowPadding  = ((im_option_rowpadding_t*)opt)->pad;  break;
-        case IM_OPTION_BYTE_ORDER:       conf.byteOrder   = ((im_option_byteorder_t*)opt)->order; break;
-        case IM_OPTION_SUPPORTS_PALETTE: conf.supportsPal = ((im_option_bool_t*)opt)->on;         break;
-        case IM_OPTION_BGR_TO_RGB:       conf.bgr2rgb     = ((im_option_bool_t*)opt)->on;         break;
-        default: break;
-      }
-    }
-  }
+  im_open_config(&conf, options, openIntent);
 
   if (!filetype && (ext=strrchr(url,'.')) && (fn=extmap[hash_ext(ext+1)]))
     return fn(dest, url, &conf);
@@ -230,19 +295,168 @@ im_load(ImImage         ** __restrict dest,
 #endif
 }
 
+IM_EXPORT
+ImResult
+im_load_thumbnail(ImImage         ** __restrict dest,
+                  ImImage          * __restrict im,
+                  im_option_base_t *            options[]) {
+  im_open_config_t conf;
+
+  if (!dest) return IM_EBADF;
+
+  *dest = NULL;
+
+  if (!im || !im->exif || !im->exif->thumbnail)
+    return IM_ERR;
+
+  im_open_config(&conf, options, IM_OPEN_INTENT_READONLY);
+
+  /* thumbnail is decoded in place, it is a slice of the source file */
+  return jpg_dec_mem(dest,
+                     (ImByte *)im->exif->thumbnail,
+                     im->exif->thumbnailSize,
+                     &conf);
+}
+
+IM_EXPORT
+ImResult
+im_jpeg_transform_mem(ImByte               ** __restrict dest,
+                      size_t                * __restrict destSize,
+                      const ImByte          * __restrict raw,
+                      size_t                             size,
+                      const ImJpegTransform * __restrict tr) {
+  if (!dest || !destSize || !raw || !tr) return IM_EBADF;
+
+  return jpg_transform_mem(dest, destSize, (ImByte *)raw, size, tr);
+}
+
+IM_EXPORT
+ImResult
+im_jpeg_transform(ImByte               ** __restrict dest,
+                  size_t                * __restrict destSize,
+                  const char            * __restrict path,
+                  const ImJpegTransform * __restrict tr) {
+  ImFileResult fres;
+  ImResult     ret;
+
+  if (!dest || !destSize || !path || !tr) return IM_EBADF;
+
+  fres = im_readfile(path, true);
+  if (fres.ret != IM_OK) {
+    *dest = NULL;
+    return fres.ret;
+  }
+
+  ret = jpg_transform_mem(dest, destSize, fres.raw, fres.size, tr);
+
+  if (fres.mmap) im_unmap(fres.raw, fres.size);
+  else           free(fres.raw);
+
+  return ret;
+}
+
+IM_EXPORT
+ImResult
+im_jpeg_encode(ImByte            ** __restrict dest,
+               size_t             * __restrict destSize,
+               const ImImage      * __restrict im,
+               const ImJpegEncode * __restrict opt) {
+  if (!dest || !destSize || !im) return IM_EBADF;
+
+  return jpg_encode_mem(dest, destSize, im, opt);
+}
+
+IM_EXPORT
+ImJpegStream*
+im_jpeg_stream_new(im_option_base_t *options[]) {
+  im_open_config_t conf;
+
+  im_open_config(&conf, options, IM_OPEN_INTENT_READONLY);
+
+  return jpg_stream_new(&conf);
+}
+
+IM_EXPORT
+ImResult
+im_jpeg_stream_decode(ImJpegStream  * __restrict stream,
+                      ImImage      ** __restrict dest,
+                      const ImByte  * __restrict raw,
+                      size_t                     size) {
+  if (!stream || !dest || !raw) return IM_EBADF;
+
+  return jpg_stream_dec(stream, dest, (ImByte *)raw, size);
+}
+
+IM_EXPORT
+void
+im_jpeg_stream_free(ImJpegStream *stream) {
+  jpg_stream_free(stream);
+}
+
+IM_EXPORT
+ImResult
+im_jpeg_coefs_mem(ImJpegCoefs     ** __restrict dest,
+                  const ImByte     * __restrict raw,
+                  size_t                        size,
+                  im_option_base_t *            options[]) {
+  im_open_config_t conf;
+
+  if (!dest || !raw) return IM_EBADF;
+
+  im_open_config(&conf, options, IM_OPEN_INTENT_READONLY);
+
+  return jpg_coefs_mem(dest, (ImByte *)raw, size, &conf);
+}
+
+IM_EXPORT
+ImResult
+im_jpeg_coefs(ImJpegCoefs     ** __restrict dest,
+              const char       * __restrict path,
+              im_option_base_t *            options[]) {
+  im_open_config_t conf;
+  ImFileResult     fres;
+  ImResult         ret;
+
+  if (!dest || !path) return IM_EBADF;
+
+  fres = im_readfile(path, true);
+  if (fres.ret != IM_OK) {
+    *dest = NULL;
+    return fres.ret;
+  }
+
+  im_open_config(&conf, options, IM_OPEN_INTENT_READONLY);
+  ret = jpg_coefs_mem(dest, fres.raw, fres.size, &conf);
+
+  if (fres.mmap) im_unmap(fres.raw, fres.size);
+  else           free(fres.raw);
+
+  return ret;
+}
+
 IM_EXPORT
 ImResult
 im_free(ImImage * __restrict im) {
   if (!im) return IM_OK;
 
+  /* zero-copy images point into file */
+  if (im->data.data
+      && !(im->file.raw
+           && (char *)im->data.data >= (char *)im->file.raw
+           && (char *)im->data.data <  (char *)im->file.raw + im->file.size)) {
+    free(im->data.data);
+  }
+
   if (im->file.mmap) {
     im_unmap(im->file.raw, im->file.size);
   } else if (im->file.mustfree) {
     free(im->file.raw);
   }
 
-  if (im->data.data) {
-    free(im->data.data);
+  if (im->pal) {
+    if (im->pal->pal)
+      free(im->pal->pal);
+    free(im->pal);
   }
 
   if (im->background)
@@ -260,6 +474,10 @@ im_free(ImImage * __restrict im) {
   if (im->timeStamp)
     free(im->timeStamp);
 
+  /* strings are allocated with the struct */
+  if (im->exif)
+    free(im->exif);
+
   if (im->transparency) {
     if (im->transparency->value.pal.alpha)
       free(im->transparency->value.pal.alpha);
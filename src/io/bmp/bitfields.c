@@ -0,0 +1,555 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "bitfields.h"
+
+/*
+ Fields are expanded to 8 bits with round(v * 255 / max). Tables do this for
+ any mask, common layouts use integer forms which give the same values:
+   5 bits:  (v * 527 + 23) >> 6
+   6 bits:  (v * 259 + 33) >> 6
+   10 bits: (((v * 32672) >> 16) + 1) >> 1
+   2 bits:  v * 85
+ */
+#define DIB_X5_MUL  527
+#define DIB_X5_ADD  23
+#define DIB_X6_MUL  259
+#define DIB_X6_ADD  33
+#define DIB_X10_MUL 32672
+#define DIB_X2_MUL  85
+
+#if defined(__SSSE3__) || defined(__ARM_NEON)
+#  define DIB_SIMD_BGR 1
+#else
+#  define DIB_SIMD_BGR 0
+#endif
+
+static
+DibPacking
+dib_fields_pack(const uint32_t m[4], uint32_t bpp, uint32_t ncomp) {
+  uint32_t c;
+  bool     alpha;
+
+  alpha = ncomp == 4;
+
+  if (bpp == 16) {
+    if (m[0] == 0xF800 && m[1] == 0x07E0 && m[2] == 0x001F && !alpha)
+      return DIB_PACK_565;
+
+    if (m[0] == 0x7C00 && m[1] == 0x03E0 && m[2] == 0x001F
+        && (alpha ? m[3] == 0x8000 : true))
+      return DIB_PACK_555;
+
+    return DIB_PACK_GENERIC;
+  }
+
+  if (m[0] == 0x3FF00000 && m[1] == 0x000FFC00 && m[2] == 0x000003FF
+      && (alpha ? m[3] == 0xC0000000 : true))
+    return DIB_PACK_2101010;
+
+  for (c = 0; c < ncomp; c++) {
+    if (m[c] && m[c] != 0xFF       && m[c] != 0xFF00
+             && m[c] != 0xFF0000   && m[c] != 0xFF000000)
+      return DIB_PACK_GENERIC;
+  }
+
+  return DIB_PACK_8888;
+}
+
+IM_HIDE
+void
+dib_fields_init(DibFields * __restrict fl,
+                const uint32_t         masks[4],
+                uint32_t               bpp,
+                uint32_t               ncomp) {
+  DibField *f;
+  uint32_t  m[4], c, i, mask, bits, max;
+
+  for (c = 0; c < 4; c++)
+    m[c] = bpp == 16 ? masks[c] & 0xFFFF : masks[c];
+
+  /* alpha mask of BITFIELDS image is not used, pixels are opaque */
+  if (ncomp == 3)
+    m[3] = 0;
+
+  fl->bpp   = bpp;
+  fl->ncomp = ncomp;
+  fl->pack  = dib_fields_pack(m, bpp, ncomp);
+
+  for (c = 0; c < 4; c++) {
+    f           = &fl->f[c];
+    fl->byte[c] = -1;
+
+    /* B, G, R from R, G, B masks */
+    mask        = m[c == 3 ? 3 : 2 - c];
+
+    if (!mask) {
+      f->shift  = 0;
+      f->max    = 0;
+      f->scale  = 0.0f;
+      f->fill   = c == 3 ? 255 : 0;
+      f->lut[0] = (ImByte)f->fill;
+      continue;
+    }
+
+    f->shift = im_bitw_ctz(mask);
+    bits     = 32 - im_bitw_clz(mask) - f->shift;
+
+    if (bits > DIB_FIELD_BITS) {
+      f->shift += bits - DIB_FIELD_BITS;
+      bits      = DIB_FIELD_BITS;
+    }
+
+    max      = (1u << bits) - 1;
+    f->max   = max;
+    f->fill  = 0;
+    f->scale = 255.0f / (float)max;
+
+    for (i = 0; i <= max; i++)
+      f->lut[i] = (ImByte)((i * 510 + max) / (max * 2));
+
+    if (fl->pack == DIB_PACK_8888)
+      fl->byte[c] = (int8_t)(f->shift >> 3);
+  }
+}
+
+static
+void
+dib_row_lut(const DibFields * __restrict fl,
+            const ImByte    * __restrict src,
+            ImByte          * __restrict dst,
+            uint32_t                     width) {
+  const DibField *f;
+  uint32_t        x, px, n;
+
+  f = fl->f;
+  n = fl->ncomp;
+
+  for (x = 0; x < width; x++, dst += n) {
+    if (fl->bpp == 16) {
+      px   = src[0] | (uint32_t)src[1] << 8;
+      src += 2;
+    } else {
+      px   = src[0]                  | (uint32_t)src[1] << 8
+           | (uint32_t)src[2] << 16 | (uint32_t)src[3] << 24;
+      src += 4;
+    }
+
+    dst[0] = f[0].lut[(px >> f[0].shift) & f[0].max];
+    dst[1] = f[1].lut[(px >> f[1].shift) & f[1].max];
+    dst[2] = f[2].lut[(px >> f[2].shift) & f[2].max];
+
+    if (n == 4)
+      dst[3] = f[3].lut[(px >> f[3].shift) & f[3].max];
+  }
+}
+
+#if defined(__SSE2__)
+
+/* 4 BGRA pixels, BGR output drops every 4th byte with SSSE3 */
+IM_INLINE
+void
+dib_store4_sse2(ImByte * __restrict dst, __m128i px, uint32_t ncomp) {
+#if defined(__SSSE3__)
+  int32_t tail;
+
+  if (ncomp == 3) {
+    px   = _mm_shuffle_epi8(px, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                              12, 13, 14, -1, -1, -1, -1));
+    tail = _mm_cvtsi128_si32(_mm_srli_si128(px, 8));
+
+    _mm_storel_epi64((__m128i *)dst, px);
+    memcpy(dst + 8, &tail, 4);
+    return;
+  }
+#endif
+  _mm_storeu_si128((__m128i *)dst, px);
+}
+
+static
+uint32_t
+dib_row16_sse2(const DibFields * __restrict fl,
+               const ImByte    * __restrict src,
+               ImByte          * __restrict dst,
+               uint32_t                     width) {
+  __m128i  v, b, g, r, a, bg, ra, m5, m6, x5m, x5a, x6m, x6a;
+  uint32_t x, n;
+
+  n   = fl->ncomp;
+  m5  = _mm_set1_epi16(0x1F);
+  m6  = _mm_set1_epi16(0x3F);
+  x5m = _mm_set1_epi16(DIB_X5_MUL);
+  x5a = _mm_set1_epi16(DIB_X5_ADD);
+  x6m = _mm_set1_epi16(DIB_X6_MUL);
+  x6a = _mm_set1_epi16(DIB_X6_ADD);
+  a   = _mm_set1_epi16(0xFF);
+
+#define DIB_X5(V) _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(V, x5m), x5a), 6)
+
+  for (x = 0; x + 8 <= width; x += 8) {
+    v = _mm_loadu_si128((const __m128i *)(src + x * 2));
+    b = DIB_X5(_mm_and_si128(v, m5));
+
+    if (fl->pack == DIB_PACK_565) {
+      g = _mm_and_si128(_mm_srli_epi16(v, 5), m6);
+      g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(g, x6m), x6a), 6);
+      r = DIB_X5(_mm_srli_epi16(v, 11));
+    } else {
+      g = DIB_X5(_mm_and_si128(_mm_srli_epi16(v, 5), m5));
+      r = DIB_X5(_mm_and_si128(_mm_srli_epi16(v, 10), m5));
+
+      if (n == 4)
+        a = _mm_srli_epi16(_mm_srai_epi16(v, 15), 8);
+    }
+
+    bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    ra = _mm_or_si128(r, _mm_slli_epi16(a, 8));
+
+    dib_store4_sse2(dst + x * n,       _mm_unpacklo_epi16(bg, ra), n);
+    dib_store4_sse2(dst + (x + 4) * n, _mm_unpackhi_epi16(bg, ra), n);
+  }
+
+#undef DIB_X5
+
+  return x;
+}
+
+static
+uint32_t
+dib_row2101010_sse2(const DibFields * __restrict fl,
+                    const ImByte    * __restrict src,
+                    ImByte          * __restrict dst,
+                    uint32_t                     width) {
+  __m128i  v, b, g, r, a, px, m10, x10, one, x2;
+  uint32_t x, n;
+
+  n   = fl->ncomp;
+  m10 = _mm_set1_epi32(0x3FF);
+  x10 = _mm_set1_epi16(DIB_X10_MUL);
+  one = _mm_set1_epi16(1);
+  x2  = _mm_set1_epi32(DIB_X2_MUL);
+
+  /* fields are in low halves of 32-bit lanes, high halves stay zero */
+#define DIB_X10(V) \
+  _mm_srli_epi16(_mm_add_epi16(_mm_mulhi_epu16(V, x10), one), 1)
+
+  for (x = 0; x + 4 <= width; x += 4) {
+    v  = _mm_loadu_si128((const __m128i *)(src + x * 4));
+    b  = DIB_X10(_mm_and_si128(v, m10));
+    g  = DIB_X10(_mm_and_si128(_mm_srli_epi32(v, 10), m10));
+    r  = DIB_X10(_mm_and_si128(_mm_srli_epi32(v, 20), m10));
+    px = _mm_or_si128(b, _mm_or_si128(_mm_slli_epi32(g, 8),
+                                      _mm_slli_epi32(r, 16)));
+
+    if (n == 4) {
+      a  = _mm_mullo_epi16(_mm_srli_epi32(v, 30), x2);
+      px = _mm_or_si128(px, _mm_slli_epi32(a, 24));
+    }
+
+    dib_store4_sse2(dst + x * n, px, n);
+  }
+
+#undef DIB_X10
+
+  return x;
+}
+
+#if defined(__SSSE3__)
+static
+uint32_t
+dib_row8888_ssse3(const DibFields * __restrict fl,
+                  const ImByte    * __restrict src,
+                  ImByte          * __restrict dst,
+                  uint32_t                     width) {
+  IM_ALIGN(16) int8_t ctl[16], fill[16];
+  __m128i             v, vctl, vfill;
+  uint32_t            x, p, c, n;
+
+  n = fl->ncomp;
+
+  for (p = 0; p < 4; p++) {
+    for (c = 0; c < 4; c++) {
+      ctl[p * 4 + c]  = fl->byte[c] < 0 ? -1 : (int8_t)(p * 4 + fl->byte[c]);
+      fill[p * 4 + c] = (int8_t)fl->f[c].fill;
+    }
+  }
+
+  vctl  = _mm_load_si128((const __m128i *)ctl);
+  vfill = _mm_load_si128((const __m128i *)fill);
+
+  for (x = 0; x + 4 <= width; x += 4) {
+    v = _mm_loadu_si128((const __m128i *)(src + x * 4));
+    v = _mm_or_si128(_mm_shuffle_epi8(v, vctl), vfill);
+
+    dib_store4_sse2(dst + x * n, v, n);
+  }
+
+  return x;
+}
+#endif
+
+/* any masks: field = round(((px >> shift) & max) * scale) + fill */
+static
+uint32_t
+dib_rowgen_sse2(const DibFields * __restrict fl,
+                const ImByte    * __restrict src,
+                ImByte          * __restrict dst,
+                uint32_t                     width) {
+  __m128i  v, t, px, sh[4], mx[4], fill[4], pos[4];
+  __m128   sc[4], half;
+  uint32_t x, c, n;
+
+  n    = fl->ncomp;
+  half = _mm_set1_ps(0.5f);
+
+  for (c = 0; c < n; c++) {
+    sh[c]   = _mm_cvtsi32_si128((int)fl->f[c].shift);
+    pos[c]  = _mm_cvtsi32_si128((int)c * 8);
+    mx[c]   = _mm_set1_epi32((int)fl->f[c].max);
+    fill[c] = _mm_set1_epi32((int)fl->f[c].fill);
+    sc[c]   = _mm_set1_ps(fl->f[c].scale);
+  }
+
+  for (x = 0; x + 4 <= width; x += 4) {
+    if (fl->bpp == 32)
+      v = _mm_loadu_si128((const __m128i *)(src + x * 4));
+    else
+      v = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(src + x * 2)),
+                             _mm_setzero_si128());
+
+    px = _mm_setzero_si128();
+
+    for (c = 0; c < n; c++) {
+      t  = _mm_and_si128(_mm_srl_epi32(v, sh[c]), mx[c]);
+      t  = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(t), sc[c]),
+                                       half));
+      t  = _mm_add_epi32(t, fill[c]);
+      px = _mm_or_si128(px, _mm_sll_epi32(t, pos[c]));
+    }
+
+    dib_store4_sse2(dst + x * n, px, n);
+  }
+
+  return x;
+}
+
+#elif defined(__ARM_NEON)
+
+static
+uint32_t
+dib_row16_neon(const DibFields * __restrict fl,
+               const ImByte    * __restrict src,
+               ImByte          * __restrict dst,
+               uint32_t                     width) {
+  uint16x8_t  v, b, g, r, a, m5, x5m, x5a;
+  uint8x8x4_t o;
+  uint8x8x3_t o3;
+  uint32_t    x, n;
+
+  n   = fl->ncomp;
+  m5  = vdupq_n_u16(0x1F);
+  x5m = vdupq_n_u16(DIB_X5_MUL);
+  x5a = vdupq_n_u16(DIB_X5_ADD);
+  a   = vdupq_n_u16(0xFF);
+
+#define DIB_X5(V) vshrq_n_u16(vmlaq_u16(x5a, V, x5m), 6)
+
+  for (x = 0; x + 8 <= width; x += 8) {
+    v = vreinterpretq_u16_u8(vld1q_u8(src + x * 2));
+    b = DIB_X5(vandq_u16(v, m5));
+
+    if (fl->pack == DIB_PACK_565) {
+      g = vandq_u16(vshrq_n_u16(v, 5), vdupq_n_u16(0x3F));
+      g = vshrq_n_u16(vmlaq_u16(vdupq_n_u16(DIB_X6_ADD),
+                                g,
+                                vdupq_n_u16(DIB_X6_MUL)), 6);
+      r = DIB_X5(vshrq_n_u16(v, 11));
+    } else {
+      g = DIB_X5(vandq_u16(vshrq_n_u16(v, 5),  m5));
+      r = DIB_X5(vandq_u16(vshrq_n_u16(v, 10), m5));
+
+      if (n == 4)
+        a = vmulq_n_u16(vshrq_n_u16(v, 15), 255);
+    }
+
+    o.val[0] = vmovn_u16(b);
+    o.val[1] = vmovn_u16(g);
+    o.val[2] = vmovn_u16(r);
+    o.val[3] = vmovn_u16(a);
+
+    if (n == 4) {
+      vst4_u8(dst + x * 4, o);
+    } else {
+      o3.val[0] = o.val[0];
+      o3.val[1] = o.val[1];
+      o3.val[2] = o.val[2];
+      vst3_u8(dst + x * 3, o3);
+    }
+  }
+
+#undef DIB_X5
+
+  return x;
+}
+
+static
+uint32_t
+dib_row8888_neon(const DibFields * __restrict fl,
+                 const ImByte    * __restrict src,
+                 ImByte          * __restrict dst,
+                 uint32_t                     width) {
+  uint8x16x4_t s, o;
+  uint8x16x3_t o3;
+  uint32_t     x, c, n;
+
+  n = fl->ncomp;
+
+  for (x = 0; x + 16 <= width; x += 16) {
+    s = vld4q_u8(src + x * 4);
+
+    for (c = 0; c < 4; c++) {
+      o.val[c] = fl->byte[c] < 0 ? vdupq_n_u8((uint8_t)fl->f[c].fill)
+                                 : s.val[fl->byte[c]];
+    }
+
+    if (n == 4) {
+      vst4q_u8(dst + x * 4, o);
+    } else {
+      o3.val[0] = o.val[0];
+      o3.val[1] = o.val[1];
+      o3.val[2] = o.val[2];
+      vst3q_u8(dst + x * 3, o3);
+    }
+  }
+
+  return x;
+}
+
+/* any masks, 10-bit layout goes here too */
+static
+uint32_t
+dib_rowgen_neon(const DibFields * __restrict fl,
+                const ImByte    * __restrict src,
+                ImByte          * __restrict dst,
+                uint32_t                     width) {
+  uint32x4_t  v0, v1, t0, t1;
+  uint16x8_t  w;
+  uint8x8x4_t o;
+  uint8x8x3_t o3;
+  float32x4_t half;
+  uint32_t    x, c, n;
+
+  n    = fl->ncomp;
+  half = vdupq_n_f32(0.5f);
+
+  for (x = 0; x + 8 <= width; x += 8) {
+    if (fl->bpp == 32) {
+      v0 = vreinterpretq_u32_u8(vld1q_u8(src + x * 4));
+      v1 = vreinterpretq_u32_u8(vld1q_u8(src + x * 4 + 16));
+    } else {
+      w  = vreinterpretq_u16_u8(vld1q_u8(src + x * 2));
+      v0 = vmovl_u16(vget_low_u16(w));
+      v1 = vmovl_u16(vget_high_u16(w));
+    }
+
+    for (c = 0; c < n; c++) {
+      const DibField *f = &fl->f[c];
+      int32x4_t       sh;
+      uint32x4_t      mx;
+      float32x4_t     sc;
+
+      sh = vdupq_n_s32(-(int32_t)f->shift);
+      mx = vdupq_n_u32(f->max);
+      sc = vdupq_n_f32(f->scale);
+
+      t0 = vandq_u32(vshlq_u32(v0, sh), mx);
+      t1 = vandq_u32(vshlq_u32(v1, sh), mx);
+      t0 = vcvtq_u32_f32(vmlaq_f32(half, vcvtq_f32_u32(t0), sc));
+      t1 = vcvtq_u32_f32(vmlaq_f32(half, vcvtq_f32_u32(t1), sc));
+      t0 = vaddq_u32(t0, vdupq_n_u32(f->fill));
+      t1 = vaddq_u32(t1, vdupq_n_u32(f->fill));
+
+      o.val[c] = vmovn_u16(vcombine_u16(vmovn_u32(t0), vmovn_u32(t1)));
+    }
+
+    if (n == 4) {
+      vst4_u8(dst + x * 4, o);
+    } else {
+      o3.val[0] = o.val[0];
+      o3.val[1] = o.val[1];
+      o3.val[2] = o.val[2];
+      vst3_u8(dst + x * 3, o3);
+    }
+  }
+
+  return x;
+}
+
+#endif
+
+IM_HIDE
+void
+dib_fields_row(const DibFields * __restrict fl,
+               const ImByte    * __restrict src,
+               ImByte          * __restrict dst,
+               uint32_t                     width) {
+  uint32_t x;
+
+  x = 0;
+
+#if defined(__SSE2__)
+  if (fl->ncomp == 4 || DIB_SIMD_BGR) {
+    switch (fl->pack) {
+      case DIB_PACK_565:
+      case DIB_PACK_555:
+        x = dib_row16_sse2(fl, src, dst, width);
+        break;
+      case DIB_PACK_2101010:
+        x = dib_row2101010_sse2(fl, src, dst, width);
+        break;
+#  if defined(__SSSE3__)
+      case DIB_PACK_8888:
+        x = dib_row8888_ssse3(fl, src, dst, width);
+        break;
+#  endif
+      default:
+        x = dib_rowgen_sse2(fl, src, dst, width);
+        break;
+    }
+  }
+#elif defined(__ARM_NEON)
+  switch (fl->pack) {
+    case DIB_PACK_565:
+    case DIB_PACK_555:
+      x = dib_row16_neon(fl, src, dst, width);
+      break;
+    case DIB_PACK_8888:
+      x = dib_row8888_neon(fl, src, dst, width);
+      break;
+    default:
+      x = dib_rowgen_neon(fl, src, dst, width);
+      break;
+  }
+#endif
+
+  /* tail, or whole row without SIMD */
+  if (x < width)
+    dib_row_lut(fl,
+                src + (size_t)x * (fl->bpp >> 3),
+                dst + (size_t)x * fl->ncomp,
+                width - x);
+}
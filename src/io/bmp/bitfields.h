@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef sc_bmp_bitfields_h
+#define sc_bmp_bitfields_h
+
+#include "../common.h"
+
+/* wider fields are cut to their top bits before expansion to 8 bits */
+#define DIB_FIELD_BITS 10
+
+typedef enum DibPacking {
+  DIB_PACK_GENERIC = 0,
+  DIB_PACK_565     = 1, /* R5 G6 B5                           */
+  DIB_PACK_555     = 2, /* X1 R5 G5 B5 or A1 R5 G5 B5          */
+  DIB_PACK_8888    = 3, /* 8-bit fields on byte bounds, any order */
+  DIB_PACK_2101010 = 4  /* X2 R10 G10 B10 or A2 R10 G10 B10     */
+} DibPacking;
+
+typedef struct DibField {
+  uint32_t shift;     /* brings kept bits of field down to bit 0    */
+  uint32_t max;       /* (1 << kept bits) - 1, 0 for missing field  */
+  uint32_t fill;      /* added to result, 255 for missing alpha     */
+  float    scale;     /* 255 / max                                  */
+  ImByte   lut[1 << DIB_FIELD_BITS];
+} DibField;
+
+/* BITFIELDS / ALPHABITFIELDS layout, fields are in output order B, G, R, A */
+typedef struct DibFields {
+  DibField   f[4];
+  DibPacking pack;
+  uint32_t   bpp;     /* 16 or 32                                   */
+  uint32_t   ncomp;   /* 3: BGR, 4: BGRA                            */
+  int8_t     byte[4]; /* DIB_PACK_8888: source byte of field, -1: none */
+} DibFields;
+
+/* masks are R, G, B, A as they are stored in header */
+IM_HIDE
+void
+dib_fields_init(DibFields * __restrict fl,
+                const uint32_t         masks[4],
+                uint32_t               bpp,
+                uint32_t               ncomp);
+
+IM_HIDE
+void
+dib_fields_row(const DibFields * __restrict fl,
+               const ImByte    * __restrict src,
+               ImByte          * __restrict dst,
+               uint32_t                     width);
+
+#endif /* sc_bmp_bitfields_h */
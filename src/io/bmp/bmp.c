@@ -74,15 +74,22 @@ bmp_dec(ImImage         ** __restrict dest,
 
   dataoff = im_get_u32_endian(p, true);  p += 4;
 
+  if (dataoff > fres.size) {
+    goto err;
+  }
+
   if (dib_dec_mem(im,
                   p,
                   (char *)fres.raw + dataoff,
-                  (char *)fres.raw + fres.size - 1) != IM_OK) {
+                  (char *)fres.raw + fres.size - 1,
+                  open_config) != IM_OK) {
     goto err;
   }
 
-  *dest = im;
-  im->file = fres;
+  /* image may point into file, im_free() releases both */
+  fres.mustfree = !fres.mmap;
+  *dest         = im;
+  im->file      = fres;
   
 //  if (fres.mmap) {
 //    im_unmap(fres.raw, fres.size);
@@ -92,6 +99,8 @@ bmp_dec(ImImage         ** __restrict dest,
 err:
   if (fres.mmap) {
     im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
   }
   
   if (im) {
@@ -125,12 +134,14 @@ dib_dec(ImImage         ** __restrict dest,
   if (dib_dec_mem(im,
                   p,
                   NULL,
-                  (char *)fres.raw + fres.size - 1) != IM_OK) {
+                  (char *)fres.raw + fres.size - 1,
+                  open_config) != IM_OK) {
     goto err;
   }
 
-  *dest = im;
-  im->file = fres;
+  fres.mustfree = !fres.mmap;
+  *dest         = im;
+  im->file      = fres;
   
   //  if (fres.mmap) {
   //    im_unmap(fres.raw, fres.size);
@@ -140,6 +151,8 @@ dib_dec(ImImage         ** __restrict dest,
 err:
   if (fres.mmap) {
     im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
   }
   
   if (im) {
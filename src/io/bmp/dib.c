@@ -15,8 +15,14 @@
  */
 
 #include "dib.h"
+#include "bitfields.h"
+#include "rle.h"
+#include "scrgb.h"
+#include "../png/png.h"
+#include "../jpg/dec/dec.h"
 #include "../../file.h"
 #include "../../endian.h"
+#include "../../color.h"
 
 /*
  References:
@@ -45,39 +51,299 @@ typedef enum im_bmp_compression_method_t {
   IM_BMP_COMPR_RLE24          = 4
 } im_bmp_compression_method_t;
 
+/* uncompressed images at least this large are decoded in bands */
+#define IM_DIB_BAND_MIN_BYTES (4u << 20)
+#define IM_DIB_BAND_MIN_ROWS  32
+
+typedef enum dib_rowkind_t {
+  DIB_ROWS_COPY   = 0, /* same layout, row padding may differ */
+  DIB_ROWS_FIELDS = 1, /* 16 / 32bpp bit fields               */
+  DIB_ROWS_MONO   = 2, /* 1bpp to monochrome colors           */
+  DIB_ROWS_PAL8   = 3,
+  DIB_ROWS_PAL    = 4, /* 2 - 7 bpp, pixels do not span bytes */
+  DIB_ROWS_INDEX  = 5, /* 2 - 7 bpp to 8-bit indices          */
+  DIB_ROWS_HALF   = 6, /* 64bpp s2.13 to half float           */
+  DIB_ROWS_U16    = 7, /* 64bpp s2.13 to 16-bit unsigned      */
+  DIB_ROWS_LSB    = 8  /* 1bpp packed, bits reversed          */
+} dib_rowkind_t;
+
+/* uncompressed rows are independent, row y starts at y * src_rowst */
+typedef struct dib_rows_t {
+  const DibFields *fields;
+  const ImByte    *src;
+  const ImByte    *plt;
+  ImByte          *dst;
+  dib_rowkind_t    kind;
+  ImByte           mono[2];
+  uint32_t         width;
+  uint32_t         bpp;
+  uint32_t         pltst;
+  uint32_t         src_rowst;
+  int32_t          dst_rowst; /* negative when rows are flipped */
+} dib_rows_t;
+
+typedef struct dib_band_t {
+  const dib_rows_t *rows;
+  uint32_t          rowStart;
+  uint32_t          rowEnd;
+} dib_band_t;
+
+/* BGR palette entry to gray, BT.601 weights */
 IM_INLINE
-ImByte *
-im_setpx3_8(ImByte * __restrict dst, char * __restrict plt) {
-  dst[0] = plt[0];
-  dst[1] = plt[1];
-  dst[2] = plt[2];
-  return dst + 3;
+ImByte
+dib_luma(const ImByte * __restrict c) {
+  return (ImByte)((c[0] * 29 + c[1] * 150 + c[2] * 77 + 128) >> 8);
 }
 
-IM_HIDE
+static
+void
+dib_rows(const dib_rows_t * __restrict r, uint32_t y0, uint32_t y1) {
+  const ImByte *s, *c;
+  ImByte       *d;
+  uint32_t      y, x, ppb, sh, mask;
+
+  ppb  = r->bpp < 8 ? 8 / r->bpp          : 1;
+  mask = r->bpp < 8 ? (1u << r->bpp) - 1 : 0xFF;
+
+  for (y = y0; y < y1; y++) {
+    s = r->src + (size_t)y * r->src_rowst;
+    d = r->dst + (ptrdiff_t)y * r->dst_rowst;
+
+    switch (r->kind) {
+      case DIB_ROWS_COPY:
+        memcpy(d, s, im_min_i32(r->src_rowst, abs(r->dst_rowst)));
+        break;
+      case DIB_ROWS_FIELDS:
+        dib_fields_row(r->fields, s, d, r->width);
+        break;
+      case DIB_ROWS_MONO:
+        im_bits_expand(s, d, r->width, r->mono);
+        break;
+      case DIB_ROWS_PAL8:
+        for (x = 0; x < r->width; x++, d += 3) {
+          c    = r->plt + s[x] * r->pltst;
+          d[0] = c[0];
+          d[1] = c[1];
+          d[2] = c[2];
+        }
+        break;
+      case DIB_ROWS_PAL:
+        for (x = 0; x < r->width; x++, d += 3) {
+          sh   = 8 - r->bpp * (x % ppb + 1);
+          c    = r->plt + ((s[x / ppb] >> sh) & mask) * r->pltst;
+          d[0] = c[0];
+          d[1] = c[1];
+          d[2] = c[2];
+        }
+        break;
+      case DIB_ROWS_INDEX:
+        for (x = 0; x < r->width; x++)
+          d[x] = (s[x / ppb] >> (8 - r->bpp * (x % ppb + 1))) & mask;
+        break;
+      case DIB_ROWS_HALF:
+        dib_s213_half_row(s, (uint16_t *)d, r->width);
+        break;
+      case DIB_ROWS_U16:
+        dib_s213_u16_row(s, (uint16_t *)d, r->width);
+        break;
+      case DIB_ROWS_LSB:
+        im_bits_reverse(s, d, (r->width + 7) >> 3);
+        break;
+    }
+  }
+}
+
+static
+void
+dib_rows_worker(void *obj) {
+  dib_band_t *band;
+
+  band = obj;
+  dib_rows(band->rows, band->rowStart, band->rowEnd);
+}
+
+/* large images are split into bands of rows, caller's thread takes first */
+static
+void
+dib_rows_run(const dib_rows_t * __restrict rows,
+             uint32_t                      height,
+             size_t                        size) {
+  dib_band_t *bands;
+  th_thread **threads;
+  uint32_t    nth, band, i;
+
+  nth = 1;
+  if (size >= IM_DIB_BAND_MIN_BYTES)
+    nth = im_min_i32(thread_ncpu(), height / IM_DIB_BAND_MIN_ROWS);
+
+  if (nth < 2
+      || !(bands   = calloc(nth, sizeof(*bands)))
+      || !(threads = calloc(nth, sizeof(*threads)))) {
+    if (nth >= 2)
+      free(bands);
+
+    dib_rows(rows, 0, height);
+    return;
+  }
+
+  band = (height + nth - 1) / nth;
+
+  for (i = 0; i < nth; i++) {
+    bands[i].rows     = rows;
+    bands[i].rowStart = im_min_i32(i * band, height);
+    bands[i].rowEnd   = im_min_i32((i + 1) * band, height);
+  }
+
+  for (i = 1; i < nth; i++)
+    threads[i] = thread_new(dib_rows_worker, &bands[i]);
+
+  dib_rows_worker(&bands[0]);
+
+  for (i = 1; i < nth; i++) {
+    thread_join(threads[i]);
+    thread_release(threads[i]);
+  }
+
+  free(threads);
+  free(bands);
+}
+
+/*
+ BI_JPEG, BI_PNG: payload is a whole JPEG / PNG file, it is handed to that
+ decoder as is. OS/2 uses 4 for RLE24, so JPEG is recognized by its SOI
+ */
+static
+bool
+dib_embedded(uint32_t compr, const char *p, size_t size) {
+  const ImByte *b;
+
+  b = (const ImByte *)p;
+  if (compr == IM_BMP_COMPR_JPEG)
+    return size >= 3 && b[0] == 0xFF && b[1] == 0xD8 && b[2] == 0xFF;
+
+  return compr == IM_BMP_COMPR_PNG;
+}
+
+static
+ImResult
+dib_dec_embedded(ImImage          * __restrict im,
+                 char             * __restrict p,
+                 size_t                        size,
+                 uint32_t                      compr,
+                 im_open_config_t * __restrict conf) {
+  ImImage *sub;
+  ImResult ret;
+
+  sub = NULL;
+  if (!conf)
+    return IM_ERR;
+
+  if (compr == IM_BMP_COMPR_PNG)
+    ret = png_dec_mem(&sub, (ImByte *)p, size, conf);
+  else
+    ret = jpg_dec_mem(&sub, (ImByte *)p, size, conf);
+
+  if (ret != IM_OK || !sub)
+    return IM_ERR;
+
+  /* payload has its own orientation, BMP height sign is not used */
+  sub->fileFormatType = im->fileFormatType;
+  *im                 = *sub;
+  free(sub);
+
+  return IM_OK;
+}
+
+/*
+ icons: 1bpp AND mask follows XOR bitmap, rows in file order. It is alpha
+ unless 32bpp pixels carry their own. Result is always BGRA, old data is
+ released by caller
+ */
+static
+ImByte*
+dib_icon_alpha(ImImage      * __restrict im,
+               const ImByte * __restrict mask,
+               const ImByte            (*pal)[4],
+               bool                      flip) {
+  const ImByte *s, *m;
+  ImByte       *out, *d, *data;
+  uint32_t      x, y, w, h, nc, mrowst;
+
+  w    = im->width;
+  h    = im->height;
+  nc   = im->bytesPerPixel;
+  data = im->data.data;
+
+  if (nc == 4) {
+    for (y = 0; y < h; y++) {
+      s = data + (ptrdiff_t)y * im->rowStride;
+      for (x = 0; x < w; x++) {
+        if (s[x * 4 + 3])
+          return data;
+      }
+    }
+  }
+
+  if (!(out = malloc((size_t)w * h * 4)))
+    return NULL;
+
+  mrowst = ((w + 31) >> 5) << 2;
+
+  for (y = 0, d = out; y < h; y++) {
+    s = data + (ptrdiff_t)y * im->rowStride;
+    m = mask ? mask + (size_t)(flip ? h - 1 - y : y) * mrowst : NULL;
+
+    for (x = 0; x < w; x++, d += 4) {
+      if (nc == 1) memcpy(d, pal[s[x] ? 1 : 0], 3);
+      else         memcpy(d, s + x * nc,       3);
+
+      d[3] = m && ((m[x >> 3] >> (7 - (x & 7))) & 1) ? 0 : 255;
+    }
+  }
+
+  im->len           = (size_t)w * h * 4;
+  im->format        = IM_FORMAT_BGRA;
+  im->alphaInfo     = IM_ALPHA_LAST;
+  im->bytesPerPixel = 4;
+  im->bitsPerPixel  = 32;
+  im->row_pad_last  = 0;
+  im->rowStride     = (int32_t)(w * 4);
+
+  return out;
+}
+
+static
 ImResult
-dib_dec_mem(ImImage * __restrict im,
-            char    * __restrict p,
-            char    * __restrict p_data,
-            char    * __restrict p_eof) {
-  char               *p_end, *plt, *bfi;
+dib_dec_core(ImImage          * __restrict im,
+             char             * __restrict p,
+             char             * __restrict p_data,
+             char             * __restrict p_eof,
+             im_open_config_t * __restrict conf,
+             bool                          icon) {
+  char               *p_end, *plt, *bfi, *hdr, *pal_end, *p_emb, *pd_end;
+  size_t              emblen, dst_rowb;
   uint32_t            imlen;
-  ImByte              bpp, c, *pd;
+  ImByte              bpp, *pd, pal[256][4];
+  DibFields           fields;
+  DibRle              rle;
+  dib_rows_t          rows;
   uint32_t            hsz, width, min_bytes, height, compr,
-  i, j, idx, src_ncomp, dst_ncomp, pltst,
-  src_pad, dst_rem, dst_pad, src_rowst, dst_rowst, bitoff,
-  rmask, gmask, bmask, amask, rshift, gshift, bshift,
-  ashift, rcount, gcount, bcount, acount, px, dst_x, dst_y;
-  float               pe_r, pe_g, pe_b, pe_a;
-  
+  i, dst_ncomp, pltst, nclr, npal, skipped, imsz,
+  src_pad, dst_rem, dst_pad, src_rowst, dst_rowst, dst_csz,
+  masks[4];
+  ImByte             *mask, *icdata;
+  int32_t             step;
+  ImBitOrder          packed;
+  bool                indices, flip, zcopy;
+
   /* DIP header */
+  hdr     = p;
   hsz     = im_get_u32_endian(p, true);
   pltst   = 4;
   plt     = p + hsz;
   p       += 4;
-
-  if (!p_data)
-    p_data = p + hsz;
+  skipped = conf ? conf->bmpSkipped : IM_BMP_SKIPPED_BLACK;
+  flip    = conf && conf->topDown;
 
   if (hsz == 12) { /* BITMAPCOREHEADER, OS21XBITMAPHEADER */
     width  = im_get_u16_endian(p, true);  p += 2;
@@ -97,54 +363,120 @@ dib_dec_mem(ImImage * __restrict im,
     
     if (height_i32 < 0) {
       im->ori = IM_ORIENTATION_UP;
+      flip    = false;
     }
   }
   
+  /* icons: height counts XOR and AND bitmaps */
+  if (icon)
+    height /= 2;
+
+  flip  = flip && height > 0;
+  zcopy = false;
+
   /* ignore planes field: uint16 */
   p    += 2;
   bpp   = (ImByte)im_get_u16_endian(p, true);  p += 2;
+
+  indices = conf && conf->bmpIndices && conf->supportsPal
+            && skipped != IM_BMP_SKIPPED_TRANSPARENT
+            && bpp > 1 && bpp <= 8 && !icon;
+
+  /* icons merge AND mask to 1bpp pixels, they are expanded */
+  packed = conf && bpp == 1 && !icon ? (ImBitOrder)conf->packedBits
+                                     : IM_BITORDER_NONE;
   
-  compr = im_get_u32_endian(p, true);  p += 4;
-  /* imsz  = im_get_u32_endian(p, true); */ p += 4;
-  im->hres  = im_get_i32_endian(p, true);  p += 4;
-  im->vres  = im_get_i32_endian(p, true);  p += 4;
-  
-  p    += 4; /* color used: uint32 */
-  p    += 4; /* color important: uint32 */
-  bfi   = p; /* bitfield maks */
-  
+  /* OS/2 headers may end after any field, core header after bit count */
+  compr = hsz >= 20 ? im_get_u32_endian(hdr + 16, true) : 0;
+  nclr  = hsz >= 36 ? im_get_u32_endian(hdr + 32, true) : 0;
+
+  if (hsz >= 32) {
+    im->hres = im_get_i32_endian(hdr + 24, true);
+    im->vres = im_get_i32_endian(hdr + 28, true);
+  }
+
+  bfi   = hdr + 40; /* bitfield maks */
+
+  /* decoded from file buffer, nothing is extracted */
+  if (compr == IM_BMP_COMPR_JPEG || compr == IM_BMP_COMPR_PNG) {
+    pd_end = p_eof + 1;
+    p_emb  = p_data ? p_data : plt;
+    emblen = p_emb < pd_end ? (size_t)(pd_end - p_emb) : 0;
+    imsz   = hsz >= 24 ? im_get_u32_endian(hdr + 20, true) : 0;
+
+    if (imsz && imsz < emblen)
+      emblen = imsz;
+
+    if (dib_embedded(compr, p_emb, emblen))
+      return dib_dec_embedded(im, p_emb, emblen, compr, conf);
+  }
+
 re_comp:
-  if      (bpp == 1)                                   { src_ncomp = 1; dst_ncomp = 1; }
-  else if (bpp > 1 && bpp <= 8)                        { src_ncomp = 1; dst_ncomp = 3; }
-  else if (bpp == 24)                                  { src_ncomp = 3; dst_ncomp = 3; }
+  if      (bpp == 1)                                   { dst_ncomp = 1; }
+  else if (bpp > 1 && bpp <= 8)                        { dst_ncomp = indices ? 1 : 3; }
+  else if (bpp == 24)                                  { dst_ncomp = 3; }
   else if (bpp == 16) {
     
     
-    if (compr == IM_BMP_COMPR_BITFIELDS || compr == 0) { src_ncomp = 1; dst_ncomp = 3; }
-    else if (compr == IM_BMP_COMPR_ALPHABITFIELDS)     { src_ncomp = 1; dst_ncomp = 4; }
-    else                                               { goto err;                     }
+    if (compr == IM_BMP_COMPR_BITFIELDS || compr == 0) { dst_ncomp = 3; }
+    else if (compr == IM_BMP_COMPR_ALPHABITFIELDS)     { dst_ncomp = 4; }
+    else                                               { goto err;       }
     
   } else if (bpp == 32) {
     
-    if (compr == IM_BMP_COMPR_BITFIELDS)               { src_ncomp = 1; dst_ncomp = 3; }
-    else if (compr == IM_BMP_COMPR_ALPHABITFIELDS)     { src_ncomp = 1; dst_ncomp = 4; }
-    else                                               { src_ncomp = 4; dst_ncomp = 4; }
+    if (compr == IM_BMP_COMPR_BITFIELDS)               { dst_ncomp = 3; }
+    else if (compr == IM_BMP_COMPR_ALPHABITFIELDS)     { dst_ncomp = 4; }
+    else                                               { dst_ncomp = 4; }
     
+  } else if (bpp == 64 && compr == IM_BMP_COMPR_RGB && !icon) {
+    dst_ncomp = 4;
   } else {
     goto err;
   }
   
-  if      (compr == IM_BMP_COMPR_BITFIELDS)      { plt += 12; }
-  else if (compr == IM_BMP_COMPR_ALPHABITFIELDS) { plt += 16; }
+  /* masks follow BITMAPINFOHEADER, V2+ headers include them */
+  if (hsz == 40) {
+    if      (compr == IM_BMP_COMPR_BITFIELDS)      { plt += 12; }
+    else if (compr == IM_BMP_COMPR_ALPHABITFIELDS) { plt += 16; }
+  }
+
+  if ((compr == IM_BMP_COMPR_RLE4  && bpp != 4)
+      || (compr == IM_BMP_COMPR_RLE8  && bpp != 8)
+      || (compr == IM_BMP_COMPR_RLE24 && bpp != 24))
+    goto err;
   
   if (compr != IM_BMP_COMPR_RLE4
       && compr != IM_BMP_COMPR_RLE8
       && compr != IM_BMP_COMPR_RLE24) {
     im->row_pad_last = 4;
+  } else if (skipped == IM_BMP_SKIPPED_TRANSPARENT) {
+    dst_ncomp = 4;
+  }
+
+  /* palette, entries beyond the table or the file are black */
+  npal = nclr ? im_min_i32(nclr, 256) : (bpp <= 8 ? 1u << bpp : 0);
+  if (!p_data)
+    p_data = plt + npal * pltst;
+
+  pal_end = p_data < p_eof + 1 ? p_data : p_eof + 1;
+  if (pal_end < plt)
+    npal = 0;
+  else if ((size_t)(pal_end - plt) < (size_t)npal * pltst)
+    npal = (uint32_t)(pal_end - plt) / pltst;
+
+  memset(pal, 0, sizeof(pal));
+  for (i = 0; i < 256; i++) {
+    if (i < npal)
+      memcpy(pal[i], plt + i * pltst, 3);
+    pal[i][3] = 255;
   }
   
+  /* strides are int32, image size is uint32 */
+  if (((uint64_t)width * bpp + 7) / 8 > INT32_MAX - 3)
+    goto err;
+
   /* minimum bytes to contsruct one row */
-  min_bytes = (uint32_t)ceilf(width * src_ncomp * im_minf((float)bpp / 8.0f, 8));
+  min_bytes = (uint32_t)(((uint64_t)width * bpp + 7) / 8);
   
   /* pad to power of 4 */
   src_pad   = 4 - min_bytes & 3;
@@ -152,11 +484,19 @@ re_comp:
   /* padded one row in bytes */
   src_rowst = min_bytes + src_pad;
   
-  dst_rem   = im->row_pad_last == 0 ? 0 : width * dst_ncomp % im->row_pad_last;
+  /* 64bpp keeps 16-bit components, packed 1bpp keeps file bytes */
+  dst_csz   = bpp == 64 ? 2 : 1;
+  dst_rowb  = packed ? min_bytes : (size_t)width * dst_ncomp * dst_csz;
+  dst_rem   = im->row_pad_last == 0 ? 0 : (uint32_t)(dst_rowb % im->row_pad_last);
   dst_pad   = dst_rem == 0 ? 0 : im->row_pad_last - dst_rem;
-  dst_rowst = dst_pad + width * dst_ncomp;
+
+  if (dst_rowb > (size_t)INT32_MAX - dst_pad
+      || (height && dst_rowb + dst_pad > UINT32_MAX / height))
+    goto err;
+
+  dst_rowst = dst_pad + (uint32_t)dst_rowb;
   
-  imlen                = (width * dst_ncomp + dst_pad) * height;
+  imlen                = dst_rowst * height;
   im->format           = IM_FORMAT_BGR;
   im->len              = imlen;
   im->width            = width;
@@ -166,6 +506,7 @@ re_comp:
   if (compr != IM_BMP_COMPR_CMYK && compr != IM_BMP_COMPR_CMYKRLE8 && compr != IM_BMP_COMPR_CMYKRLE4) {
     if      (dst_ncomp == 3) { im->format = IM_FORMAT_BGR;                                       }
     else if (dst_ncomp == 4) { im->format = IM_FORMAT_BGRA;       im->alphaInfo = IM_ALPHA_LAST; }
+    else if (indices)        { im->format = IM_FORMAT_BGR;                                       }
     else if (dst_ncomp == 1) { im->format = IM_FORMAT_MONOCHROME;                                }
   } else {
     dst_ncomp  = 4;
@@ -177,450 +518,233 @@ re_comp:
    e.g bit per pixel
    */
   
-  im->bytesPerPixel    = dst_ncomp;
-  im->bitsPerComponent = 8;
-  im->bitsPerPixel     = dst_ncomp * 8;
+  im->bytesPerPixel    = dst_ncomp * dst_csz;
+  im->bitsPerComponent = dst_csz * 8;
+  im->bitsPerPixel     = dst_ncomp * dst_csz * 8;
+
+  if (packed) {
+    im->format           = IM_FORMAT_BLACKWHITE;
+    im->bitOrder         = packed;
+    im->bytesPerPixel    = 0;
+    im->bitsPerComponent = 1;
+    im->bitsPerPixel     = 1;
+  }
+
+  /* bit values are palette indices, icons test pixels against zero */
+  if (bpp == 1) {
+    im->monochrome_colors[0] = icon ? 0   : dib_luma(pal[0]);
+    im->monochrome_colors[1] = icon ? 255 : dib_luma(pal[1]);
+  }
+
+  if (bpp == 64) {
+    im->colorSpace = IM_COLORSPACE_LINEAR;
+    im->byteOrder  = IM_BYTEORDER_HOST;
+    im->sampleType = conf && conf->bmp64 == IM_BMP64_UINT16
+                     ? IM_SAMPLE_UINT : IM_SAMPLE_HALF;
+  }
   p                    = p_data;
   p_end                = p_eof;
+
+  /* pixel data offset must be in file, it may end right at EOF */
+  if (p < hdr || p > p_end + 1)
+    goto err;
   
-  /* short path */
+  /* uncompressed rows must be in file, the last one may miss its padding */
+  if (compr != IM_BMP_COMPR_RLE4
+      && compr != IM_BMP_COMPR_RLE8
+      && compr != IM_BMP_COMPR_RLE24
+      && height
+      && (uint64_t)src_rowst * (height - 1) + min_bytes
+           > (uint64_t)(p_end + 1 - p))
+    goto err;
+
+  /* indices keep palette attached, BGR like the expanded pixels */
+  if (indices) {
+    if (!(im->pal = calloc(1, sizeof(*im->pal)))
+        || !(im->pal->pal = malloc(256 * 3)))
+      goto err;
+
+    for (i = 0; i < 256; i++)
+      memcpy(im->pal->pal + i * 3, pal[i], 3);
+
+    im->pal->count = npal ? npal : 1;
+    im->pal->len   = im->pal->count * 3;
+  }
+
+  /* short path, 8bpp is palette indices and needs to be expanded */
   if ((compr == IM_BMP_COMPR_RGB || compr == IM_BMP_COMPR_CMYK)
-      && dst_pad == 0 && src_pad == 0 && (bpp == 8 || bpp == 24 || bpp == 32)) {
+      && ((dst_pad == 0 && src_pad == 0
+           && (bpp == 24 || bpp == 32 || (bpp == 8 && indices)))
+          || (packed == IM_BITORDER_MSB && dst_rowst == src_rowst))) {
     im->data.data = p;
+    im->rowStride = (int32_t)dst_rowst;
+    zcopy         = true;
+
+    /* bottom-up view of file, starts at last row */
+    if (flip) {
+      im->data.data = p + (size_t)dst_rowst * (height - 1);
+      im->rowStride = -(int32_t)dst_rowst;
+      im->ori       = IM_ORIENTATION_UP;
+    }
     goto ok;
   }
   
-  rmask  = 0x7c00;
-  bmask  = 0x1f;
-  gmask  = 0x3e0;
-  rshift = 10;
-  gshift = 5;
-  bshift = 0;
-  ashift = 0;
-  amask  = 0;
-  
-  acount = 0;
-  rcount = gcount = bcount = 5;
-  pe_r   = pe_g = pe_b = pe_a = 1.0f;
-  
   if (bpp == 16 || bpp == 32) {
-    if (compr == 0) {
-      if (bpp == 32) {
-        rshift = 20; gshift = 10; bshift = 0;
-        rcount = gcount = bcount = 10;
-      }
-    } else {
-      rmask  = im_get_u32_endian(bfi,     true);
-      gmask  = im_get_u32_endian(bfi + 4, true);
-      bmask  = im_get_u32_endian(bfi + 8, true);
-      amask  = im_get_u32_endian(bfi + 12, true);
-      
-      if (amask != 0 && compr != IM_BMP_COMPR_ALPHABITFIELDS) {
+    /* BI_RGB 16bpp is X1R5G5B5 */
+    masks[0] = 0x7C00;
+    masks[1] = 0x03E0;
+    masks[2] = 0x001F;
+    masks[3] = 0;
+
+    if (compr != IM_BMP_COMPR_RGB) {
+      masks[0] = im_get_u32_endian(bfi,     true);
+      masks[1] = im_get_u32_endian(bfi + 4, true);
+      masks[2] = im_get_u32_endian(bfi + 8, true);
+
+      /* alpha mask is in V3+ headers or after masks of ALPHABITFIELDS */
+      if (hsz >= 56 || compr == IM_BMP_COMPR_ALPHABITFIELDS)
+        masks[3] = im_get_u32_endian(bfi + 12, true);
+
+      if (masks[3] != 0 && compr != IM_BMP_COMPR_ALPHABITFIELDS) {
         /* include alpha? */
         compr = IM_BMP_COMPR_ALPHABITFIELDS;
         goto re_comp;
       }
-      
-      rshift = im_bitw_ctz(rmask);
-      gshift = im_bitw_ctz(gmask);
-      bshift = im_bitw_ctz(bmask);
-      ashift = im_bitw_ctz(amask);
-      
-      rcount = 32 - im_bitw_clz(rmask) - rshift;
-      gcount = 32 - im_bitw_clz(gmask) - gshift;
-      bcount = 32 - im_bitw_clz(bmask) - bshift;
-      acount = 32 - im_bitw_clz(amask) - ashift;
     }
-    
-    pe_r = (float)255.0f/(powf(2.0f, (float)rcount) - 1.0f);
-    pe_g = (float)255.0f/(powf(2.0f, (float)gcount) - 1.0f);
-    pe_b = (float)255.0f/(powf(2.0f, (float)bcount) - 1.0f);
-    pe_a = (float)255.0f/(powf(2.0f, (float)acount) - 1.0f);
+
+    dib_fields_init(&fields, masks, bpp, dst_ncomp);
   }
   
   im->data.data = im_init_data(im, imlen);
   pd            = im->data.data;
+
+  if (!pd)
+    goto err;
+
+  /* file row i goes to row h - 1 - i, no extra pass to flip image */
+  step          = (int32_t)dst_rowst;
+  im->rowStride = step;
+  if (flip) {
+    pd      += (size_t)dst_rowst * (height - 1);
+    step     = -step;
+    im->ori  = IM_ORIENTATION_UP;
+  }
+
+  if (compr == IM_BMP_COMPR_RLE4
+      || compr == IM_BMP_COMPR_RLE8
+      || compr == IM_BMP_COMPR_RLE24) {
+    rle.src    = (const ImByte *)p;
+    rle.end    = (const ImByte *)p_end + 1;
+    rle.pal    = pal[0];
+    rle.dst    = pd;
+    rle.width  = width;
+    rle.height = height;
+    rle.rowst  = step;
+    rle.ncomp  = dst_ncomp;
+    rle.bpp    = bpp;
+
+    memset(rle.skip, 0, sizeof(rle.skip));
+    if (skipped == IM_BMP_SKIPPED_INDEX0 && bpp != 24 && !indices)
+      memcpy(rle.skip, pal[0], 4);
+    else if (skipped != IM_BMP_SKIPPED_TRANSPARENT)
+      rle.skip[3] = 255;
+
+    dib_rle(&rle);
+  } else {
+    /* uncompressed */
+    rows.fields    = &fields;
+    rows.src       = (const ImByte *)p;
+    rows.plt       = pal[0];
+    rows.mono[0]   = im->monochrome_colors[0];
+    rows.mono[1]   = im->monochrome_colors[1];
+    rows.dst       = pd;
+    rows.width     = width;
+    rows.bpp       = bpp;
+    rows.pltst     = 4;
+    rows.src_rowst = src_rowst;
+    rows.dst_rowst = step;
+
+    if (bpp == 64)
+      rows.kind = im->sampleType == IM_SAMPLE_HALF ? DIB_ROWS_HALF
+                                                   : DIB_ROWS_U16;
+    else if (bpp == 16
+             || (bpp == 32 && (compr == IM_BMP_COMPR_BITFIELDS
+                               || compr == IM_BMP_COMPR_ALPHABITFIELDS)))
+      rows.kind = DIB_ROWS_FIELDS;
+    else if (bpp == 24 || bpp == 32)
+      rows.kind = DIB_ROWS_COPY;
+    else if (packed == IM_BITORDER_LSB)
+      rows.kind = DIB_ROWS_LSB;
+    else if (packed)
+      rows.kind = DIB_ROWS_COPY;
+    else if (bpp == 1)
+      rows.kind = DIB_ROWS_MONO;
+    else if (indices && bpp == 8)
+      rows.kind = DIB_ROWS_COPY;
+    else if (indices)
+      rows.kind = DIB_ROWS_INDEX;
+    else if (bpp == 8)
+      rows.kind = DIB_ROWS_PAL8;
+    else
+      rows.kind = DIB_ROWS_PAL;
+
+    dib_rows_run(&rows, height, imlen);
+  }
   
-  if (bpp == 24 && compr != IM_BMP_COMPR_RLE24) {
-    for (i = 0; i < height; i++) {
-      im_memcpy((char *)pd, p, dst_rowst);
-      p  += dst_rowst;
-      pd += dst_rowst;
-    }
-  } else if (bpp == 16) {
-    if (compr != IM_BMP_COMPR_ALPHABITFIELDS) {
-      for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-          px = im_get_u16_endian(p + i * src_rowst + j * 2, true);
-          
-          pd[i * dst_rowst + j * dst_ncomp + 0] = (ImByte)(((px & bmask) >> bshift) * pe_b);
-          pd[i * dst_rowst + j * dst_ncomp + 1] = (ImByte)(((px & gmask) >> gshift) * pe_g);
-          pd[i * dst_rowst + j * dst_ncomp + 2] = (ImByte)(((px & rmask) >> rshift) * pe_r);
-        }
-      }
-    } else {
-      for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-          px = im_get_u16_endian(p + i * src_rowst + j * 2, true);
-          
-          pd[i * dst_rowst + j * dst_ncomp + 0] = (ImByte)(((px & bmask) >> bshift) * pe_b);
-          pd[i * dst_rowst + j * dst_ncomp + 1] = (ImByte)(((px & gmask) >> gshift) * pe_g);
-          pd[i * dst_rowst + j * dst_ncomp + 2] = (ImByte)(((px & rmask) >> rshift) * pe_r);
-          pd[i * dst_rowst + j * dst_ncomp + 3] = (ImByte)(((px & amask) >> ashift) * pe_a);
-        }
-      }
-    }
-  } else if (bpp == 32) {
-    switch (compr) {
-      case IM_BMP_COMPR_BITFIELDS:
-        for (i = 0; i < height; i++) {
-          for (j = 0; j < width; j++) {
-            px = im_get_u32_endian(p + i * src_rowst + j * 4, true);
-            
-            pd[i * dst_rowst + j * dst_ncomp + 0] = (ImByte)(((px & bmask) >> bshift) * pe_b);
-            pd[i * dst_rowst + j * dst_ncomp + 1] = (ImByte)(((px & gmask) >> gshift) * pe_g);
-            pd[i * dst_rowst + j * dst_ncomp + 2] = (ImByte)(((px & rmask) >> rshift) * pe_r);
-            pd[i * dst_rowst + j * dst_ncomp + 3] = (ImByte)(((px & amask) >> ashift) * pe_a);
-          }
-        }
-        break;
-      case IM_BMP_COMPR_ALPHABITFIELDS:
-        for (i = 0; i < height; i++) {
-          for (j = 0; j < width; j++) {
-            px = im_get_u32_endian(p + i * src_rowst + j * 4, true);
-            
-            pd[i * dst_rowst + j * dst_ncomp + 0] = (ImByte)(((px & bmask) >> bshift) * pe_b);
-            pd[i * dst_rowst + j * dst_ncomp + 1] = (ImByte)(((px & gmask) >> gshift) * pe_g);
-            pd[i * dst_rowst + j * dst_ncomp + 2] = (ImByte)(((px & rmask) >> rshift) * pe_r);
-          }
-        }
-        break;
-      default:
-        for (i = 0; i < height; i++) {
-          im_memcpy((char *)pd, p, dst_rowst);
-          p  += dst_rowst;
-          pd += dst_rowst;
-        }
-        break;
-    }
-  } else if (bpp == 1) {
-    c      = *p;
-    bitoff = 0;
-    
-    for (i = 0; i < height; i++) {
-      for (j = 0; j < width; j++) {
-        pd[i * dst_rowst + j * dst_ncomp] = (c >> 7) * 255;
-        c <<= 1;
-        
-        if (++bitoff > 7) {
-          bitoff = 0;
-          if (src_pad > 0 && j == width - 1) {
-            p += src_pad;
-          }
-          c = *++p;
-        }
-      }
-      
-      if (bitoff != 0) {
-        c      = *++p;
-        bitoff = 0;
-      }
-    }
-  } else if (bpp <= 4 && compr == IM_BMP_COMPR_RLE4) {
-    ImByte cnt, code, idx_a, idx_b, dx, dy;
-    
-    dst_x = dst_y = 0;
-    p     = p_data;
-    
-    while (p < p_end) {
-      cnt  = *p++;
-      code = *p++;
-      
-      if (!cnt) {
-        /* TODO: . */
-        switch (code) {
-          case 0x00: {
-            while(dst_y) {
-              pd = im_setpx3_8(pd, plt);
-              if (++dst_y >= width) {
-                dst_x++;
-                dst_y = 0;
-                break;
-              }
-            }
-            break;
-          }
-          case 0x01: {
-            dst_rem = im_max_i32(width * height - (dst_x * width + dst_y), 0);
-            for (i = 0; i < dst_rem; i++) {
-              pd = im_setpx3_8(pd, plt);
-            }
-            goto ok;
-          }
-          case 0x02: {
-            dy = *p++;
-            dx = *p++;
-            
-            dst_rem = width * dx + dy;
-            
-            for (i = 0; i < dst_rem; i++) {
-              pd = im_setpx3_8(pd, plt);
-              
-              if (++dst_y >= width) {
-                dst_x++;
-                dst_y = 0;
-              }
-            }
-            break;
-          }
-          default: {
-            for (i = 0, c = 0; i < code; i++) {
-              if (!(i & 1)) { c = *p++; }
-              
-              idx = (c >> 4) * pltst;
-              pd  = im_setpx3_8(pd, plt + idx);
-              
-              if (++dst_y < width) {
-                c <<= 4;
-              } else {
-                dst_x++;
-                dst_y = 0;
-                break;
-              }
-            }
-            
-            p += (code - i + 1) / 2 + ((code - i + 1) / 2) & 1;
-            p += (((code + 1) / 2) & 1);
-            break;
-          }
-        }
-      } else {
-        /* Encoded mode */
-        idx_a = code >> 4;
-        idx_b = code & 0xf;
-        
-        for (int32_t k = 0; k < cnt; k++) {
-          idx = ((uint32_t)((k & 1) ? idx_b : idx_a)) * pltst;
-          pd  = im_setpx3_8(pd, plt + idx);
-          
-          if (++dst_y >= width) {
-            dst_x++;
-            dst_y = 0;
-            break;
-          }
-        }
-      }
-    }
-  } else if (bpp <= 8 && compr == IM_BMP_COMPR_RLE8) {
-    ImByte cnt, code, dx, dy;
-    
-    dst_x = dst_y = 0;
-    p     = p_data;
-    
-    while (p < p_end) {
-      cnt  = *p++;
-      code = *p++;
-      
-      if (!cnt) {
-        /* TODO: . */
-        switch (code) {
-          case 0x00: {
-            while(dst_y) {
-              pd = im_setpx3_8(pd, plt);
-              if (++dst_y >= width) {
-                dst_x++;
-                dst_y = 0;
-                break;
-              }
-            }
-            break;
-          }
-          case 0x01: {
-            dst_rem = im_max_i32(width * height - (dst_x * width + dst_y), 0);
-            for (i = 0; i < dst_rem; i++) {
-              pd = im_setpx3_8(pd, plt);
-            }
-            goto ok;
-          }
-          case 0x02: {
-            dy = *p++;
-            dx = *p++;
-            
-            dst_rem = width * dx + dy;
-            
-            for (i = 0; i < dst_rem; i++) {
-              pd = im_setpx3_8(pd, plt);
-              
-              if (++dst_y >= width) {
-                dst_x++;
-                dst_y = 0;
-              }
-            }
-            break;
-          }
-          default: {
-            /* Absolute mode */
-            for (i = 0; i < code; i++) {
-              idx = ((ImByte)*p++) * pltst;
-              pd  = im_setpx3_8(pd, plt + idx);
-              
-              if (++dst_y >= width) {
-                dst_x++;
-                dst_y = 0;
-                break;
-              }
-            }
-            
-            p += (code - i) + (code - i) & 1;
-            p += code & 1;
-            break;
-          }
-        }
-      } else {
-        /* Encoded mode */
-        for (i = 0; i < cnt; i++) {
-          idx = code * pltst;
-          pd  = im_setpx3_8(pd, plt + idx);
-          
-          if (++dst_y >= width) {
-            dst_x++;
-            dst_y = 0;
-            break;
-          }
-        }
-      }
-    }
-  } else if (bpp == 24 && compr == IM_BMP_COMPR_RLE24) {
-    ImByte cnt, code, dx, dy;
-    
-    dst_x = dst_y = 0;
-    p     = p_data;
-    
-    while (p < p_end) {
-      cnt  = *p++;
-      code = *p++;
-      
-      if (!cnt) {
-        /* TODO: . */
-        switch (code) {
-          case 0x00: {
-            while(dst_y) {
-              *pd++ = 0;
-              *pd++ = 0;
-              *pd++ = 0;
-              if (++dst_y >= width) {
-                dst_x++;
-                dst_y = 0;
-                break;
-              }
-            }
-            break;
-          }
-          case 0x01: {
-            dst_rem = im_max_i32(width * height - (dst_x * width + dst_y), 0);
-            for (i = 0; i < dst_rem; i++) {
-              *pd++ = 0;
-              *pd++ = 0;
-              *pd++ = 0;
-            }
-            goto ok;
-          }
-          case 0x02: {
-            dy = *p++;
-            dx = *p++;
-            
-            dst_rem = width * dx + dy;
-            
-            for (i = 0; i < dst_rem; i++) {
-              *pd++ = 0;
-              *pd++ = 0;
-              *pd++ = 0;
-
-              if (++dst_y >= width) {
-                dst_x++;
-                dst_y = 0;
-              }
-            }
-            break;
-          }
-          default: {
-            /* Absolute mode */
-            for (i = 0; i < code; i++) {
-              *pd++ = *p++;
-              *pd++ = *p++;
-              *pd++ = *p++;
-
-              if (++dst_y >= width) {
-                dst_x++;
-                dst_y = 0;
-                break;
-              }
-            }
-            
-            p += (code - i) + (code - i) & 1;
-            p += code & 1;
-            break;
-          }
-        }
-      } else {
-        /* Encoded mode */
-
-        for (i = 0; i < cnt; i++) {
-          *pd++ = code;
-          *pd++ = p[0];
-          *pd++ = p[1];
-
-          if (++dst_y >= width) {
-            dst_x++;
-            dst_y = 0;
-            break;
-          }
-        }
-        
-        p += 2;
-      }
-    }
-  } else if (bpp == 8) {
-    for (i = 0; i < height; i++) {
-      for (j = 0; j < width; j++) {
-        idx = ((uint8_t)p[i * src_rowst + j]) * pltst;
-        
-        pd[i * dst_rowst + j * dst_ncomp + 0] = plt[idx + 0];
-        pd[i * dst_rowst + j * dst_ncomp + 1] = plt[idx + 1];
-        pd[i * dst_rowst + j * dst_ncomp + 2] = plt[idx + 2];
-      }
+ok:
+  if (icon) {
+    /* AND mask of compressed XOR bitmap can't be located, it is opaque */
+    mask = NULL;
+    if (compr == IM_BMP_COMPR_RGB || compr == IM_BMP_COMPR_BITFIELDS) {
+      mask = (ImByte *)p_data + (size_t)src_rowst * height;
+      if ((char *)mask > p_eof + 1
+          || (size_t)(p_eof + 1 - (char *)mask)
+               < (size_t)(((width + 31) >> 5) << 2) * height)
+        mask = NULL;
     }
-  } else if (bpp < 8) {
-    c      = *p;
-    bitoff = 0;
-    
-    for (i = 0; i < height; i++) {
-      for (j = 0; j < width; j++) {
-        idx = (c >> (8 - bpp)) * pltst;
-        c <<= bpp;
-        
-        pd[i * dst_rowst + j * dst_ncomp + 0] = plt[idx + 0];
-        pd[i * dst_rowst + j * dst_ncomp + 1] = plt[idx + 1];
-        pd[i * dst_rowst + j * dst_ncomp + 2] = plt[idx + 2];
-        
-        if ((bitoff += bpp) > 7) {
-          bitoff = 0;
-          if (src_pad > 0 && j == width - 1) {
-            p += src_pad;
-          }
-          c = *++p;
-        }
-      }
-      
-      if (bitoff != 0) {
-        c      = *++p;
-        bitoff = 0;
-      }
+
+    if (!(icdata = dib_icon_alpha(im, mask, (const ImByte (*)[4])pal, flip)))
+      goto err;
+
+    if (icdata != im->data.data) {
+      if (!zcopy)
+        free(im->data.data);
+      im->data.data = icdata;
     }
   }
-  
-ok:
+
   return IM_OK;
 err:
+  /* nothing stays attached on failure, BMP, DIB and ICO loaders only free
+     im itself */
+  if (im->pal) {
+    free(im->pal->pal);
+    free(im->pal);
+    im->pal = NULL;
+  }
+
+  if (!zcopy)
+    free(im->data.data);
+
+  im->data.data = NULL;
   return IM_ERR;
 }
+
+IM_HIDE
+ImResult
+dib_dec_mem(ImImage          * __restrict im,
+            char             * __restrict p,
+            char             * __restrict p_data,
+            char             * __restrict p_eof,
+            im_open_config_t * __restrict conf) {
+  return dib_dec_core(im, p, p_data, p_eof, conf, false);
+}
+
+IM_HIDE
+ImResult
+dib_dec_icon(ImImage          * __restrict im,
+             char             * __restrict p,
+             char             * __restrict p_eof,
+             im_open_config_t * __restrict conf) {
+  return dib_dec_core(im, p, NULL, p_eof, conf, true);
+}
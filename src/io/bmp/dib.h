@@ -27,9 +27,18 @@ dib_dec(ImImage         ** __restrict dest,
 
 IM_HIDE
 ImResult
-dib_dec_mem(ImImage * __restrict im,
-            char    * __restrict p,
-            char    * __restrict p_data,
-            char    * __restrict p_eof);
+dib_dec_mem(ImImage          * __restrict im,
+            char             * __restrict p,
+            char             * __restrict p_data,
+            char             * __restrict p_eof,
+            im_open_config_t * __restrict conf);
+
+/* ICO / CUR entry: XOR bitmap, AND mask gives alpha, result is BGRA */
+IM_HIDE
+ImResult
+dib_dec_icon(ImImage          * __restrict im,
+             char             * __restrict p,
+             char             * __restrict p_eof,
+             im_open_config_t * __restrict conf);
 
 #endif /* sc_dib_h */
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rle.h"
+
+/*
+ fill len bytes with repeating pattern of plen bytes; filled part is doubled
+ each step so long runs and skips are moved by memcpy with wide stores
+ */
+static
+void
+dib_fill(ImByte       * __restrict d,
+         const ImByte * __restrict pat,
+         size_t                    plen,
+         size_t                    len) {
+  size_t k;
+
+  if (plen == 1) {
+    memset(d, pat[0], len);
+    return;
+  }
+
+  if (len <= plen) {
+    memcpy(d, pat, len);
+    return;
+  }
+
+  memcpy(d, pat, plen);
+  for (k = plen; k < len; k += k)
+    memcpy(d + k, d, k < len - k ? k : len - k);
+}
+
+IM_INLINE
+ImByte *
+dib_rle_row(const DibRle * __restrict rle, uint32_t y) {
+  return rle->dst + (ptrdiff_t)y * rle->rowst;
+}
+
+/* palette entry of index or index itself */
+IM_INLINE
+void
+dib_rle_px(const DibRle * __restrict rle, ImByte * __restrict px, ImByte idx) {
+  switch (rle->ncomp) {
+    case 1:  px[0] = idx;                          break;
+    case 3:  memcpy(px, rle->pal + idx * 4, 3);    break;
+    default: memcpy(px, rle->pal + idx * 4, 4);    break;
+  }
+}
+
+/* skipped pixels from (x0, y0) up to (x1, y1), rows are in file order */
+static
+void
+dib_rle_skip(const DibRle * __restrict rle,
+             uint32_t                  x0,
+             uint32_t                  y0,
+             uint32_t                  x1,
+             uint32_t                  y1) {
+  uint32_t nc;
+
+  nc = rle->ncomp;
+
+  if (y1 >= rle->height) {
+    y1 = rle->height;
+    x1 = 0;
+  }
+
+  for (; y0 < y1; y0++, x0 = 0)
+    dib_fill(dib_rle_row(rle, y0) + x0 * nc,
+             rle->skip,
+             nc,
+             (size_t)(rle->width - x0) * nc);
+
+  if (y0 < rle->height && x1 > x0)
+    dib_fill(dib_rle_row(rle, y0) + x0 * nc,
+             rle->skip,
+             nc,
+             (size_t)(x1 - x0) * nc);
+}
+
+/* absolute mode, n pixels of s are stored to d */
+static
+void
+dib_rle_abs(const DibRle * __restrict rle,
+            const ImByte * __restrict s,
+            ImByte       * __restrict d,
+            uint32_t                  n) {
+  const ImByte *c;
+  uint32_t      i, nc;
+
+  nc = rle->ncomp;
+
+  switch (rle->bpp) {
+    case 8:
+      if (nc == 1) {
+        memcpy(d, s, n);
+        break;
+      }
+
+      for (i = 0; i < n; i++, d += nc) {
+        c = rle->pal + s[i] * 4;
+        d[0] = c[0];
+        d[1] = c[1];
+        d[2] = c[2];
+        if (nc == 4) d[3] = c[3];
+      }
+      break;
+    case 4:
+      for (i = 0; i < n; i++, d += nc)
+        dib_rle_px(rle, d, (s[i >> 1] >> (~i & 1) * 4) & 15);
+      break;
+    default:
+      if (nc == 3) {
+        memcpy(d, s, n * 3);
+        break;
+      }
+
+      for (i = 0; i < n; i++, d += 4, s += 3) {
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+        d[3] = 255;
+      }
+      break;
+  }
+}
+
+IM_HIDE
+void
+dib_rle(const DibRle * __restrict rle) {
+  const ImByte *s, *end;
+  ImByte       *d, px[8];
+  uint32_t      x, y, w, nc, n, cnt, code, len;
+
+  s   = rle->src;
+  end = rle->end;
+  w   = rle->width;
+  nc  = rle->ncomp;
+  x   = y = 0;
+
+  while (y < rle->height && end - s >= 2) {
+    cnt  = s[0];
+    code = s[1];
+    s   += 2;
+    d    = dib_rle_row(rle, y) + x * nc;
+
+    /* encoded mode, pixels beyond row are dropped */
+    if (cnt) {
+      n = im_min_i32(cnt, w - x);
+
+      if (rle->bpp == 8) {
+        dib_rle_px(rle, px, code);
+        dib_fill(d, px, nc, (size_t)n * nc);
+      } else if (rle->bpp == 4) {
+        /* two alternating indices */
+        dib_rle_px(rle, px,      code >> 4);
+        dib_rle_px(rle, px + nc, code & 15);
+        dib_fill(d, px, 2 * nc, (size_t)n * nc);
+      } else {
+        if (end - s < 2)
+          break;
+
+        px[0] = code;
+        px[1] = s[0];
+        px[2] = s[1];
+        px[3] = 255;
+        s    += 2;
+        dib_fill(d, px, nc, (size_t)n * nc);
+      }
+
+      x += n;
+      continue;
+    }
+
+    switch (code) {
+      case 0: /* end of line */
+        dib_rle_skip(rle, x, y, 0, y + 1);
+        x = 0;
+        y++;
+        break;
+      case 1: /* end of bitmap */
+        goto done;
+      case 2: /* delta, right and up (next rows in file order) */
+        if (end - s < 2)
+          goto done;
+
+        n = im_min_i32(x + s[0], w);
+        dib_rle_skip(rle, x, y, n, y + s[1]);
+        y += s[1];
+        x  = n;
+        s += 2;
+        break;
+      default: /* absolute mode, padded to 16-bit */
+        if      (rle->bpp == 8) len = code;
+        else if (rle->bpp == 4) len = (code + 1) >> 1;
+        else                    len = code * 3;
+
+        if ((size_t)(end - s) < len)
+          goto done;
+
+        n  = im_min_i32(code, w - x);
+        dib_rle_abs(rle, s, d, n);
+        x += n;
+        s += len + (len & 1);
+        break;
+    }
+  }
+
+done:
+  dib_rle_skip(rle, x, y, 0, rle->height);
+}
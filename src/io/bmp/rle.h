@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef sc_bmp_rle_h
+#define sc_bmp_rle_h
+
+#include "../common.h"
+
+/* BI_RLE4, BI_RLE8 and OS/2 RLE24 stream, rows are in file order */
+typedef struct DibRle {
+  const ImByte *src;
+  const ImByte *end;      /* one past last byte of stream           */
+  const ImByte *pal;      /* 256 BGRA entries, unused for RLE24     */
+  ImByte       *dst;
+  ImByte        skip[4];  /* written to pixels the stream skips     */
+  uint32_t      width;
+  uint32_t      height;
+  int32_t       rowst;    /* dst row stride in bytes                */
+  uint32_t      ncomp;    /* 1: palette indices, 3: BGR, 4: BGRA    */
+  uint32_t      bpp;      /* 4, 8 or 24                             */
+} DibRle;
+
+/* every destination pixel is written once, by a run or as skipped */
+IM_HIDE
+void
+dib_rle(const DibRle * __restrict rle);
+
+#endif /* sc_bmp_rle_h */
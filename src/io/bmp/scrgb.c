@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "scrgb.h"
+
+#if defined(__F16C__)
+#  include <immintrin.h>
+#endif
+
+/*
+ s2.13 covers -4 to 4 - 2^-13, every non zero value is a normal half and
+ v / 8192 is exact in float, so a single round to nearest even is needed:
+   half = (bits(float) - (112 << 23) + 0xFFF + lsb) >> 13, 0 stays 0
+
+ uint16 keeps round(v * 65535 / 8192) for v in 0 - 8192 which is
+   (v << 3) - (v > 4096), wrapping 65536 - 1 in 16 bits
+ */
+#define DIB_S213_ONE    8192
+#define DIB_S213_HALF   4096
+#define DIB_HALF_REBIAS (112u << 23)
+
+IM_INLINE
+uint16_t
+dib_s213_half(int16_t v) {
+  union { float f; uint32_t u; } c;
+  uint32_t t;
+
+  if (v == 0)
+    return 0;
+
+  c.f = (float)v * (1.0f / DIB_S213_ONE);
+  t   = (c.u & 0x7FFFFFFF) - DIB_HALF_REBIAS;
+  t  += 0xFFF + ((t >> 13) & 1);
+
+  return (uint16_t)(((c.u >> 16) & 0x8000) | (t >> 13));
+}
+
+IM_INLINE
+uint16_t
+dib_s213_u16(int16_t v) {
+  if (v <= 0)
+    return 0;
+
+  if (v >= DIB_S213_ONE)
+    return 0xFFFF;
+
+  return (uint16_t)((v << 3) - (v > DIB_S213_HALF));
+}
+
+IM_HIDE
+void
+dib_s213_half_row(const ImByte * __restrict src,
+                  uint16_t     * __restrict dst,
+                  uint32_t                  width) {
+  uint32_t i, n;
+
+  i = 0;
+  n = width * 4;
+
+#if defined(__F16C__)
+  {
+    __m128i v, lo, hi;
+    __m128  k;
+
+    k = _mm_set1_ps(1.0f / DIB_S213_ONE);
+    for (; i + 8 <= n; i += 8) {
+      v  = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      lo = _mm_cvtps_ph(_mm_mul_ps(_mm_cvtepi32_ps(lo), k),
+                        _MM_FROUND_TO_NEAREST_INT);
+      hi = _mm_cvtps_ph(_mm_mul_ps(_mm_cvtepi32_ps(hi), k),
+                        _MM_FROUND_TO_NEAREST_INT);
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi64(lo, hi));
+    }
+  }
+#elif defined(__SSE2__)
+  {
+    __m128i v, t, s, z, lo, hi, one, fff, rb, mag;
+    __m128  k;
+
+    k   = _mm_set1_ps(1.0f / DIB_S213_ONE);
+    one = _mm_set1_epi32(1);
+    fff = _mm_set1_epi32(0xFFF);
+    rb  = _mm_set1_epi32(DIB_HALF_REBIAS);
+    mag = _mm_set1_epi32(0x7FFFFFFF);
+
+    /* I: component in high 16 bits of each lane */
+#define DIB_HALF4(I, R)                                                     \
+    z = _mm_srai_epi32(I, 16);                                            \
+    t = _mm_castps_si128(_mm_mul_ps(_mm_cvtepi32_ps(z), k));              \
+    s = _mm_and_si128(_mm_srli_epi32(t, 16), _mm_set1_epi32(0x8000));     \
+    z = _mm_cmpeq_epi32(z, _mm_setzero_si128());                          \
+    t = _mm_sub_epi32(_mm_and_si128(t, mag), rb);                         \
+    t = _mm_add_epi32(t, _mm_add_epi32(fff,                               \
+                         _mm_and_si128(_mm_srli_epi32(t, 13), one)));     \
+    R = _mm_andnot_si128(z, _mm_or_si128(s, _mm_srli_epi32(t, 13)))
+
+    for (; i + 8 <= n; i += 8) {
+      v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      DIB_HALF4(_mm_unpacklo_epi16(v, v), lo);
+      DIB_HALF4(_mm_unpackhi_epi16(v, v), hi);
+
+      /* halves fit in 16 bits, bias for signed pack */
+      lo = _mm_sub_epi32(lo, _mm_set1_epi32(0x8000));
+      hi = _mm_sub_epi32(hi, _mm_set1_epi32(0x8000));
+      v  = _mm_xor_si128(_mm_packs_epi32(lo, hi), _mm_set1_epi16((short)0x8000));
+      _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+
+#undef DIB_HALF4
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  {
+    int16x8_t v;
+
+    for (; i + 8 <= n; i += 8) {
+      v = vld1q_s16((const int16_t *)(src + i * 2));
+      vst1_u16(dst + i,
+               vreinterpret_u16_f16(vcvt_f16_f32(
+                 vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),
+                             1.0f / DIB_S213_ONE))));
+      vst1_u16(dst + i + 4,
+               vreinterpret_u16_f16(vcvt_f16_f32(
+                 vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))),
+                             1.0f / DIB_S213_ONE))));
+    }
+  }
+#endif
+
+  for (; i < n; i++)
+    dst[i] = dib_s213_half((int16_t)im_get_u16_endian((ImByte *)src + i * 2, true));
+}
+
+IM_HIDE
+void
+dib_s213_u16_row(const ImByte * __restrict src,
+                 uint16_t     * __restrict dst,
+                 uint32_t                  width) {
+  uint32_t i, n;
+
+  i = 0;
+  n = width * 4;
+
+#if defined(__SSE2__)
+  {
+    __m128i v, one, half;
+
+    one  = _mm_set1_epi16(DIB_S213_ONE);
+    half = _mm_set1_epi16(DIB_S213_HALF);
+
+    for (; i + 8 <= n; i += 8) {
+      v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      v = _mm_min_epi16(_mm_max_epi16(v, _mm_setzero_si128()), one);
+      v = _mm_add_epi16(_mm_slli_epi16(v, 3), _mm_cmpgt_epi16(v, half));
+      _mm_storeu_si128((__m128i *)(dst + i), v);
+    }
+  }
+#elif defined(__ARM_NEON)
+  {
+    int16x8_t v;
+
+    for (; i + 8 <= n; i += 8) {
+      v = vld1q_s16((const int16_t *)(src + i * 2));
+      v = vminq_s16(vmaxq_s16(v, vdupq_n_s16(0)), vdupq_n_s16(DIB_S213_ONE));
+      v = vaddq_s16(vshlq_n_s16(v, 3),
+                    vreinterpretq_s16_u16(vcgtq_s16(v,
+                                          vdupq_n_s16(DIB_S213_HALF))));
+      vst1q_u16(dst + i, vreinterpretq_u16_s16(v));
+    }
+  }
+#endif
+
+  for (; i < n; i++)
+    dst[i] = dib_s213_u16((int16_t)im_get_u16_endian((ImByte *)src + i * 2, true));
+}
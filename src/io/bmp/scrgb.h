@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef sc_bmp_scrgb_h
+#define sc_bmp_scrgb_h
+
+#include "../common.h"
+
+/*
+ 64bpp DIB: B, G, R, A as signed 2.13 fixed point, linear, 8192 is 1.0.
+ Rows are converted component by component so layout stays BGRA
+ */
+IM_HIDE
+void
+dib_s213_half_row(const ImByte * __restrict src,
+                  uint16_t     * __restrict dst,
+                  uint32_t                  width);
+
+/* clamped to 0 - 1 then scaled to 0 - 65535, still linear */
+IM_HIDE
+void
+dib_s213_u16_row(const ImByte * __restrict src,
+                 uint16_t     * __restrict dst,
+                 uint32_t                  width);
+
+#endif /* sc_bmp_scrgb_h */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ico.h"
+#include "../bmp/dib.h"
+#include "../png/png.h"
+#include "../../file.h"
+#include "../../endian.h"
+
+/*
+ References:
+ [0] https://en.wikipedia.org/wiki/ICO_(file_format)
+ [1] https://docs.microsoft.com/en-us/previous-versions/ms997538(v=msdn.10)
+ */
+
+#define ICO_DIR_SIZE   6
+#define ICO_ENTRY_SIZE 16
+
+typedef struct ico_entry_t {
+  uint32_t edge;   /* larger of width and height, 0 in directory is 256 */
+  uint32_t bpp;
+  uint32_t size;
+  uint32_t offset;
+} ico_entry_t;
+
+static
+void
+ico_entry(ImByte * __restrict p, ico_entry_t * __restrict e) {
+  uint32_t w, h;
+
+  w = p[0] ? p[0] : 256;
+  h = p[1] ? p[1] : 256;
+
+  /* CUR keeps hotspot in planes / bit count, PNG entries often leave it 0 */
+  e->edge   = im_max_i32(w, h);
+  e->bpp    = im_get_u16_endian(p + 6, true);
+  e->size   = im_get_u32_endian(p + 8, true);
+  e->offset = im_get_u32_endian(p + 12, true);
+
+  if (e->bpp == 0 || e->bpp > 32)
+    e->bpp = p[2] ? 8 : 32;
+}
+
+/* smallest entry that covers target, else largest; deeper one wins ties */
+static
+bool
+ico_better(const ico_entry_t * __restrict a,
+           const ico_entry_t * __restrict b,
+           uint32_t                       target) {
+  bool fa, fb;
+
+  fa = !target || a->edge >= target;
+  fb = !target || b->edge >= target;
+
+  if (fa != fb)
+    return fa;
+
+  if (a->edge != b->edge)
+    return (fa && target) ? a->edge < b->edge : a->edge > b->edge;
+
+  return a->bpp > b->bpp;
+}
+
+IM_HIDE
+ImResult
+ico_dec(ImImage         ** __restrict dest,
+        const char       * __restrict path,
+        im_open_config_t * __restrict open_config) {
+  ImImage     *im;
+  ImByte      *p, *p_img;
+  ico_entry_t  best, e;
+  ImFileResult fres;
+  uint32_t     type, count, i;
+  bool         found;
+
+  im   = NULL;
+  fres = im_readfile(path, open_config->openIntent != IM_OPEN_INTENT_READWRITE);
+
+  if (fres.ret != IM_OK)
+    goto err;
+
+  p = fres.raw;
+
+  /* ICONDIR: reserved, type (1: icon, 2: cursor), count */
+  if (fres.size < ICO_DIR_SIZE || im_get_u16_endian(p, true) != 0)
+    goto err;
+
+  type  = im_get_u16_endian(p + 2, true);
+  count = im_get_u16_endian(p + 4, true);
+
+  if ((type != 1 && type != 2)
+      || fres.size < ICO_DIR_SIZE + (size_t)count * ICO_ENTRY_SIZE)
+    goto err;
+
+  /* only the directory is read to select, entries that are out of file
+     are skipped */
+  found = false;
+  memset(&best, 0, sizeof(best));
+
+  for (i = 0; i < count; i++) {
+    ico_entry(p + ICO_DIR_SIZE + i * ICO_ENTRY_SIZE, &e);
+
+    if (e.offset >= fres.size || e.size > fres.size - e.offset || e.size < 12)
+      continue;
+
+    if (!found || ico_better(&e, &best, open_config->icoSize)) {
+      best  = e;
+      found = true;
+    }
+  }
+
+  if (!found)
+    goto err;
+
+  /* decoded in place, PNG or headerless DIB with AND mask */
+  p_img = p + best.offset;
+
+  if (best.size >= 8 && memcmp(p_img, "\x89PNG\r\n\x1a\n", 8) == 0) {
+    if (png_dec_mem(&im, p_img, best.size, open_config) != IM_OK)
+      goto err;
+  } else {
+    if (!(im = calloc(1, sizeof(*im))))
+      goto err;
+
+    if (dib_dec_icon(im,
+                     (char *)p_img,
+                     (char *)p_img + best.size - 1,
+                     open_config) != IM_OK)
+      goto err;
+  }
+
+  im->fileFormatType = type == 2 ? IM_FILEFORMATTYPE_CUR
+                                 : IM_FILEFORMATTYPE_ICO;
+
+  /* 32bpp entries may point into file */
+  fres.mustfree = !fres.mmap;
+  *dest         = im;
+  im->file      = fres;
+
+  return IM_OK;
+err:
+  if (fres.mmap) {
+    im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
+  }
+
+  if (im) {
+    free(im);
+  }
+
+  *dest = NULL;
+  return IM_ERR;
+}
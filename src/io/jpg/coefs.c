@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "coefs.h"
+#include "dec/dec.h"
+
+#include <stdlib.h>
+
+extern uint32_t unzig[64];
+
+/* blocks of a component inside the image, MCU padding is not counted */
+IM_INLINE
+uint32_t
+jpg_coefs_blocks(uint32_t size, uint32_t sf, uint32_t sfmax) {
+  return ((size * sf + sfmax - 1) / sfmax + 7) / 8;
+}
+
+IM_HIDE
+ImResult
+jpg_coefs_mem(ImJpegCoefs     ** __restrict dest,
+              ImByte           * __restrict raw,
+              size_t                        size,
+              im_open_config_t * __restrict conf) {
+  ImJpeg          *jpg;
+  ImFrm           *frm;
+  ImComponent     *comp;
+  ImJpegCoefs     *res;
+  ImJpegCoefPlane *pl;
+  int16_t         *src, *dst;
+  size_t           total;
+  uint32_t         Nf, K, k, i, j, t, bw;
+
+  *dest = NULL;
+
+  if (!(jpg = jpg_dec_coef(raw, size, conf)))
+    return IM_ERR;
+
+  frm = &jpg->frm;
+  Nf  = im_min_i32(frm->Nf, 4);
+  K   = conf->coefCount && conf->coefCount < 64 ? conf->coefCount : 64;
+
+  total = sizeof(*res);
+  for (k = 0; k < Nf; k++) {
+    comp   = &frm->compo[k];
+    total += sizeof(int16_t) * K
+           * jpg_coefs_blocks(frm->width,  comp->sf.H, frm->hmax)
+           * jpg_coefs_blocks(frm->height, comp->sf.V, frm->vmax);
+  }
+
+  if (!(res = calloc(1, total))) {
+    jpg_dec_coef_free(jpg);
+    return IM_ENOMEM;
+  }
+
+  res->width          = frm->width;
+  res->height         = frm->height;
+  res->count          = K;
+  res->componentCount = Nf;
+  dst                 = (int16_t *)(res + 1);
+
+  for (k = 0; k < Nf; k++) {
+    comp           = &frm->compo[k];
+    pl             = &res->comp[k];
+    pl->coef       = dst;
+    pl->id         = comp->id;
+    pl->H          = comp->sf.H;
+    pl->V          = comp->sf.V;
+    pl->blocksWide = jpg_coefs_blocks(frm->width,  pl->H, frm->hmax);
+    pl->blocksHigh = jpg_coefs_blocks(frm->height, pl->V, frm->vmax);
+    bw             = (frm->width + frm->hmax * 8 - 1) / (frm->hmax * 8) * pl->H;
+
+    for (t = 0; t < 64; t++)
+      pl->quant[t] = jpg->dqt[comp->Tq & 3].qt[unzig[t]];
+
+    /* natural order in decoder, zig-zag here so first K are low bands */
+    for (i = 0; i < pl->blocksHigh; i++) {
+      src = jpg->coef[k] + (size_t)i * bw * 64;
+
+      for (j = 0; j < pl->blocksWide; j++, src += 64, dst += K) {
+        for (t = 0; t < K; t++)
+          dst[t] = src[unzig[t]];
+      }
+    }
+  }
+
+  jpg_dec_coef_free(jpg);
+  *dest = res;
+
+  return IM_OK;
+}
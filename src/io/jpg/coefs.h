@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef src_jpg_coefs_h
+#define src_jpg_coefs_h
+
+#include "common.h"
+
+/* entropy decoding only, quantized coefficients in one allocation */
+IM_HIDE
+ImResult
+jpg_coefs_mem(ImJpegCoefs     ** __restrict dest,
+              ImByte           * __restrict raw,
+              size_t                        size,
+              im_open_config_t * __restrict conf);
+
+#endif /* src_jpg_coefs_h */
@@ -61,7 +61,7 @@ jpg_get_ui16(ImByte *buff) {
 IM_INLINE
 bool
 jpg_is_app_marker(JPGMarker mrk) {
-  return JPG_APPn(F) == (JPG_APPn(F) & mrk);
+  return (mrk & 0xF0FF) == JPG_APPn(0);
 }
 
 IM_INLINE
@@ -76,4 +76,15 @@ jfif_dec_skip_ext(ImByte *raw) {
   return raw + jpg_get_ui16(raw);
 }
 
+/* stop entropy decoding, reconstruction drains queued rows then exits */
+IM_INLINE
+void
+jpg_dec_exit(ImJpeg * __restrict jpg) {
+  if (jpg->unwind)
+    longjmp(*jpg->unwind, 1);
+
+  thread_ring_close(&jpg->ring);
+  thread_exit();
+}
+
 #endif /* jpg_common_h */
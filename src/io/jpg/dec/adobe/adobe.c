@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "adobe.h"
+
+IM_HIDE
+ImByte*
+adobe_dec(ImByte *raw, ImJpeg *jpg) {
+  uint16_t len;
+
+  len = jpg_get_ui16(raw);
+
+  /* "Adobe" version(2) flags0(2) flags1(2) transform(1) */
+  if (len < 14 || memcmp(raw + 2, "Adobe", 5) != 0)
+    return raw + len;
+
+  jpg->adobe          = true;
+  jpg->adobeTransform = raw[13];
+
+  return raw + len;
+}
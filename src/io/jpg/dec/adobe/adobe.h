@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef src_jpg_adobe_h
+#define src_jpg_adobe_h
+
+#include "../../common.h"
+
+/* parses APP14 Adobe color transform, returns end of segment */
+IM_HIDE
+ImByte*
+adobe_dec(ImByte *raw, ImJpeg *jpg);
+
+#endif /* src_jpg_adobe_h */
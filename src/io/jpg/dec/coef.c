@@ -0,0 +1,480 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "coef.h"
+#include "scan.h"
+#include "huff.h"
+#include "recon.h"
+#include "restart.h"
+
+extern uint32_t unzig[64];
+
+IM_INLINE
+uint32_t
+jpg_mcux(ImFrm * __restrict frm) {
+  return (frm->width + (frm->hmax * 8) - 1) / (frm->hmax * 8);
+}
+
+IM_INLINE
+uint32_t
+jpg_mcuy(ImFrm * __restrict frm) {
+  return (frm->height + (frm->vmax * 8) - 1) / (frm->vmax * 8);
+}
+
+static
+bool
+jpg_coef_alloc(ImJpeg * __restrict jpg) {
+  ImFrm   *frm;
+  size_t   nblk;
+  uint32_t k, Nf;
+
+  frm = &jpg->frm;
+  Nf  = im_min_i32(frm->Nf, 4);
+
+  /* padded to whole MCUs so interleaved and non-interleaved scans agree */
+  for (k = 0; k < Nf; k++) {
+    nblk = (size_t)jpg_mcux(frm) * frm->compo[k].sf.H
+         * jpg_mcuy(frm) * frm->compo[k].sf.V;
+
+    if (!(jpg->coef[k] = calloc(nblk * 64, sizeof(int16_t)))) {
+      jpg_coef_free(jpg);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+IM_HIDE
+void
+jpg_coef_free(ImJpeg * __restrict jpg) {
+  uint32_t k;
+
+  for (k = 0; k < 4; k++) {
+    free(jpg->coef[k]);
+    jpg->coef[k] = NULL;
+  }
+}
+
+/* end of entropy-coded segment: first marker which is not RSTn */
+static
+ImByte*
+jpg_coef_skip(ImByte * __restrict p, ImByte * __restrict pEnd) {
+  while ((p = memchr(p, 0xFF, pEnd - p)) && p + 1 < pEnd) {
+    if (p[1] == 0x00 || p[1] == 0xFF || (p[1] & 0xF8) == 0xD0) {
+      p++;
+      continue;
+    }
+
+    return p;
+  }
+
+  return pEnd;
+}
+
+/*
+ a band can be left out unless a later refinement scan of same component also
+ covers the kept band, G.1.2.3 needs to know which coefficients are non-zero
+ */
+static
+bool
+jpg_coef_skippable(ImJpeg   * __restrict jpg,
+                   ImScan   * __restrict scan,
+                   ImByte   * __restrict p,
+                   uint32_t              K) {
+  ImByte   *pEnd;
+  JPGMarker mrk;
+  uint32_t  Ns, Ss, Se, i, j;
+
+  pEnd = jpg->pRawEnd;
+
+  while ((p = jpg_coef_skip(p, pEnd)) + 4 <= pEnd) {
+    if ((mrk = jpg_marker(p)) == JPG_EOI)
+      break;
+
+    p += JPP_MARKER_SIZE;
+    if (mrk != JPG_SOS) {
+      p += jpg_get_ui16(p);
+      continue;
+    }
+
+    Ns = p[2];
+    if (p + 6 + Ns * 2 > pEnd)
+      break;
+
+    Ss = p[3 + Ns * 2];
+    Se = p[4 + Ns * 2];
+
+    if (Ss < K && Se >= K) {
+      for (i = 0; i < Ns; i++) {
+        for (j = 0; j < scan->Ns; j++) {
+          if (p[3 + i * 2] == scan->compo.comp[j].id)
+            return false;
+        }
+      }
+    }
+
+    p += jpg_get_ui16(p);
+  }
+
+  return true;
+}
+
+/* G.1.2.1, first scan of DC coefficients */
+IM_INLINE
+void
+jpg_coef_dc_first(ImScan         * __restrict scan,
+                  ImHuffTbl      * __restrict huff,
+                  ImComponentSel * __restrict icomp,
+                  int16_t        * __restrict blk) {
+  int16_t t, diff;
+
+  diff = 0;
+  if ((t = jpg_decode(scan, huff) & 15))
+    diff = jpg_extend(jpg_receive(scan, huff, t), t);
+
+  icomp->pred += diff;
+  blk[0]       = (int16_t)(icomp->pred * (1 << scan->apprxLo));
+}
+
+/* G.1.2.1, refinement of DC coefficients */
+IM_INLINE
+void
+jpg_coef_dc_refine(ImScan  * __restrict scan,
+                   int16_t * __restrict blk) {
+  if (jpg_nextbit(scan))
+    blk[0] |= 1 << scan->apprxLo;
+}
+
+/* G.1.2.2, first scan of AC coefficients with EOB runs */
+IM_INLINE
+void
+jpg_coef_ac_first(ImScan    * __restrict scan,
+                  ImHuffTbl * __restrict huff,
+                  int16_t   * __restrict blk,
+                  uint32_t               Ss,
+                  uint32_t               Se) {
+  uint32_t k, rs, r, s;
+
+  if (scan->eobrun > 0) {
+    scan->eobrun--;
+    return;
+  }
+
+  for (k = Ss; k <= Se; k++) {
+    rs = jpg_decode(scan, huff);
+    r  = rs >> 4;
+    s  = rs & 15;
+
+    if (s) {
+      if ((k += r) > 63)
+        break;
+
+      blk[unzig[k]] = (int16_t)(jpg_extend(jpg_receive(scan, huff, s), s)
+                                * (1 << scan->apprxLo));
+    } else if (r == 15) {
+      k += 15;
+    } else {
+      /* EOBr, this block is counted as well */
+      scan->eobrun = (1u << r) - 1;
+      if (r)
+        scan->eobrun += (uint16_t)jpg_receive(scan, huff, r);
+      break;
+    }
+  }
+}
+
+/* G.1.2.3, refinement of AC coefficients */
+IM_INLINE
+void
+jpg_coef_ac_refine(ImScan    * __restrict scan,
+                   ImHuffTbl * __restrict huff,
+                   int16_t   * __restrict blk,
+                   uint32_t               Ss,
+                   uint32_t               Se) {
+  int16_t *coef;
+  int32_t  p1, m1, r, s;
+  uint32_t k, rs;
+
+  p1 = 1 << scan->apprxLo;
+  m1 = -1 * p1;
+  k  = Ss;
+
+  if (scan->eobrun == 0) {
+    for (; k <= Se; k++) {
+      rs = jpg_decode(scan, huff);
+      r  = rs >> 4;
+      s  = rs & 15;
+
+      if (s) {
+        /* s must be 1, sign of newly non-zero coefficient */
+        s = jpg_nextbit(scan) ? p1 : m1;
+      } else if (r != 15) {
+        scan->eobrun = 1u << r;
+        if (r)
+          scan->eobrun += (uint16_t)jpg_receive(scan, huff, r);
+        break;
+      }
+
+      /* skip r zero coefficients, refine non-zero ones on the way */
+      do {
+        coef = &blk[unzig[k]];
+        if (*coef) {
+          if (jpg_nextbit(scan) && (*coef & p1) == 0)
+            *coef += *coef >= 0 ? p1 : m1;
+        } else if (--r < 0) {
+          break;
+        }
+      } while (++k <= Se);
+
+      if (s && k <= 63)
+        blk[unzig[k]] = (int16_t)s;
+    }
+  }
+
+  if (scan->eobrun > 0) {
+    /* refine remaining non-zero coefficients of the block in EOB run */
+    for (; k <= Se; k++) {
+      coef = &blk[unzig[k]];
+      if (*coef && jpg_nextbit(scan) && (*coef & p1) == 0)
+        *coef += *coef >= 0 ? p1 : m1;
+    }
+
+    scan->eobrun--;
+  }
+}
+
+IM_INLINE
+void
+jpg_coef_block(ImJpeg         * __restrict jpg,
+               ImScan         * __restrict scan,
+               ImComponentSel * __restrict icomp,
+               int16_t        * __restrict blk) {
+  uint32_t Ss, Se;
+
+  Ss = scan->startOfSpectral;
+  Se = im_min_i32(scan->endOfSpectral, 63);
+
+  if (Ss == 0) {
+    if (scan->apprxHi == 0)
+      jpg_coef_dc_first(scan, &jpg->dht[0][icomp->Td], icomp, blk);
+    else
+      jpg_coef_dc_refine(scan, blk);
+
+    Ss = 1;
+  }
+
+  /* sequential scans carry DC and AC in the same scan */
+  if (Se >= Ss) {
+    if (scan->apprxHi == 0)
+      jpg_coef_ac_first(scan, &jpg->dht[1][icomp->Ta], blk, Ss, Se);
+    else
+      jpg_coef_ac_refine(scan, &jpg->dht[1][icomp->Ta], blk, Ss, Se);
+  }
+}
+
+IM_HIDE
+ImByte*
+jpg_scan_coef(ImByte * __restrict pRaw,
+              ImJpeg * __restrict jpg,
+              ImScan * __restrict scan) {
+  ImFrm          *frm;
+  ImComponent    *comp;
+  ImComponentSel *icomp;
+  int16_t        *coef;
+  uint32_t        mcux, mcuy, i, j, k, h, v, H, V, bw, cw, ch, ci, ri, n;
+
+  frm  = &jpg->frm;
+  mcux = jpg_mcux(frm);
+  mcuy = jpg_mcuy(frm);
+  ri   = jpg->ri;
+  n    = 0;
+
+  scan->cnt    = 0;
+  scan->pRaw   = pRaw;
+  scan->eobrun = 0;
+
+  for (k = 0; k < scan->Ns; k++) {
+    icomp = &scan->compo.comp[k];
+    if (!(icomp->comp = jpg_component_byid(frm, icomp->id))
+        || icomp->comp - frm->compo >= 4) {
+      jpg->result = IM_JPEG_INVALID;
+      jpg_dec_exit(jpg);
+    }
+
+    icomp->comp->Td = icomp->Td;
+    icomp->comp->Ta = icomp->Ta;
+  }
+
+  if (!jpg->coef[0] && !jpg_coef_alloc(jpg)) {
+    jpg->result = IM_JPEG_INVALID;
+    jpg_dec_exit(jpg);
+  }
+
+  /* coefficient access wants low bands only, higher AC bands are skipped */
+  if (jpg->coefOnly
+      && jpg->conf
+      && jpg->conf->coefCount
+      && scan->startOfSpectral >= jpg->conf->coefCount
+      && jpg_coef_skippable(jpg, scan, pRaw, jpg->conf->coefCount))
+    return jpg_coef_skip(pRaw, jpg->pRawEnd);
+
+  /* non-interleaved, MCU is one block and only blocks inside image count */
+  if (scan->Ns == 1) {
+    icomp = &scan->compo.comp[0];
+    comp  = icomp->comp;
+    ci    = (uint32_t)(comp - frm->compo);
+    H     = comp->sf.H;
+    V     = comp->sf.V;
+    bw    = mcux * H;
+    cw    = ((frm->width  * H + frm->hmax - 1) / frm->hmax + 7) / 8;
+    ch    = ((frm->height * V + frm->vmax - 1) / frm->vmax + 7) / 8;
+
+    for (i = 0; i < ch; i++) {
+      coef = jpg->coef[ci] + (size_t)i * bw * 64;
+
+      for (j = 0; j < cw; j++, n++) {
+        if (ri && n && n % ri == 0)
+          jpg_restart(scan);
+
+        jpg_coef_block(jpg, scan, icomp, coef + j * 64);
+      }
+    }
+  } else {
+    for (i = 0; i < mcuy; i++) {
+      for (j = 0; j < mcux; j++, n++) {
+        if (ri && n && n % ri == 0)
+          jpg_restart(scan);
+
+        for (k = 0; k < scan->Ns; k++) {
+          icomp = &scan->compo.comp[k];
+          comp  = icomp->comp;
+          ci    = (uint32_t)(comp - frm->compo);
+          H     = comp->sf.H;
+          V     = comp->sf.V;
+          bw    = mcux * H;
+
+          for (v = 0; v < V; v++) {
+            coef = jpg->coef[ci] + ((size_t)(i * V + v) * bw + j * H) * 64;
+
+            for (h = 0; h < H; h++)
+              jpg_coef_block(jpg, scan, icomp, coef + h * 64);
+          }
+        }
+      }
+    }
+  }
+
+  jpg->coefDirty = true;
+
+  return scan->pRaw;
+}
+
+/* reconstructs whole frame from coefficients through the pipeline */
+static
+void
+jpg_coef_emit(ImJpeg * __restrict jpg) {
+  IM_ALIGN(16) int16_t data[64];
+  ImFrm               *frm;
+  ImJpegRow           *row;
+  ImComponent         *comp;
+  int16_t             *coef;
+  uint32_t             mcux, mcuy, i, k, v, x, bw, Nf, n;
+
+  frm  = &jpg->frm;
+  n    = jpg->dctSize;
+  mcux = jpg_mcux(frm);
+  mcuy = jpg_mcuy(frm);
+  Nf   = im_min_i32(frm->Nf, 4);
+
+  if (!jpg->rows && !jpg_rows_alloc(jpg, jpg->ring.depth)) {
+    jpg->result = IM_JPEG_INVALID;
+    jpg_dec_exit(jpg);
+  }
+
+  for (i = 0; i < mcuy; i++) {
+    row = jpg_row_begin(jpg);
+
+    for (k = 0; k < Nf; k++) {
+      comp = &frm->compo[k];
+      bw   = mcux * comp->sf.H;
+
+      for (v = 0; v < comp->sf.V; v++) {
+        coef = jpg->coef[k] + (size_t)(i * comp->sf.V + v) * bw * 64;
+
+        for (x = 0; x < bw; x++) {
+          /* keep coefficients intact for later scans */
+          memcpy(data, coef + x * 64, sizeof(data));
+
+          if (frm->precision > 8) {
+            jpg_recon_block16(&jpg->dqt[comp->Tq],
+                              data,
+                              (uint16_t *)row->comp[k]
+                                + (v * row->stride[k] + x) * 8,
+                              row->stride[k]);
+            continue;
+          }
+
+          jpg_recon_block(&jpg->dqt[comp->Tq],
+                          data,
+                          row->comp[k] + (v * row->stride[k] + x) * n,
+                          row->stride[k],
+                          n);
+        }
+      }
+    }
+
+    row->mcuy = i;
+    jpg_row_end(jpg, row);
+  }
+
+  jpg->coefDirty = false;
+}
+
+IM_HIDE
+void
+jpg_coef_scan_done(ImJpeg * __restrict jpg) {
+  im_open_config_t *conf;
+  bool              stop;
+
+  jpg->coefScans++;
+
+  if (!(conf = jpg->conf) || jpg->coefOnly)
+    return;
+
+  stop = conf->maxScans && jpg->coefScans >= conf->maxScans;
+
+  if (conf->preview) {
+    jpg_coef_emit(jpg);
+    thread_ring_flush(&jpg->ring);
+
+    if (!conf->preview(jpg->im, jpg->coefScans, conf->previewObj))
+      stop = true;
+  }
+
+  if (stop) {
+    jpg_coef_finish(jpg);
+    jpg_dec_exit(jpg);
+  }
+}
+
+IM_HIDE
+void
+jpg_coef_finish(ImJpeg * __restrict jpg) {
+  if (jpg->coef[0] && jpg->coefDirty && !jpg->coefOnly)
+    jpg_coef_emit(jpg);
+}
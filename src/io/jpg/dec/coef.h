@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef src_jpg_coef_h
+#define src_jpg_coef_h
+
+#include "../common.h"
+
+/*
+ decodes a scan into the coefficient buffer of the frame, used for progressive
+ frames and for scans which do not contain all components
+ */
+IM_HIDE
+ImByte*
+jpg_scan_coef(ImByte * __restrict pRaw,
+              ImJpeg * __restrict jpg,
+              ImScan * __restrict scan);
+
+/* handles previews and scan limit after each coefficient scan */
+IM_HIDE
+void
+jpg_coef_scan_done(ImJpeg * __restrict jpg);
+
+/* reconstructs the frame if there are coefficients not emitted yet */
+IM_HIDE
+void
+jpg_coef_finish(ImJpeg * __restrict jpg);
+
+IM_HIDE
+void
+jpg_coef_free(ImJpeg * __restrict jpg);
+
+#endif /* src_jpg_coef_h */
@@ -23,17 +23,112 @@
 /* file formats */
 #include "jfif/jfif.h"
 #include "exif/exif.h"
+#include "adobe/adobe.h"
+
+#include "quant.h"
+#include "huff.h"
+#include "frame.h"
+#include "com.h"
+#include "restart.h"
+#include "recon.h"
+#include "coef.h"
 
 #include "../../../file.h"
 
+/* default number of MCU rows in flight between the two stages */
+#define IM_JPEG_PIPELINE_DEPTH 4
+
 typedef struct worker_arg_t {
-  const char  *path;
+  ImByte      *raw;
   ImImage     *image;
   ImJpeg      *jpg;
   bool         failed;
-  ImFileResult fres;
 } worker_arg_t;
 
+static
+void
+jpg_dec_markers(ImByte * __restrict pRaw, ImJpeg * __restrict jpg) {
+  JPGMarker mrk;
+
+  mrk = 0;
+
+  while (pRaw && pRaw + JPP_MARKER_SIZE <= jpg->pRawEnd) {
+    mrk   = jpg_marker(pRaw);
+    pRaw += JPP_MARKER_SIZE;
+
+    /* every other marker has a segment length */
+    if (mrk == JPG_EOI || pRaw + 2 > jpg->pRawEnd)
+      break;
+
+    /* truncated segment, e.g. a cut off stream frame */
+    if (pRaw + jpg_get_ui16(pRaw) > jpg->pRawEnd)
+      break;
+
+#ifdef DEBUG
+    printf("Found Marker: 0x%X\n", mrk);
+#endif
+
+    switch (mrk) {
+      case JPG_DQT:
+        pRaw = jpg_dqt(pRaw, jpg);
+        break;
+      case JPG_DHT:
+        pRaw = jpg_dht(pRaw, jpg);
+        break;
+      case JPG_SOF0:
+      case JPG_SOF1:
+        pRaw = jpg_sof(pRaw, jpg);
+        break;
+      case JPG_SOF2:
+        if ((pRaw = jpg_sof(pRaw, jpg)))
+          jpg->frm.progressive = true;
+        break;
+      case JPG_SOF3:
+
+      case JPG_SOF5:
+      case JPG_SOF6:
+      case JPG_SOF7:
+
+      case JPG_SOF8:
+      case JPG_SOF9:
+      case JPG_SOF10:
+      case JPG_SOF11:
+
+      case JPG_SOF13:
+      case JPG_SOF14:
+      case JPG_SOF15:
+        jpg->result = IM_JPEG_INVALID;
+        jpg_dec_exit(jpg);
+        break;
+      case JPG_SOS:
+        pRaw = jpg_sos(pRaw, jpg);
+        break;
+      case JPG_COM:
+        pRaw = jpg_com(pRaw, jpg);
+        break;
+      case JPG_APPn(E):
+        pRaw = adobe_dec(pRaw, jpg);
+        break;
+      case JPG_DRI:
+        pRaw = jpg_dri(pRaw, jpg);
+        break;
+      default: {
+        /* unknown marker, skip it */
+        pRaw += jpg_get_ui16(pRaw);
+      }
+    }
+  }
+
+  jpg_coef_finish(jpg);
+
+  /* NULL: decoding stopped on purpose e.g. metadata only */
+  if (pRaw && mrk != JPG_EOI) {
+    jpg->result = IM_JPEG_INVALID;
+  }
+
+  jpg_dec_exit(jpg);
+}
+
 IM_HIDE
 void
 jpg_dec_start(ImJpeg *jpg, ImByte *raw) {
@@ -43,28 +138,41 @@ jpg_dec_start(ImJpeg *jpg, ImByte *raw) {
   pRaw = raw;
 
   /* No jpeg */
-  if (!jpg_marker_eq(pRaw, JPG_SOI))
+  if (!jpg_marker_eq(pRaw, JPG_SOI)) {
+    jpg->failed = true;
     return;
+  }
 
   pRaw += JPP_MARKER_SIZE;
 
-  /* Find APPn(0) */
-  mrk   = jpg_marker(pRaw);
-  pRaw += JPP_MARKER_SIZE;
+  /* JFIF, EXIF and Adobe headers may come in any order, other APPn are
+     skipped */
+  while (pRaw + JPP_MARKER_SIZE * 2 <= jpg->pRawEnd
+         && jpg_is_app_marker(mrk = jpg_marker(pRaw))) {
+    pRaw += JPP_MARKER_SIZE;
 
-  switch (mrk) {
-    /* we have found JFIF file */
-    case JPG_APPn(0):
-      jfif_dec(pRaw, jpg);
-      break;
-    /* we have found EXIF file */
-    case JPG_APPn(1):
-      exif_dec(pRaw, jpg);
-      break;
-    default:
-      assert("unsupported file!");
-      break;
+    if (pRaw + jpg_get_ui16(pRaw) > jpg->pRawEnd) {
+      jpg->failed = true;
+      return;
+    }
+
+    switch (mrk) {
+      case JPG_APPn(0):
+        pRaw = jfif_dec(pRaw, jpg);
+        break;
+      case JPG_APPn(1):
+        pRaw = exif_dec(pRaw, jpg);
+        break;
+      case JPG_APPn(E):
+        pRaw = adobe_dec(pRaw, jpg);
+        break;
+      default:
+        pRaw = jfif_dec_skip_ext(pRaw);
+        break;
+    }
   }
+
+  jpg_dec_markers(pRaw, jpg);
 }
 
 IM_HIDE
@@ -73,194 +181,327 @@ im_on_worker(void *argv) {
   worker_arg_t *arg;
   ImImage      *im;
   ImJpeg       *jpg;
-  ImFileResult  fres;
-  
-  arg  = argv;
-  fres = im_readfile(arg->path, im->openIntent != IM_OPEN_INTENT_READWRITE);
-  
-  if (fres.ret != IM_OK) {
-    goto err;
-  }
-  
+
+  arg = argv;
+  jpg = arg->jpg;
+
   /* decode, this process will be optimized after decoding is done */
   im         = calloc(1, sizeof(*im));
-  im->format = IM_FORMAT_RGB; /* TODO: override this in frame header */
-  jpg        = arg->jpg;
+  im->format = IM_FORMAT_RGB; /* overridden by frame header */
   jpg->im    = im;
-  
   arg->image = im;
-  arg->fres  = fres;
-  
-  jpg_dec_start(jpg, fres.raw);
-  
-  return;
-
-err:
-  arg->failed = true;
+
+  jpg_dec_start(jpg, arg->raw);
+  thread_ring_close(&jpg->ring);
 }
 
 IM_HIDE
 void
 im_on_worker_idct(void *argv) {
   worker_arg_t *arg;
-  ImImage      *im;
   ImJpeg       *jpg;
-  ImByte       *p, *pi;
-  int16_t      *p2, pix;
-  bool          started;
-  
-  started = false;
-  arg     = argv;
-  jpg     = arg->jpg;
-  im      = arg->image;
-  
-  thread_lock(&jpg->wrkmutex);
-  
-  while (!started || jpg->nScans > 0) {
-    ImThreadedBlock *blk;
-    
-    thread_cond_wait(&jpg->cond, &jpg->wrkmutex);
-    
-    if (jpg->failed)
-      break;
-    
-    if (!(im = jpg->im))
-      continue;
-    
-    int row, col, width, height, xi, yi, k, Ns;
-    
-    /* consume avail blocks */
-    for (;;) {
-      blk = &jpg->blkpool[jpg->wrk_index];
-      if (blk->avail)
-        break;
-      
-      thread_lock(&blk->mutex);
-      
-      width  = jpg->frm.width;
-      height = jpg->frm.height;
-      p      = ((ImByte *)im->data.data);
-      Ns     = jpg->scan->Ns;
-      
-      for (k = 0; k < Ns; k++) {
-        int Hi, Vi, V, H, hmax, vmax, samplerClass;
-        
-        hmax         = jpg->frm.hmax;
-        vmax         = jpg->frm.vmax;
-        H            = blk->sf[k].H;
-        V            = blk->sf[k].V;
-        Hi           = jpg->frm.hmax / H;
-        Vi           = jpg->frm.vmax / V;
-        samplerClass = Hi << 1 | Vi;
-        
-        yi           = im_min_i32(8, (height - blk->mcuy * 8 * vmax) * V / vmax);
-        xi           = im_min_i32(8, (width  - blk->mcux * 8 * hmax) * H / hmax);
-        row          = blk->mcuy * 8 * V;
-        col          = blk->mcux * 8 * H;
-        
-        H            = im_max_i32(1, H * (float)im_min_i32((width  - blk->mcux * 8 * hmax), hmax * 8) / (hmax * 8));
-        V            = im_max_i32(1, V * (float)im_min_i32((height - blk->mcuy * 8 * vmax), vmax * 8) / (vmax * 8));
-        
-        for (int v = 0; v < V; v++) {
-          for (int h = 0; h < H; h++) {
-            p2 = blk->blk[v][h][k].blk;
-            for (int i = 0; i < yi; i++) {
-              for (int j = 0; j < xi; j++) {
-                pix = *p2++;
-                pi  = &p[Ns * (((row + i) * Vi + v * 8) * width
-                               + ((col + j) * Hi + h * 8))
-                         + k];
-                
-                switch (samplerClass) {
-                  case IM_SAMPLER_11:
-                    pi[0] = pix;
-                    break;
-                  default:
-                    /* horizontal */
-                    for (int sh = 0; sh < Hi; sh++) {
-                      pi[Ns * sh] = pix;
-                    }
-                    
-                    /* vertical */
-                    for (int sv = 1; sv < Vi; sv++) {
-                      pi[width * Ns * sv]      = pix;
-                      pi[width * Ns * sv + Ns] = pix;
-                    }
-                    break;
-                }
-              } /* for j */
-            } /* for i */
-          } /* for h */
-        } /* for v */
-      } /* for k */
-      
-      if (++jpg->wrk_index > 2)
-        jpg->wrk_index = 0;
-      
-      blk->avail = true;
-      thread_unlock(&blk->mutex);
-      
-      /* thread_cond_signal(&jpg->dec_cond); */
-    }
-    
-    started = true;
+  int32_t       slot;
+
+  arg = argv;
+  jpg = arg->jpg;
+
+  /* consume MCU rows until entropy decoder closes the ring */
+  while ((slot = thread_ring_read_begin(&jpg->ring)) >= 0) {
+    jpg_recon_row(jpg, &jpg->rows[slot]);
+    thread_ring_read_end(&jpg->ring);
   }
-  
-  thread_unlock(&jpg->wrkmutex);
-  
-  if (im) {
-    im_YCbCrToRGB(jpg->im->data.data, im->width, im->height);
+}
+
+static
+ImJpeg*
+jpg_dec_new(ImByte           * __restrict raw,
+            size_t                        size,
+            im_open_config_t * __restrict open_config) {
+  ImJpeg *jpg;
+
+  if (!(jpg = calloc(1, sizeof(*jpg))))
+    return NULL;
+
+  jpg->conf    = open_config;
+  jpg->pRawEnd = raw + size;
+
+  switch (open_config->scaleDenom) {
+    case 2:  jpg->dctSize = 4; break;
+    case 4:  jpg->dctSize = 2; break;
+    case 8:  jpg->dctSize = 1; break;
+    default: jpg->dctSize = 8; break;
   }
+
+  thread_ring_init(&jpg->ring, open_config->pipelineDepth > 0
+                                 ? open_config->pipelineDepth
+                                 : IM_JPEG_PIPELINE_DEPTH);
+  return jpg;
+}
+
+static
+void
+jpg_dec_comments_free(ImJpeg * __restrict jpg) {
+  ImComment *com, *next;
+
+  for (com = jpg->comments; com; com = next) {
+    next = com->next;
+    free(com);
+  }
+
+  jpg->comments = NULL;
+}
+
+static
+void
+jpg_dec_free(ImJpeg * __restrict jpg) {
+  jpg_rows_free(jpg);
+  jpg_coef_free(jpg);
+  jpg_dec_comments_free(jpg);
+  thread_ring_destroy(&jpg->ring);
+  free(jpg->scan);
+  free(jpg);
+}
+
+/* state of previous frame, tables stay as abbreviated streams expect */
+static
+void
+jpg_dec_reset(ImJpeg * __restrict jpg, ImByte * __restrict raw, size_t size) {
+  jpg_rows_reset(jpg);
+  jpg_coef_free(jpg);
+  jpg_dec_comments_free(jpg);
+  free(jpg->scan);
+
+  memset(&jpg->frm, 0, sizeof(jpg->frm));
+
+  jpg->scan           = NULL;
+  jpg->im             = NULL;
+  jpg->result         = IM_JPEG_NONE;
+  jpg->pRawEnd        = raw + size;
+  jpg->nScans         = 0;
+  jpg->ri             = 0;
+  jpg->failed         = false;
+  jpg->jfif           = false;
+  jpg->adobe          = false;
+  jpg->adobeTransform = 0;
+  jpg->color          = IM_JPEG_COLOR_GRAY;
+  jpg->ncomp          = 0;
+  jpg->width          = 0;
+  jpg->height         = 0;
+  jpg->orient         = 0;
+  jpg->orgn           = 0;
+  jpg->ox             = 0;
+  jpg->oy             = 0;
+  jpg->coefScans      = 0;
+  jpg->coefDirty      = false;
 }
 
 IM_HIDE
 ImResult
-jpg_dec(ImImage         ** __restrict dest,
-        const char       * __restrict path,
-        im_open_config_t * __restrict open_config) {
+jpg_dec_mem(ImImage         ** __restrict dest,
+            ImByte           * __restrict raw,
+            size_t                        size,
+            im_open_config_t * __restrict open_config) {
   ImJpeg      *jpg;
   th_thread   *scan_worker, *idct_worker;
   worker_arg_t arg;
-  
+  bool         failed;
+
+  if (!(jpg = jpg_dec_new(raw, size, open_config))) {
+    *dest = NULL;
+    return IM_ERR;
+  }
+
   memset(&arg, 0, sizeof(arg));
 
-  jpg       = calloc(1, sizeof(*jpg));
-  arg.path  = path;
+  arg.raw   = raw;
   arg.jpg   = jpg;
   arg.image = NULL;
-  
-  thread_cond_init(&jpg->cond);
-  thread_cond_init(&jpg->dec_cond);
-  thread_mutex_init(&jpg->wrkmutex);
-  thread_mutex_init(&jpg->decmutex);
-  
-  jpg->blkpool[0].avail = true;
-  jpg->blkpool[1].avail = true;
-  jpg->blkpool[2].avail = true;
-  
-  thread_mutex_init(&jpg->blkpool[0].mutex);
-  thread_mutex_init(&jpg->blkpool[1].mutex);
-  thread_mutex_init(&jpg->blkpool[2].mutex);
-  
+
   scan_worker = thread_new(im_on_worker, &arg);
-  
-  if (!arg.failed) {
-    idct_worker = thread_new(im_on_worker_idct, &arg);
-    thread_join(scan_worker);
-    thread_cond_signal(&jpg->cond);
-    thread_join(idct_worker);
-  } else {
-    idct_worker = NULL;
-  }
-  
+  idct_worker = thread_new(im_on_worker_idct, &arg);
+
+  thread_join(scan_worker);
+  thread_join(idct_worker);
+
   thread_release(scan_worker);
   thread_release(idct_worker);
-  
-  if (arg.fres.mmap) {
-    im_unmap(arg.fres.raw, arg.fres.size);
+
+  /* cut off, unsupported or corrupt streams leave result set */
+  failed = arg.failed
+           || jpg->failed
+           || (jpg->result != IM_JPEG_NONE && jpg->result != IM_JPEG_EOI);
+
+  jpg_dec_free(jpg);
+
+  if (failed) {
+    im_free(arg.image);
+    *dest = NULL;
+    return IM_ERR;
   }
-  
+
   *dest = arg.image;
 
   return IM_OK;
 }
+
+IM_HIDE
+ImJpeg*
+jpg_dec_coef(ImByte           * __restrict raw,
+             size_t                        size,
+             im_open_config_t * __restrict open_config) {
+  ImJpeg      *jpg;
+  th_thread   *scan_worker;
+  worker_arg_t arg;
+
+  if (!(jpg = jpg_dec_new(raw, size, open_config)))
+    return NULL;
+
+  memset(&arg, 0, sizeof(arg));
+
+  jpg->coefOnly = true;
+  jpg->dctSize  = 8;
+  arg.raw       = raw;
+  arg.jpg       = jpg;
+
+  /* nothing is reconstructed, entropy decoding runs alone */
+  scan_worker = thread_new(im_on_worker, &arg);
+  thread_join(scan_worker);
+  thread_release(scan_worker);
+
+  /* transcoders must not work on partially decoded coefficients */
+  if (arg.failed
+      || jpg->failed
+      || (jpg->result != IM_JPEG_NONE && jpg->result != IM_JPEG_EOI)
+      || !jpg->coef[0]) {
+    jpg_dec_coef_free(jpg);
+    return NULL;
+  }
+
+  return jpg;
+}
+
+IM_HIDE
+void
+jpg_dec_coef_free(ImJpeg * __restrict jpg) {
+  if (!jpg)
+    return;
+
+  im_free(jpg->im);
+  jpg_dec_free(jpg);
+}
+
+IM_HIDE
+ImResult
+jpg_dec(ImImage         ** __restrict dest,
+        const char       * __restrict path,
+        im_open_config_t * __restrict open_config) {
+  ImFileResult fres;
+  ImResult     ret;
+
+  fres = im_readfile(path, true);
+  if (fres.ret != IM_OK) {
+    *dest = NULL;
+    return fres.ret;
+  }
+
+  ret = jpg_dec_mem(dest, fres.raw, fres.size, open_config);
+
+  /* image keeps the file, metadata such as EXIF thumbnail point into it */
+  if (ret == IM_OK) {
+    fres.mustfree = !fres.mmap;
+    (*dest)->file = fres;
+  } else if (fres.mmap) {
+    im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
+  }
+
+  return ret;
+}
+
+IM_HIDE
+ImJpegStream*
+jpg_stream_new(im_open_config_t * __restrict open_config) {
+  ImJpegStream *stream;
+
+  if (!(stream = calloc(1, sizeof(*stream))))
+    return NULL;
+
+  /* option array of caller may not live as long as stream */
+  stream->conf         = *open_config;
+  stream->conf.options = NULL;
+
+  if (!(stream->jpg = jpg_dec_new(NULL, 0, &stream->conf))) {
+    free(stream);
+    return NULL;
+  }
+
+  return stream;
+}
+
+IM_HIDE
+ImResult
+jpg_stream_dec(ImJpegStream * __restrict stream,
+               ImImage     ** __restrict dest,
+               ImByte        * __restrict raw,
+               size_t                     size) {
+  ImJpeg  *jpg;
+  ImImage *im, *prev;
+  jmp_buf  unwind;
+
+  *dest = NULL;
+  jpg   = stream->jpg;
+
+  if (!(im = calloc(1, sizeof(*im))))
+    return IM_ENOMEM;
+
+  /* frames of a stream usually have same size, pixel buffer moves over */
+  if ((prev = stream->im)) {
+    im->data.data   = prev->data.data;
+    im->len         = prev->len;
+    prev->data.data = NULL;
+    im_free(prev);
+  }
+
+  im->format = IM_FORMAT_RGB; /* overridden by frame header */
+  stream->im = im;
+
+  jpg_dec_reset(jpg, raw, size);
+  jpg->im = im;
+
+  /* no threads: scan and reconstruction both run here, every exit path of
+     decoder jumps back, see jpg_dec_exit() */
+  if (!setjmp(unwind)) {
+    jpg->unwind = &unwind;
+    jpg_dec_start(jpg, raw);
+  }
+
+  jpg->unwind = NULL;
+
+  /* truncated or corrupt frame, tables read so far stay installed */
+  if (jpg->failed
+      || (jpg->result != IM_JPEG_NONE && jpg->result != IM_JPEG_EOI))
+    return IM_ERR;
+
+  /* tables-only datastream, following frames use its tables */
+  if (!jpg->frm.Nf)
+    return IM_OK;
+
+  if (!im->data.data)
+    return IM_ENOMEM;
+
+  *dest = im;
+
+  return IM_OK;
+}
+
+IM_HIDE
+void
+jpg_stream_free(ImJpegStream * __restrict stream) {
+  if (!stream)
+    return;
+
+  im_free(stream->im);
+  jpg_dec_free(stream->jpg);
+  free(stream);
+}
@@ -25,4 +25,49 @@ jpg_dec(ImImage         ** __restrict dest,
         const char       * __restrict path,
         im_open_config_t * __restrict open_config);
 
+/* decodes JPEG in memory, EXIF thumbnail of result points into raw */
+IM_HIDE
+ImResult
+jpg_dec_mem(ImImage         ** __restrict dest,
+            ImByte           * __restrict raw,
+            size_t                        size,
+            im_open_config_t * __restrict open_config);
+
+/*
+ entropy decodes all scans into jpg->coef, no pixels are reconstructed.
+ Returned state must be released with jpg_dec_coef_free()
+ */
+IM_HIDE
+ImJpeg*
+jpg_dec_coef(ImByte           * __restrict raw,
+             size_t                        size,
+             im_open_config_t * __restrict open_config);
+
+IM_HIDE
+void
+jpg_dec_coef_free(ImJpeg * __restrict jpg);
+
+/* Motion-JPEG and other frame sequences, tables and buffers outlive frames */
+struct ImJpegStream {
+  ImJpeg           *jpg;
+  ImImage          *im;   /* last frame, owned by stream */
+  im_open_config_t  conf;
+};
+
+IM_HIDE
+ImJpegStream*
+jpg_stream_new(im_open_config_t * __restrict open_config);
+
+/* decodes one frame on caller's thread, result is valid until next frame */
+IM_HIDE
+ImResult
+jpg_stream_dec(ImJpegStream * __restrict stream,
+               ImImage     ** __restrict dest,
+               ImByte        * __restrict raw,
+               size_t                     size);
+
+IM_HIDE
+void
+jpg_stream_free(ImJpegStream * __restrict stream);
+
 #endif /* src_jpg_dec_h */
@@ -16,8 +16,307 @@
 
 #include "exif.h"
 
-IM_HIDE
+#include <stdlib.h>
+#include <string.h>
+
+/* TIFF field types that are used here */
+#define EXIF_BYTE      1
+#define EXIF_ASCII     2
+#define EXIF_SHORT     3
+#define EXIF_LONG      4
+#define EXIF_RATIONAL  5
+#define EXIF_UNDEFINED 7
+
+/* IFD nesting is fixed for JPEG EXIF, avoid loops in corrupted files */
+#define EXIF_MAX_ENTRIES 512
+
+typedef enum ExifStr {
+  EXIF_STR_MAKE = 0,
+  EXIF_STR_MODEL,
+  EXIF_STR_SOFTWARE,
+  EXIF_STR_DATETIME,
+  EXIF_STR_DATETIME_ORIG,
+  EXIF_STR_ARTIST,
+  EXIF_STR_COPYRIGHT,
+  EXIF_STR_COUNT
+} ExifStr;
+
+typedef struct ExifStrRef {
+  uint32_t off;
+  uint32_t len;
+} ExifStrRef;
+
+typedef struct ExifTIFF {
+  const ImByte *base;
+  uint32_t      size;
+  bool          bigEndian;
+
+  ImExif        exif;
+  ExifStrRef    str[EXIF_STR_COUNT];
+  uint32_t      exifIFD;
+  uint32_t      thumbOff;
+  uint32_t      thumbLen;
+  bool          inIFD1;
+} ExifTIFF;
+
+IM_INLINE
+uint16_t
+exif_u16(ExifTIFF *t, uint32_t off) {
+  const ImByte *p;
+
+  p = t->base + off;
+  return t->bigEndian ? (uint16_t)(p[0] << 8 | p[1])
+                      : (uint16_t)(p[1] << 8 | p[0]);
+}
+
+IM_INLINE
+uint32_t
+exif_u32(ExifTIFF *t, uint32_t off) {
+  const ImByte *p;
+
+  p = t->base + off;
+  return t->bigEndian
+           ? (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]
+           : (uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0];
+}
+
+IM_INLINE
+bool
+exif_in(ExifTIFF *t, uint32_t off, uint32_t len) {
+  return off <= t->size && len <= t->size - off;
+}
+
+static
+uint32_t
+exif_type_size(uint16_t type) {
+  switch (type) {
+    case EXIF_BYTE:
+    case EXIF_ASCII:
+    case EXIF_UNDEFINED: return 1;
+    case EXIF_SHORT:     return 2;
+    case EXIF_LONG:      return 4;
+    case EXIF_RATIONAL:  return 8;
+    default:             return 0;
+  }
+}
+
+/* offset of entry's value, values up to 4 bytes are stored in the entry */
+static
+bool
+exif_value(ExifTIFF *t, uint32_t entry, uint32_t *off, uint32_t *count) {
+  uint32_t tsize, n;
+
+  tsize = exif_type_size(exif_u16(t, entry + 2));
+  n     = exif_u32(t, entry + 4);
+
+  if (tsize == 0 || n == 0 || n > t->size / tsize)
+    return false;
+
+  *off   = tsize * n <= 4 ? entry + 8 : exif_u32(t, entry + 8);
+  *count = n;
+
+  return exif_in(t, *off, tsize * n);
+}
+
+static
+uint32_t
+exif_uint(ExifTIFF *t, uint32_t entry) {
+  uint32_t off, n;
+
+  if (!exif_value(t, entry, &off, &n))
+    return 0;
+
+  switch (exif_u16(t, entry + 2)) {
+    case EXIF_SHORT: return exif_u16(t, off);
+    case EXIF_LONG:  return exif_u32(t, off);
+    case EXIF_BYTE:  return t->base[off];
+    default:         return 0;
+  }
+}
+
+static
+ImRational
+exif_rational(ExifTIFF *t, uint32_t entry) {
+  ImRational r = {0, 0};
+  uint32_t   off, n;
+
+  if (exif_u16(t, entry + 2) == EXIF_RATIONAL && exif_value(t, entry, &off, &n)) {
+    r.num = exif_u32(t, off);
+    r.den = exif_u32(t, off + 4);
+  }
+
+  return r;
+}
+
+static
 void
+exif_string(ExifTIFF *t, uint32_t entry, ExifStr which) {
+  uint32_t off, n;
+
+  if (exif_u16(t, entry + 2) != EXIF_ASCII || !exif_value(t, entry, &off, &n))
+    return;
+
+  /* count includes NUL but writers don't always respect it */
+  while (n > 0 && t->base[off + n - 1] == '\0')
+    n--;
+
+  t->str[which].off = off;
+  t->str[which].len = n;
+}
+
+static
+void
+exif_tag(ExifTIFF *t, uint32_t entry) {
+  ImExif *exif;
+
+  exif = &t->exif;
+
+  /* IFD1 repeats resolution etc. for the thumbnail, keep main image's */
+  if (t->inIFD1) {
+    switch (exif_u16(t, entry)) {
+      case 0x0201: t->thumbOff = exif_uint(t, entry); break;
+      case 0x0202: t->thumbLen = exif_uint(t, entry); break;
+      default: break;
+    }
+    return;
+  }
+
+  switch (exif_u16(t, entry)) {
+    /* IFD0 */
+    case 0x010F: exif_string(t, entry, EXIF_STR_MAKE);                 break;
+    case 0x0110: exif_string(t, entry, EXIF_STR_MODEL);                break;
+    case 0x0131: exif_string(t, entry, EXIF_STR_SOFTWARE);             break;
+    case 0x0132: exif_string(t, entry, EXIF_STR_DATETIME);             break;
+    case 0x013B: exif_string(t, entry, EXIF_STR_ARTIST);               break;
+    case 0x8298: exif_string(t, entry, EXIF_STR_COPYRIGHT);            break;
+    case 0x0112: exif->orientation    = (uint16_t)exif_uint(t, entry); break;
+    case 0x011A: exif->xResolution    = exif_rational(t, entry);       break;
+    case 0x011B: exif->yResolution    = exif_rational(t, entry);       break;
+    case 0x0128: exif->resolutionUnit = (uint16_t)exif_uint(t, entry); break;
+    case 0x8769: t->exifIFD           = exif_uint(t, entry);           break;
+
+    /* Exif IFD */
+    case 0x829A: exif->exposureTime   = exif_rational(t, entry);       break;
+    case 0x829D: exif->fNumber        = exif_rational(t, entry);       break;
+    case 0x8827: exif->isoSpeed       = (uint16_t)exif_uint(t, entry); break;
+    case 0x9003: exif_string(t, entry, EXIF_STR_DATETIME_ORIG);        break;
+    case 0x920A: exif->focalLength    = exif_rational(t, entry);       break;
+    case 0xA002: exif->pixelWidth     = exif_uint(t, entry);           break;
+    case 0xA003: exif->pixelHeight    = exif_uint(t, entry);           break;
+    default: break;
+  }
+}
+
+/* returns offset of next IFD or 0 */
+static
+uint32_t
+exif_ifd(ExifTIFF *t, uint32_t off) {
+  uint32_t count, i;
+
+  if (off < 8 || !exif_in(t, off, 2))
+    return 0;
+
+  count = exif_u16(t, off);
+  if (count > EXIF_MAX_ENTRIES || !exif_in(t, off + 2, count * 12 + 4))
+    return 0;
+
+  for (i = 0; i < count; i++)
+    exif_tag(t, off + 2 + i * 12);
+
+  return exif_u32(t, off + 2 + count * 12);
+}
+
+static
+ImExif*
+exif_alloc(ExifTIFF *t) {
+  ImExif  *exif;
+  char    *dst, **fields[EXIF_STR_COUNT];
+  size_t   total;
+  int      i;
+
+  total = sizeof(*exif);
+  for (i = 0; i < EXIF_STR_COUNT; i++) {
+    if (t->str[i].len)
+      total += t->str[i].len + 1;
+  }
+
+  /* single block, im_free() releases strings with the struct */
+  if (!(exif = malloc(total)))
+    return NULL;
+
+  *exif = t->exif;
+  dst   = (char *)(exif + 1);
+
+  fields[EXIF_STR_MAKE]          = &exif->make;
+  fields[EXIF_STR_MODEL]         = &exif->model;
+  fields[EXIF_STR_SOFTWARE]      = &exif->software;
+  fields[EXIF_STR_DATETIME]      = &exif->dateTime;
+  fields[EXIF_STR_DATETIME_ORIG] = &exif->dateTimeOriginal;
+  fields[EXIF_STR_ARTIST]        = &exif->artist;
+  fields[EXIF_STR_COPYRIGHT]     = &exif->copyright;
+
+  for (i = 0; i < EXIF_STR_COUNT; i++) {
+    if (!t->str[i].len) {
+      *fields[i] = NULL;
+      continue;
+    }
+
+    memcpy(dst, t->base + t->str[i].off, t->str[i].len);
+    dst[t->str[i].len] = '\0';
+    *fields[i]         = dst;
+    dst               += t->str[i].len + 1;
+  }
+
+  return exif;
+}
+
+IM_HIDE
+ImByte*
 exif_dec(ImByte *raw, ImJpeg *jpg) {
+  ExifTIFF  t;
+  ImByte   *end;
+  uint16_t  APP1len;
+  uint32_t  ifd1;
+
+  APP1len = jpg_get_ui16(raw);
+  end     = raw + APP1len;
+
+  if (end > jpg->pRawEnd)
+    return jpg->pRawEnd;
+
+  /* XMP and others share APP1, only first EXIF block is used */
+  if (APP1len < 16
+      || memcmp(raw + 2, "Exif\0\0", 6) != 0
+      || !jpg->im
+      || jpg->im->exif)
+    return end;
+
+  memset(&t, 0, sizeof(t));
+  t.base = raw + 8;
+  t.size = APP1len - 8;
+
+  if (t.base[0] == 'M' && t.base[1] == 'M')      t.bigEndian = true;
+  else if (t.base[0] != 'I' || t.base[1] != 'I') return end;
+
+  if (exif_u16(&t, 2) != 42)
+    return end;
+
+  ifd1 = exif_ifd(&t, exif_u32(&t, 4));
+
+  if (t.exifIFD)
+    exif_ifd(&t, t.exifIFD);
+
+  if (ifd1) {
+    t.inIFD1 = true;
+    exif_ifd(&t, ifd1);
+
+    if (t.thumbLen && exif_in(&t, t.thumbOff, t.thumbLen)) {
+      t.exif.thumbnail     = t.base + t.thumbOff;
+      t.exif.thumbnailSize = t.thumbLen;
+    }
+  }
+
+  jpg->im->exif = exif_alloc(&t);
 
+  return end;
 }
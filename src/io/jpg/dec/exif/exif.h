@@ -19,8 +19,9 @@
 
 #include "../../common.h"
 
+/* parses APP1 EXIF into ImImage.exif, returns end of the segment */
 IM_HIDE
-void
+ImByte*
 exif_dec(ImByte *raw, ImJpeg *jpg);
 
 #endif /* src_jpg_exif_h */
@@ -16,6 +16,9 @@
 
 #include "frame.h"
 #include "scan.h"
+#include "coef.h"
+#include "recon.h"
+#include "huff.h"
 #include <stdio.h>
 
 IM_HIDE
@@ -23,11 +26,13 @@ ImByte*
 jpg_sof(ImByte * __restrict pRaw,
         ImJpeg * __restrict jpg) {
   ImFrm        *frm;
+  ImImage     *im;
   ImComponent *icomp;
   uint8_t      tmp;
-  uint32_t     /* len, */ i, Nf;
+  size_t       size;
+  uint32_t     len, i, Nf, scale, width, height, bps;
 
-  /* len             = jpg_get_ui16(pRaw); */
+  len                = jpg_get_ui16(pRaw);
   frm                = &jpg->frm;
   frm->precision     = pRaw[2];
   frm->height        = jpg_get_ui16(&pRaw[3]);
@@ -36,10 +41,25 @@ jpg_sof(ImByte * __restrict pRaw,
   frm->hmax          = 0;
   frm->vmax          = 0;
 
-  jpg->im->data.data = malloc(Nf * frm->height * frm->width);
-  jpg->im->width     = frm->width;
-  jpg->im->height    = frm->height;
-  jpg->im->len       = Nf * frm->height * frm->width;
+  /* 8-bit or 12-bit (extended) samples, reduced IDCTs are 8-bit only, DNL
+     (height 0) is not supported and at most 4 components are decoded */
+  if ((frm->precision != 8 && frm->precision != 12)
+      || !frm->width
+      || !frm->height
+      || Nf < 1
+      || Nf > 4
+      || len < 8 + 3 * Nf) {
+    jpg->result = IM_JPEG_INVALID;
+    jpg_dec_exit(jpg);
+  }
+
+  if (frm->precision > 8)
+    jpg->dctSize = 8;
+
+  /* downscaled in DCT domain, 8 / dctSize */
+  scale              = 8 / jpg->dctSize;
+  width              = (frm->width  + scale - 1) / scale;
+  height             = (frm->height + scale - 1) / scale;
 
   pRaw += 8;
 
@@ -53,12 +73,98 @@ jpg_sof(ImByte * __restrict pRaw,
     icomp->sf.H = tmp >> 4;      /* Hi  */
     icomp->Tq   = pRaw[2];       /* Tqi */
 
+    /* B.2.2 */
+    if (icomp->sf.H < 1 || icomp->sf.H > 4
+        || icomp->sf.V < 1 || icomp->sf.V > 4
+        || icomp->Tq > 3) {
+      jpg->result = IM_JPEG_INVALID;
+      jpg_dec_exit(jpg);
+    }
+
     frm->hmax = im_maxiu8(frm->hmax, icomp->sf.H);
     frm->vmax = im_maxiu8(frm->vmax, icomp->sf.V);
     
     pRaw += 3;
   }
 
+  /* A.2.2, single component is never interleaved, its MCU is one block */
+  if (Nf == 1) {
+    frm->compo[0].sf.H = frm->compo[0].sf.V = 1;
+    frm->hmax          = frm->vmax          = 1;
+  }
+
+  /* Adobe APP14 decides between YCbCr / RGB and CMYK / YCCK, JFIF is always
+     YCbCr and 4 components without APP14 are plain CMYK as libjpeg assumes */
+  switch (Nf) {
+    case 1:
+      jpg->color = IM_JPEG_COLOR_GRAY;
+      break;
+    case 3:
+      jpg->color = !jpg->jfif && jpg->adobe && jpg->adobeTransform == 0
+                 ? IM_JPEG_COLOR_RGB : IM_JPEG_COLOR_YCbCr;
+      break;
+    case 4:
+      if (!jpg->adobe)
+        jpg->color = IM_JPEG_COLOR_CMYK;
+      else if (jpg->adobeTransform == 2)
+        jpg->color = IM_JPEG_COLOR_YCCK;
+      else
+        jpg->color = IM_JPEG_COLOR_CMYKI;
+      break;
+    default:
+      jpg->color = IM_JPEG_COLOR_RGB;
+      break;
+  }
+
+  jpg->ncomp = im_min_i32(Nf, 4);
+  if (Nf == 4 && jpg->conf && jpg->conf->cmykToRGB && frm->precision == 8)
+    jpg->ncomp = 3;
+
+  /* 12-bit samples are stored in uint16_t, values are 0 - 4095 */
+  bps                    = frm->precision > 8 ? 2 : 1;
+  im                     = jpg->im;
+  im->componentsPerPixel = jpg->ncomp;
+  im->bytesPerPixel      = im->componentsPerPixel * bps;
+  im->bitsPerComponent   = frm->precision;
+  im->bitsPerPixel       = im->bytesPerPixel * 8;
+
+  if (Nf == 1) {
+    im->format     = IM_FORMAT_GRAY;
+    im->colorSpace = IM_COLORSPACE_GRAY;
+  } else if (jpg->ncomp == 4) {
+    im->format     = IM_FORMAT_CMYK;
+    im->colorSpace = IM_COLORSPACE_CMYK;
+  } else {
+    im->format     = IM_FORMAT_RGB;
+    im->colorSpace = IM_COLORSPACE_sRGB;
+  }
+
+  size = jpg_planar_init(jpg, width, height);
+  jpg_orient_init(jpg, width, height);
+
+  /* header and metadata only, stop before any pixel work */
+  if (jpg->conf && jpg->conf->metadataOnly)
+    return NULL;
+
+  /* transcoding works on coefficients, pixels are never written */
+  if (!jpg->coefOnly) {
+    if (!size)
+      size = (size_t)jpg->ncomp * height * width * bps;
+
+    /* stream decoder hands over buffer of previous frame */
+    if (!jpg->im->data.data || jpg->im->len != size) {
+      free(jpg->im->data.data);
+      jpg->im->len = 0;
+
+      if (!(jpg->im->data.data = malloc(size))) {
+        jpg->result = IM_JPEG_INVALID;
+        jpg_dec_exit(jpg);
+      }
+    }
+
+    jpg->im->len = size;
+  }
+
   return pRaw;
 }
 
@@ -74,18 +180,31 @@ jpg_sos(ImByte * __restrict pRaw,
 
   len               = jpg_get_ui16(pRaw);
   pRawEnd           = pRaw + len;
-  scan              = calloc(1, sizeof(*scan));
-  scan->Ns          = Ns = pRaw[2];
-  scan->compo.ncomp = Ns;
-  scan->jpg         = jpg;
+  Ns                = pRaw[2];
 
-  if (Ns > 4) {
-    free(scan);
+  /* scan without frame header */
+  if (!jpg->frm.Nf) {
+    jpg->result = IM_JPEG_INVALID;
+    jpg_dec_exit(jpg);
+    return NULL;
+  }
+
+  if (Ns < 1 || Ns > 4 || len < 6 + 2 * Ns) {
     jpg->result = IM_JPEG_INVALID_COMPONENT_COUNT_IN_SCAN;
-    thread_exit();
+    jpg_dec_exit(jpg);
+    return NULL;
+  }
+
+  if (!(scan = calloc(1, sizeof(*scan)))) {
+    jpg->result = IM_JPEG_INVALID;
+    jpg_dec_exit(jpg);
     return NULL;
   }
 
+  scan->Ns          = Ns;
+  scan->compo.ncomp = Ns;
+  scan->jpg         = jpg;
+
   pRaw += 3;
 
   for (i = 0; i < Ns; i++) {
@@ -94,7 +213,19 @@ jpg_sos(ImByte * __restrict pRaw,
     icomp->id = pRaw[0];    /* Csj  */
     icomp->Ta = tmp & 0x0F; /* Taj  */
     icomp->Td = tmp >> 4;   /* Tdj  */
-    
+
+    /* B.2.3 */
+    if (icomp->Td > 3 || icomp->Ta > 3) {
+      free(scan);
+      jpg->result = IM_JPEG_INVALID;
+      jpg_dec_exit(jpg);
+      return NULL;
+    }
+
+    /* abbreviated frames e.g. Motion-JPEG rely on Annex K tables */
+    jpg_huff_default(jpg, 0, icomp->Td);
+    jpg_huff_default(jpg, 1, icomp->Ta);
+
     pRaw += 2;
   }
 
@@ -104,16 +235,18 @@ jpg_sos(ImByte * __restrict pRaw,
   scan->apprxLo         = tmp & 0x0F;
   scan->apprxHi         = tmp >> 4;
 
+  free(jpg->scan);
   jpg->scan = scan;
   jpg->nScans++;
 
-  /* interleaved */
-  if (Ns > 1) {
+  /* sequential scan with all components goes straight to the pipeline */
+  if (!jpg->frm.progressive && !jpg->coefOnly && Ns == jpg->frm.Nf) {
     pRawEnd = jpg_scan_intr(pRawEnd, jpg, scan);
   } else {
-
+    pRawEnd = jpg_scan_coef(pRawEnd, jpg, scan);
+    jpg_coef_scan_done(jpg);
   }
-  
+
   jpg->nScans--;
 
   /* next sos or EOI */
@@ -15,6 +15,7 @@
  */
 
 #include "huff.h"
+#include "../tables.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
@@ -75,8 +76,7 @@ jpg_handle_scanmarker(ImScan * __restrict scan, uint16_t marker) {
   }
   
 ex:
-  thread_cond_signal(&scan->jpg->cond);
-  thread_exit();
+  jpg_dec_exit(scan->jpg);
 }
 
 IM_HIDE
@@ -90,15 +90,36 @@ jpg_nextbit(ImScan * __restrict scan) {
   if (scan->cnt == 0) {
   again:
 
-    scan->b   = b = *scan->pRaw++;
     scan->cnt = 8;
 
+    /* data ends before EOI e.g. truncated stream frame */
+    if (unlikely(scan->pRaw + 2 > scan->jpg->pRawEnd)) {
+      if (!scan->spec) {
+        scan->jpg->result = IM_JPEG_INVALID;
+        jpg_dec_exit(scan->jpg);
+      }
+
+      scan->eos = true;
+      scan->b   = b = 0;
+      goto bits;
+    }
+
+    scan->b   = b = *scan->pRaw++;
+
     if (b == 0xFF && (b2 = *scan->pRaw++) != 0) {
-      jpg_handle_scanmarker(scan, ((int16_t)b2 << 8) | b);
-      goto again;
+      /* speculative decoders must not leave the segment, feed zeros */
+      if (scan->spec) {
+        scan->pRaw -= 2;
+        scan->eos   = true;
+        scan->b     = b = 0;
+      } else {
+        jpg_handle_scanmarker(scan, ((int16_t)b2 << 8) | b);
+        goto again;
+      }
     }
   }
 
+bits:
   scan->cnt--;
   bit     = b >> 7;
   scan->b = b << 1;
@@ -114,16 +135,70 @@ IM_HIDE
 uint8_t
 jpg_decode(ImScan    * __restrict scan,
            ImHuffTbl * __restrict huff) {
-  int32_t i, code;
+  int32_t i, code, k;
 
   code = jpg_nextbit(scan);
   i    = 0;
 
-  for (; code > huff->maxcode[i] && i < 16; i++) {
+  for (; i < 16 && code > huff->maxcode[i]; i++) {
     code = (code << 1) + jpg_nextbit(scan);
   }
 
-  return huff->huffval[code + huff->delta[i]];
+  /* invalid code, corrupt or speculatively decoded data, BITS of a corrupt
+     DHT may also count more than 256 values */
+  if (i == 16 || (uint32_t)(k = code + huff->delta[i]) > 255)
+    return 0;
+
+  return huff->huffval[k];
+}
+
+IM_HIDE
+uint32_t
+jpg_huff_install(ImHuffTbl     * __restrict huff,
+                 const uint8_t * __restrict bits,
+                 const uint8_t * __restrict vals) {
+  uint32_t count, i;
+
+  for (i = 0, count = 0; i < 16; i++)
+    count += bits[i];
+
+  /* streams repeat the same DHT in every frame, keep the built table */
+  if (huff->valid
+      && memcmp(huff->bits, bits, 16) == 0
+      && memcmp(huff->huffval, vals, im_min_i32(count, 256)) == 0)
+    return count;
+
+  memset(huff->huffval,  0, sizeof(*huff->huffval) * 256);
+  memset(huff->maxcode, -1, sizeof(*huff->maxcode) * 16);
+  memset(huff->delta,    0, sizeof(*huff->delta)   * 16);
+
+  jpg_huffcodes((ImByte *)bits, huff);
+  memcpy(huff->bits,    bits, 16);
+  memcpy(huff->huffval, vals, im_min_i32(count, 256));
+  huff->valid = true;
+
+  return count;
+}
+
+IM_HIDE
+void
+jpg_huff_default(ImJpeg * __restrict jpg, uint32_t tc, uint32_t th) {
+  ImHuffTbl *huff;
+
+  if (tc > 1 || th > 1 || jpg->dht[tc][th].valid)
+    return;
+
+  huff = &jpg->dht[tc][th];
+
+  /* K.3 - K.6, as Motion-JPEG expects when a frame has no DHT */
+  if (tc == 0 && th == 0)
+    jpg_huff_install(huff, jpg_k3_dc_luma_bits,   jpg_k3_dc_luma_vals);
+  else if (tc == 0)
+    jpg_huff_install(huff, jpg_k4_dc_chroma_bits, jpg_k4_dc_chroma_vals);
+  else if (th == 0)
+    jpg_huff_install(huff, jpg_k5_ac_luma_bits,   jpg_k5_ac_luma_vals);
+  else
+    jpg_huff_install(huff, jpg_k6_ac_chroma_bits, jpg_k6_ac_chroma_vals);
 }
 
 IM_HIDE
@@ -132,7 +207,7 @@ jpg_dht(ImByte * __restrict pRaw,
         ImJpeg * __restrict jpg) {
   ImByte    *pRawEnd;
   ImHuffTbl *huff;
-  uint16_t   len, count;
+  uint16_t   len, count, i;
   uint8_t    tc, th, tmp;
 
   len     = jpg_get_ui16(pRaw);
@@ -146,17 +221,21 @@ jpg_dht(ImByte * __restrict pRaw,
     pRaw += 1;
 
     /* invalid table location ? ignore it. */
-    if (th > 3)
+    if (th > 3 || tc > 1 || pRaw + 16 > pRawEnd)
       return pRawEnd;
 
-    huff = &jpg->dht[tc][th];
+    for (i = 0, count = 0; i < 16; i++)
+      count += pRaw[i];
 
-    memset(huff->huffval,  0, sizeof(*huff->huffval) * 256);
-    memset(huff->maxcode, -1, sizeof(*huff->maxcode) * 16);
-    memset(huff->delta,    0, sizeof(*huff->delta)   * 16);
+    /* values must be inside of segment */
+    if (count > 256 || pRaw + 16 + count > pRawEnd) {
+      jpg->result = IM_JPEG_INVALID;
+      jpg_dec_exit(jpg);
+      return NULL;
+    }
 
-    count = jpg_huffcodes(pRaw, huff);
-    memcpy(huff->huffval, pRaw + 16, count);
+    huff  = &jpg->dht[tc][th];
+    count = jpg_huff_install(huff, pRaw, pRaw + 16);
 
     pRaw += 16 + count;
   }
@@ -24,6 +24,19 @@ ImByte*
 jpg_dht(ImByte * __restrict pRaw,
          ImJpeg * __restrict jpg);
 
+/* builds table from BITS / HUFFVAL unless it is already built from them,
+   returns number of symbols */
+IM_HIDE
+uint32_t
+jpg_huff_install(ImHuffTbl     * __restrict huff,
+                 const uint8_t * __restrict bits,
+                 const uint8_t * __restrict vals);
+
+/* installs Annex K table into slot 0 or 1 if it is empty */
+IM_HIDE
+void
+jpg_huff_default(ImJpeg * __restrict jpg, uint32_t tc, uint32_t th);
+
 IM_HIDE
 uint8_t
 jpg_decode(ImScan    * __restrict scan,
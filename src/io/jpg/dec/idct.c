@@ -201,3 +201,288 @@ jpg_idct(int16_t * __restrict blk) {
     blk[y] = im_clamp_i32(roundl(blk[y]) + 128, 0, 255);
   }
 }
+
+/*
+ Reduced IDCTs use only the low n x n coefficients. Output sample x is the
+ average of 8/n full size samples, which folds into a per-frequency weight:
+
+   n = 4: c(u)/2 * cos(u*pi/16)
+   n = 2: c(u)/2 * cos(u*pi/16) * cos(u*pi/8)
+
+ multiplied by cos((2x+1)*u*pi/(2n)), Q12.
+ */
+static const int32_t jpg_red4[4][4] = {
+  {1448,  1856,  1338,   652},
+  {1448,   769, -1338, -1573},
+  {1448,  -769, -1338,  1573},
+  {1448, -1856,  1338,  -652}
+};
+
+static const int32_t jpg_red2[2][2] = {
+  {1448,  1312},
+  {1448, -1312}
+};
+
+IM_HIDE
+void
+jpg_idct_red(int16_t  * __restrict blk,
+             ImByte   * __restrict dst,
+             uint32_t              stride,
+             uint32_t              n) {
+  const int32_t *T;
+  int32_t        tmp[16], s;
+  uint32_t       x, y, u;
+
+  /* DC only, mean of the block */
+  if (n == 1) {
+    dst[0] = im_clamp_i32(((blk[0] + 4) >> 3) + 128, 0, 255);
+    return;
+  }
+
+  T = n == 4 ? jpg_red4[0] : jpg_red2[0];
+
+  /* rows */
+  for (y = 0; y < n; y++) {
+    for (x = 0; x < n; x++) {
+      for (s = 0, u = 0; u < n; u++)
+        s += blk[y * 8 + u] * T[x * n + u];
+
+      tmp[y * n + x] = (s + 2048) >> 12;
+    }
+  }
+
+  /* columns */
+  for (y = 0; y < n; y++) {
+    for (x = 0; x < n; x++) {
+      for (s = 0, u = 0; u < n; u++)
+        s += tmp[u * n + x] * T[y * n + u];
+
+      dst[y * stride + x] = im_clamp_i32(((s + 2048) >> 12) + 128, 0, 255);
+    }
+  }
+}
+
+/*
+ 12-bit IDCT, the LLM factorization of libjpeg's islow with 13-bit constants
+ and one extra bit between passes. Intermediate values need more than 16 bits
+ here, so everything is int32. Four columns (then four rows) are transformed
+ at once, pass 2 works on transposed 4x4 tiles.
+ */
+
+#define IDCT12_CONST_BITS 13
+#define IDCT12_PASS1_BITS 1
+#define IDCT12_SHIFT1     (IDCT12_CONST_BITS - IDCT12_PASS1_BITS)
+#define IDCT12_SHIFT2     (IDCT12_CONST_BITS + IDCT12_PASS1_BITS + 3)
+
+#define F_0_298 2446   /* FIX(0.298631336) */
+#define F_0_390 3196   /* FIX(0.390180644) */
+#define F_0_541 4433   /* FIX(0.541196100) */
+#define F_0_765 6270   /* FIX(0.765366865) */
+#define F_0_899 7373   /* FIX(0.899976223) */
+#define F_1_175 9633   /* FIX(1.175875602) */
+#define F_1_501 12299  /* FIX(1.501321110) */
+#define F_1_847 15137  /* FIX(1.847759065) */
+#define F_1_961 16069  /* FIX(1.961570560) */
+#define F_2_053 16819  /* FIX(2.053119869) */
+#define F_2_562 20995  /* FIX(2.562915447) */
+#define F_3_072 25172  /* FIX(3.072711026) */
+
+#if defined(__SSE4_1__)
+#  define IM_IDCT12_SIMD
+typedef __m128i jpg_i32x4;
+#  define i32x4_add(a, b)    _mm_add_epi32(a, b)
+#  define i32x4_sub(a, b)    _mm_sub_epi32(a, b)
+#  define i32x4_mul(a, c)    _mm_mullo_epi32(a, _mm_set1_epi32(c))
+#  define i32x4_shl(a, n)    _mm_slli_epi32(a, n)
+#  define i32x4_sra(a, n)    _mm_srai_epi32(a, n)
+#  define i32x4_set1(c)      _mm_set1_epi32(c)
+#  define i32x4_load(p)      _mm_load_si128((const __m128i *)(p))
+#  define i32x4_store(p, a)  _mm_store_si128((__m128i *)(p), a)
+#elif defined(__ARM_NEON)
+#  define IM_IDCT12_SIMD
+typedef int32x4_t jpg_i32x4;
+#  define i32x4_add(a, b)    vaddq_s32(a, b)
+#  define i32x4_sub(a, b)    vsubq_s32(a, b)
+#  define i32x4_mul(a, c)    vmulq_n_s32(a, c)
+#  define i32x4_shl(a, n)    vshlq_n_s32(a, n)
+#  define i32x4_sra(a, n)    vshrq_n_s32(a, n)
+#  define i32x4_set1(c)      vdupq_n_s32(c)
+#  define i32x4_load(p)      vld1q_s32(p)
+#  define i32x4_store(p, a)  vst1q_s32(p, a)
+#else
+typedef int32_t jpg_i32x4;
+#  define i32x4_add(a, b)    ((a) + (b))
+#  define i32x4_sub(a, b)    ((a) - (b))
+#  define i32x4_mul(a, c)    ((a) * (c))
+#  define i32x4_shl(a, n)    ((int32_t)((uint32_t)(a) << (n)))
+#  define i32x4_sra(a, n)    ((a) >> (n))
+#  define i32x4_set1(c)      (c)
+#  define i32x4_load(p)      (*(p))
+#  define i32x4_store(p, a)  (*(p) = (a))
+#endif
+
+/* 1-D IDCT of in[0..7], rounding is folded into the even part */
+#define IDCT12_1D(in, out, SHIFT)                                             \
+  do {                                                                        \
+    jpg_i32x4 t0, t1, t2, t3, t10, t11, t12, t13, z1, z2, z3, z4, z5;         \
+                                                                              \
+    z1  = i32x4_mul(i32x4_add(in[2], in[6]), F_0_541);                        \
+    t2  = i32x4_sub(z1, i32x4_mul(in[6], F_1_847));                           \
+    t3  = i32x4_add(z1, i32x4_mul(in[2], F_0_765));                           \
+    t0  = i32x4_add(i32x4_shl(i32x4_add(in[0], in[4]), IDCT12_CONST_BITS),    \
+                    i32x4_set1(1 << (SHIFT - 1)));                            \
+    t1  = i32x4_add(i32x4_shl(i32x4_sub(in[0], in[4]), IDCT12_CONST_BITS),    \
+                    i32x4_set1(1 << (SHIFT - 1)));                            \
+    t10 = i32x4_add(t0, t3);                                                  \
+    t13 = i32x4_sub(t0, t3);                                                  \
+    t11 = i32x4_add(t1, t2);                                                  \
+    t12 = i32x4_sub(t1, t2);                                                  \
+                                                                              \
+    z1  = i32x4_add(in[7], in[1]);                                            \
+    z2  = i32x4_add(in[5], in[3]);                                            \
+    z3  = i32x4_add(in[7], in[3]);                                            \
+    z4  = i32x4_add(in[5], in[1]);                                            \
+    z5  = i32x4_mul(i32x4_add(z3, z4), F_1_175);                              \
+    t0  = i32x4_mul(in[7], F_0_298);                                          \
+    t1  = i32x4_mul(in[5], F_2_053);                                          \
+    t2  = i32x4_mul(in[3], F_3_072);                                          \
+    t3  = i32x4_mul(in[1], F_1_501);                                          \
+    z1  = i32x4_mul(z1, -F_0_899);                                            \
+    z2  = i32x4_mul(z2, -F_2_562);                                            \
+    z3  = i32x4_add(i32x4_mul(z3, -F_1_961), z5);                             \
+    z4  = i32x4_add(i32x4_mul(z4, -F_0_390), z5);                             \
+    t0  = i32x4_add(t0, i32x4_add(z1, z3));                                   \
+    t1  = i32x4_add(t1, i32x4_add(z2, z4));                                   \
+    t2  = i32x4_add(t2, i32x4_add(z2, z3));                                   \
+    t3  = i32x4_add(t3, i32x4_add(z1, z4));                                   \
+                                                                              \
+    out[0] = i32x4_sra(i32x4_add(t10, t3), SHIFT);                            \
+    out[7] = i32x4_sra(i32x4_sub(t10, t3), SHIFT);                            \
+    out[1] = i32x4_sra(i32x4_add(t11, t2), SHIFT);                            \
+    out[6] = i32x4_sra(i32x4_sub(t11, t2), SHIFT);                            \
+    out[2] = i32x4_sra(i32x4_add(t12, t1), SHIFT);                            \
+    out[5] = i32x4_sra(i32x4_sub(t12, t1), SHIFT);                            \
+    out[3] = i32x4_sra(i32x4_add(t13, t0), SHIFT);                            \
+    out[4] = i32x4_sra(i32x4_sub(t13, t0), SHIFT);                            \
+  } while (0)
+
+#ifdef IM_IDCT12_SIMD
+
+IM_INLINE
+void
+jpg_idct12_transpose(jpg_i32x4 v[4]) {
+#if defined(__SSE4_1__)
+  __m128 t0, t1, t2, t3;
+
+  t0 = _mm_castsi128_ps(v[0]);
+  t1 = _mm_castsi128_ps(v[1]);
+  t2 = _mm_castsi128_ps(v[2]);
+  t3 = _mm_castsi128_ps(v[3]);
+
+  _MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+
+  v[0] = _mm_castps_si128(t0);
+  v[1] = _mm_castps_si128(t1);
+  v[2] = _mm_castps_si128(t2);
+  v[3] = _mm_castps_si128(t3);
+#else
+  int32x4x2_t a, b;
+
+  a    = vtrnq_s32(v[0], v[1]);
+  b    = vtrnq_s32(v[2], v[3]);
+  v[0] = vcombine_s32(vget_low_s32(a.val[0]),  vget_low_s32(b.val[0]));
+  v[1] = vcombine_s32(vget_low_s32(a.val[1]),  vget_low_s32(b.val[1]));
+  v[2] = vcombine_s32(vget_high_s32(a.val[0]), vget_high_s32(b.val[0]));
+  v[3] = vcombine_s32(vget_high_s32(a.val[1]), vget_high_s32(b.val[1]));
+#endif
+}
+
+/* level shift, clamp to 12 bits and store 4 samples */
+IM_INLINE
+void
+jpg_idct12_put(uint16_t * __restrict dst, jpg_i32x4 v) {
+#if defined(__SSE4_1__)
+  v = _mm_add_epi32(v, _mm_set1_epi32(2048));
+  v = _mm_min_epi32(_mm_max_epi32(v, _mm_setzero_si128()),
+                    _mm_set1_epi32(4095));
+  _mm_storel_epi64((__m128i *)dst, _mm_packus_epi32(v, v));
+#else
+  v = vaddq_s32(v, vdupq_n_s32(2048));
+  v = vminq_s32(vmaxq_s32(v, vdupq_n_s32(0)), vdupq_n_s32(4095));
+  vst1_u16(dst, vmovn_u32(vreinterpretq_u32_s32(v)));
+#endif
+}
+
+IM_HIDE
+void
+jpg_idct12(int32_t  * __restrict blk,
+           uint16_t * __restrict dst,
+           uint32_t              stride) {
+  IM_ALIGN(16) int32_t tmp[64];
+  jpg_i32x4            in[8], out[8];
+  uint32_t             c, r, u, i;
+
+  /* columns, lanes are 4 neighbouring columns */
+  for (c = 0; c < 8; c += 4) {
+    for (i = 0; i < 8; i++)
+      in[i] = i32x4_load(blk + i * 8 + c);
+
+    IDCT12_1D(in, out, IDCT12_SHIFT1);
+
+    for (i = 0; i < 8; i++)
+      i32x4_store(tmp + i * 8 + c, out[i]);
+  }
+
+  /* rows, 4x4 tiles are transposed so lanes are 4 neighbouring rows */
+  for (r = 0; r < 8; r += 4) {
+    for (u = 0; u < 8; u += 4) {
+      for (i = 0; i < 4; i++)
+        in[u + i] = i32x4_load(tmp + (r + i) * 8 + u);
+
+      jpg_idct12_transpose(&in[u]);
+    }
+
+    IDCT12_1D(in, out, IDCT12_SHIFT2);
+
+    jpg_idct12_transpose(&out[0]);
+    jpg_idct12_transpose(&out[4]);
+
+    for (i = 0; i < 4; i++) {
+      jpg_idct12_put(dst + (r + i) * stride,     out[i]);
+      jpg_idct12_put(dst + (r + i) * stride + 4, out[4 + i]);
+    }
+  }
+}
+
+#else
+
+IM_HIDE
+void
+jpg_idct12(int32_t  * __restrict blk,
+           uint16_t * __restrict dst,
+           uint32_t              stride) {
+  int32_t  tmp[64], in[8], out[8];
+  uint32_t c, r, i;
+
+  for (c = 0; c < 8; c++) {
+    for (i = 0; i < 8; i++)
+      in[i] = blk[i * 8 + c];
+
+    IDCT12_1D(in, out, IDCT12_SHIFT1);
+
+    for (i = 0; i < 8; i++)
+      tmp[i * 8 + c] = out[i];
+  }
+
+  for (r = 0; r < 8; r++) {
+    for (i = 0; i < 8; i++)
+      in[i] = tmp[r * 8 + i];
+
+    IDCT12_1D(in, out, IDCT12_SHIFT2);
+
+    for (i = 0; i < 8; i++)
+      dst[r * stride + i] = im_clamp_i32(out[i] + 2048, 0, 4095);
+  }
+}
+
+#endif
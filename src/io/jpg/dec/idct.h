@@ -23,6 +23,21 @@ IM_HIDE
 void
 jpg_idct(int16_t * __restrict blk);
 
+/* reduced IDCT for downscaled decoding, n is 4, 2 or 1 */
+IM_HIDE
+void
+jpg_idct_red(int16_t  * __restrict blk,
+             ImByte   * __restrict dst,
+             uint32_t              stride,
+             uint32_t              n);
+
+/* 12-bit precision, blk is dequantized, stride is in samples */
+IM_HIDE
+void
+jpg_idct12(int32_t  * __restrict blk,
+           uint16_t * __restrict dst,
+           uint32_t              stride);
+
 IM_HIDE
 void
 jpg_idct2(int16_t blk[3][64]);
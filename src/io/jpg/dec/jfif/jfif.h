@@ -19,8 +19,9 @@
 
 #include "../../common.h"
 
+/* parses APP0, returns end of segment */
 IM_HIDE
-void
+ImByte*
 jfif_dec(ImByte *raw, ImJpeg *jpg);
 
 #endif /* src_jpg_jfif_h */
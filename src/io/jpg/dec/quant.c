@@ -70,7 +70,7 @@ void
 jpg_quant16(ImByte * __restrict pRaw, uint16_t qt[64]) {
   int i;
   for (i = 0; i < 64; i++)
-    qt[i] = jpg_get_ui16(&pRaw[i]);
+    qt[unzig[i]] = jpg_get_ui16(&pRaw[i * 2]);
 }
 
 IM_HIDE
@@ -96,6 +96,13 @@ jpg_dqt(ImByte * __restrict pRaw,
     if (tq > 3)
       continue;
 
+    /* table must be inside of segment */
+    if (pRaw + (pq ? 128 : 64) > pRawEnd) {
+      jpg->result = IM_JPEG_INVALID;
+      jpg_dec_exit(jpg);
+      return NULL;
+    }
+
     dqt = &jpg->dqt[tq];
 
     /* 0: 8 bit, 1: 16 bit | 8bit: LUMINANCE, 16bit: CHROMINANCE */
@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "recon.h"
+
+IM_HIDE
+bool
+jpg_rows_alloc(ImJpeg * __restrict jpg, uint32_t count) {
+  ImFrm    *frm;
+  ImByte   *p;
+  size_t    rowsz, pixsz;
+  uint32_t  mcux, stride[4], i, k, Nf, n, bps;
+
+  frm   = &jpg->frm;
+  n     = jpg->dctSize;
+  Nf    = im_min_i32(frm->Nf, 4);
+  bps   = frm->precision > 8 ? 2 : 1;
+  mcux  = (frm->width + (frm->hmax * 8) - 1) / (frm->hmax * 8);
+  rowsz = 0;
+
+  /* strides are in samples, 12-bit samples take two bytes */
+  for (k = 0; k < Nf; k++) {
+    stride[k] = mcux * frm->compo[k].sf.H * n;
+    rowsz    += stride[k] * frm->compo[k].sf.V * n * bps;
+  }
+
+  /* oriented rows and rows that shrink in color conversion are interleaved
+     here first, then scattered to the image */
+  pixsz  = jpg->orient > 1 || jpg->ncomp != Nf
+         ? (size_t)jpg->width * frm->vmax * n * Nf * bps : 0;
+  rowsz += pixsz;
+
+  if (!(jpg->rows = calloc(count, sizeof(*jpg->rows))))
+    return false;
+
+  /* buffer of a previous frame is laid out again if it is large enough */
+  if (jpg->rowcap < rowsz * count) {
+    free(jpg->rowbuf);
+
+    if (!(jpg->rowbuf = malloc(rowsz * count))) {
+      jpg_rows_free(jpg);
+      return false;
+    }
+
+    jpg->rowcap = rowsz * count;
+  }
+
+  p = jpg->rowbuf;
+
+  for (i = 0; i < count; i++) {
+    for (k = 0; k < Nf; k++) {
+      jpg->rows[i].comp[k]   = p;
+      jpg->rows[i].stride[k] = stride[k];
+      p                     += stride[k] * frm->compo[k].sf.V * n * bps;
+    }
+
+    jpg->rows[i].pix = pixsz ? p : NULL;
+    p               += pixsz;
+  }
+
+  jpg->nrows = count;
+
+  return true;
+}
+
+IM_HIDE
+void
+jpg_rows_free(ImJpeg * __restrict jpg) {
+  free(jpg->rows);
+  free(jpg->rowbuf);
+
+  jpg->rows   = NULL;
+  jpg->rowbuf = NULL;
+  jpg->rowcap = 0;
+  jpg->nrows  = 0;
+}
+
+IM_HIDE
+void
+jpg_rows_reset(ImJpeg * __restrict jpg) {
+  free(jpg->rows);
+
+  jpg->rows  = NULL;
+  jpg->nrows = 0;
+}
+
+IM_HIDE
+size_t
+jpg_planar_init(ImJpeg * __restrict jpg, uint32_t width, uint32_t height) {
+  ImImage     *im;
+  ImFrm       *frm;
+  ImComponent *cb, *cr;
+  ImPlane     *pl;
+  size_t       off;
+  uint32_t     k, layout, nsamp;
+
+  im     = jpg->im;
+  frm    = &jpg->frm;
+  layout = jpg->conf ? jpg->conf->planar : IM_PLANAR_NONE;
+
+  /* planes are 8-bit YCbCr only, other layouts stay interleaved */
+  if (layout == IM_PLANAR_NONE
+      || jpg->color != IM_JPEG_COLOR_YCbCr
+      || frm->precision > 8)
+    return 0;
+
+  cb = &frm->compo[1];
+  cr = &frm->compo[2];
+
+  /* semi-planar needs both chroma planes on the same grid */
+  if (layout == IM_PLANAR_NV12
+      && (cb->sf.H != cr->sf.H || cb->sf.V != cr->sf.V))
+    layout = IM_PLANAR_YUV;
+
+  /* samples are one byte in every plane, bits per pixel is the average e.g.
+     12 for 4:2:0 as FourCC codes count it */
+  nsamp = 0;
+  for (k = 0; k < 3; k++)
+    nsamp += frm->compo[k].sf.H * frm->compo[k].sf.V;
+
+  im->planar        = layout;
+  im->planeCount    = layout == IM_PLANAR_NV12 ? 2 : 3;
+  im->format        = IM_FORMAT_YCbCr;
+  im->bytesPerPixel = 1;
+  im->bitsPerPixel  = 8 * nsamp / (frm->hmax * frm->vmax);
+
+  for (k = 0, off = 0; k < im->planeCount; k++) {
+    pl         = &im->planes[k];
+    pl->width  = (width  * frm->compo[k].sf.H + frm->hmax - 1) / frm->hmax;
+    pl->height = (height * frm->compo[k].sf.V + frm->vmax - 1) / frm->vmax;
+    pl->stride = k && layout == IM_PLANAR_NV12 ? pl->width * 2 : pl->width;
+    pl->offset = off;
+    off       += (size_t)pl->stride * pl->height;
+  }
+
+  return off;
+}
+
+IM_HIDE
+void
+jpg_orient_init(ImJpeg * __restrict jpg, uint32_t width, uint32_t height) {
+  ImImage   *im;
+  ImExif    *exif;
+  ptrdiff_t  Nf, w, h, str;
+  uint32_t   ori;
+
+  im           = jpg->im;
+  exif         = im->exif;
+  jpg->width   = width;
+  jpg->height  = height;
+  jpg->orient  = exif && exif->orientation >= 1 && exif->orientation <= 8
+               ? exif->orientation : 1;
+
+  switch (jpg->orient) {
+    case 2:  ori = IM_ORIENTATION_MIRRORED;                        break;
+    case 3:  ori = IM_ORIENTATION_DOWN;                            break;
+    case 4:  ori = IM_ORIENTATION_DOWN  | IM_ORIENTATION_MIRRORED; break;
+    case 5:  ori = IM_ORIENTATION_LEFT  | IM_ORIENTATION_MIRRORED; break;
+    case 6:  ori = IM_ORIENTATION_RIGHT;                           break;
+    case 7:  ori = IM_ORIENTATION_RIGHT | IM_ORIENTATION_MIRRORED; break;
+    case 8:  ori = IM_ORIENTATION_LEFT;                            break;
+    default: ori = IM_ORIENTATION_UP;                              break;
+  }
+
+  /* caller rotates / mirrors itself, keep pixels as stored. Planes are never
+     reoriented, orientation is reported only */
+  if (im->planar || (jpg->conf && (ori & ~jpg->conf->supportedOri) == 0)) {
+    im->ori     = ori;
+    jpg->orient = 1;
+  } else {
+    im->ori     = IM_ORIENTATION_UP;
+  }
+
+  /* 5-8 transpose the frame */
+  if (jpg->orient >= 5) {
+    im->width  = height;
+    im->height = width;
+  } else {
+    im->width  = width;
+    im->height = height;
+  }
+
+  Nf  = jpg->ncomp * (jpg->frm.precision > 8 ? 2 : 1); /* bytes per pixel */
+  w   = width;
+  h   = height;
+  str = (ptrdiff_t)im->width * Nf;
+
+  switch (jpg->orient) {
+    case 2:  jpg->orgn = (w-1)*Nf;           jpg->ox = -Nf;  jpg->oy = str;  break;
+    case 3:  jpg->orgn = (w-1)*Nf+(h-1)*str; jpg->ox = -Nf;  jpg->oy = -str; break;
+    case 4:  jpg->orgn = (h-1)*str;          jpg->ox = Nf;   jpg->oy = -str; break;
+    case 5:  jpg->orgn = 0;                  jpg->ox = str;  jpg->oy = Nf;   break;
+    case 6:  jpg->orgn = (h-1)*Nf;           jpg->ox = str;  jpg->oy = -Nf;  break;
+    case 7:  jpg->orgn = (h-1)*Nf+(w-1)*str; jpg->ox = -str; jpg->oy = -Nf;  break;
+    case 8:  jpg->orgn = (w-1)*str;          jpg->ox = -str; jpg->oy = Nf;   break;
+    default: jpg->orgn = 0;                  jpg->ox = Nf;   jpg->oy = str;  break;
+  }
+}
+
+/*
+ scatter interleaved rows to oriented destination. Transposed orientations walk
+ columns of the source so every store run is contiguous in the image.
+ */
+static
+void
+jpg_orient_rows(ImJpeg   * __restrict jpg,
+                ImByte   * __restrict src,
+                uint32_t              y0,
+                uint32_t              nrows) {
+  ImByte   *base, *d, *s;
+  ptrdiff_t ox, oy;
+  uint32_t  width, Nf, x, y, k;
+
+  width = jpg->width;
+  Nf    = jpg->ncomp * (jpg->frm.precision > 8 ? 2 : 1);
+  ox    = jpg->ox;
+  oy    = jpg->oy;
+  base  = (ImByte *)jpg->im->data.data + jpg->orgn + (ptrdiff_t)y0 * oy;
+
+  if (jpg->orient < 5) {
+    for (y = 0; y < nrows; y++) {
+      s = src + (size_t)y * width * Nf;
+      d = base + (ptrdiff_t)y * oy;
+
+      if (ox > 0) {
+        memcpy(d, s, (size_t)width * Nf);
+        continue;
+      }
+
+      for (x = 0; x < width; x++, s += Nf, d -= Nf) {
+        for (k = 0; k < Nf; k++)
+          d[k] = s[k];
+      }
+    }
+    return;
+  }
+
+  for (x = 0; x < width; x++) {
+    s = src + (size_t)x * Nf;
+    d = base + (ptrdiff_t)x * ox;
+
+    for (y = 0; y < nrows; y++, s += (size_t)width * Nf, d += oy) {
+      for (k = 0; k < Nf; k++)
+        d[k] = s[k];
+    }
+  }
+}
+
+/* IDCT output rows to planes as they are, chroma keeps its own sampling */
+static
+void
+jpg_recon_planar(ImJpeg    * __restrict jpg,
+                 ImJpegRow * __restrict row) {
+  ImImage  *im;
+  ImPlane  *pl;
+  ImByte   *d, *s;
+  uint32_t  y0, y1, y, x, k, V, step;
+
+  im = jpg->im;
+
+  for (k = 0; k < 3; k++) {
+    /* NV12: Cb and Cr share second plane, Cr is one byte after Cb */
+    pl   = &im->planes[im_min_i32(k, im->planeCount - 1)];
+    step = im->planar == IM_PLANAR_NV12 && k ? 2 : 1;
+    V    = jpg->frm.compo[k].sf.V * jpg->dctSize;
+    y0   = row->mcuy * V;
+    y1   = im_min_i32(y0 + V, pl->height);
+
+    for (y = y0; y < y1; y++) {
+      s = row->comp[k] + (y - y0) * row->stride[k];
+      d = (ImByte *)im->data.data + pl->offset + (size_t)y * pl->stride;
+
+      if (step == 1) {
+        memcpy(d, s, pl->width);
+        continue;
+      }
+
+      d += k - 1;
+      for (x = 0; x < pl->width; x++)
+        d[x * 2] = s[x];
+    }
+  }
+}
+
+/*
+ 12-bit samples, same steps as jpg_recon_row() on uint16_t. YCbCr is converted
+ while interleaving, CMYK stays 4 samples per pixel.
+ */
+static
+void
+jpg_recon_row16(ImJpeg    * __restrict jpg,
+                ImJpegRow * __restrict row) {
+  ImFrm    *frm;
+  uint16_t *dst, *d, *s[4];
+  float     Y, Cb, Cr;
+  uint32_t  width, y0, y1, y, x, k, Nf, Hi[4], Vi[4], v;
+
+  frm   = &jpg->frm;
+  Nf    = im_min_i32(frm->Nf, 4);
+  width = jpg->width;
+  y0    = row->mcuy * frm->vmax * 8;
+  y1    = im_min_i32(y0 + frm->vmax * 8, jpg->height);
+  dst   = row->pix ? (uint16_t *)row->pix
+                   : (uint16_t *)jpg->im->data.data + (size_t)y0 * width * Nf;
+
+  for (k = 0; k < Nf; k++) {
+    Hi[k] = frm->hmax / frm->compo[k].sf.H;
+    Vi[k] = frm->vmax / frm->compo[k].sf.V;
+  }
+
+  for (y = y0; y < y1; y++) {
+    d = dst + (size_t)(y - y0) * width * Nf;
+
+    for (k = 0; k < Nf; k++)
+      s[k] = (uint16_t *)row->comp[k] + ((y - y0) / Vi[k]) * row->stride[k];
+
+    if (jpg->color == IM_JPEG_COLOR_YCbCr) {
+      for (x = 0; x < width; x++, d += 3) {
+        Y    = s[0][x / Hi[0]];
+        Cb   = s[1][x / Hi[1]] - 2048.0f;
+        Cr   = s[2][x / Hi[2]] - 2048.0f;
+        d[0] = im_clamp_i32(Y + 1.402f * Cr + 0.5f, 0, 4095);
+        d[1] = im_clamp_i32(Y - 0.344136f * Cb - 0.714136f * Cr + 0.5f,
+                            0, 4095);
+        d[2] = im_clamp_i32(Y + 1.772f * Cb + 0.5f, 0, 4095);
+      }
+      continue;
+    }
+
+    for (x = 0; x < width; x++, d += Nf) {
+      for (k = 0; k < Nf; k++)
+        d[k] = s[k][x / Hi[k]];
+
+      switch (jpg->color) {
+        case IM_JPEG_COLOR_YCCK:
+          Y    = d[0];
+          Cb   = d[1] - 2048.0f;
+          Cr   = d[2] - 2048.0f;
+          d[0] = im_clamp_i32(Y + 1.402f * Cr + 0.5f, 0, 4095);
+          d[1] = im_clamp_i32(Y - 0.344136f * Cb - 0.714136f * Cr + 0.5f,
+                              0, 4095);
+          d[2] = im_clamp_i32(Y + 1.772f * Cb + 0.5f, 0, 4095);
+          d[3] = 4095 - d[3];
+          break;
+        case IM_JPEG_COLOR_CMYKI:
+          for (v = 0; v < 4; v++)
+            d[v] = 4095 - d[v];
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  if (row->pix)
+    jpg_orient_rows(jpg, row->pix, y0, y1 - y0);
+}
+
+/*
+ upsample (nearest) and interleave one MCU row into the image, then convert
+ color while the row is still in cache. Oriented images are built in row
+ scratch and scattered from there, no extra pass over the whole image. CMYK to
+ RGB packs 4 samples into 3 in place, so it goes through row scratch too.
+ */
+IM_HIDE
+void
+jpg_recon_row(ImJpeg    * __restrict jpg,
+              ImJpegRow * __restrict row) {
+  ImFrm    *frm;
+  ImByte   *dst, *d, *s;
+  uint32_t  width, y0, y1, y, x, k, Nf, Hi, Vi;
+
+  if (jpg->im->planar) {
+    jpg_recon_planar(jpg, row);
+    return;
+  }
+
+  if (jpg->frm.precision > 8) {
+    jpg_recon_row16(jpg, row);
+    return;
+  }
+
+  frm   = &jpg->frm;
+  Nf    = im_min_i32(frm->Nf, 4);
+  width = jpg->width;
+  y0    = row->mcuy * frm->vmax * jpg->dctSize;
+  y1    = im_min_i32(y0 + frm->vmax * jpg->dctSize, jpg->height);
+  dst   = row->pix ? row->pix
+                   : (ImByte *)jpg->im->data.data + (size_t)y0 * width * Nf;
+
+  /* single component, IDCT output is final: no sampling, no color work */
+  if (Nf == 1) {
+    for (y = y0; y < y1; y++)
+      memcpy(dst + (size_t)(y - y0) * width,
+             row->comp[0] + (y - y0) * row->stride[0],
+             width);
+
+    if (row->pix)
+      jpg_orient_rows(jpg, row->pix, y0, y1 - y0);
+    return;
+  }
+
+  for (k = 0; k < Nf; k++) {
+    Hi = frm->hmax / frm->compo[k].sf.H;
+    Vi = frm->vmax / frm->compo[k].sf.V;
+
+    for (y = y0; y < y1; y++) {
+      s = row->comp[k] + ((y - y0) / Vi) * row->stride[k];
+      d = dst + (size_t)(y - y0) * width * Nf + k;
+
+      switch (Hi) {
+        case 1:  for (x = 0; x < width; x++) d[x * Nf] = s[x];      break;
+        case 2:  for (x = 0; x < width; x++) d[x * Nf] = s[x >> 1]; break;
+        default: for (x = 0; x < width; x++) d[x * Nf] = s[x / Hi]; break;
+      }
+    }
+  }
+
+  switch (jpg->color) {
+    case IM_JPEG_COLOR_YCbCr:
+      im_YCbCrToRGB(dst, width, y1 - y0);
+      break;
+    case IM_JPEG_COLOR_YCCK:
+      im_YCCKToCMYK(dst, width, y1 - y0);
+      /* fall through */
+    case IM_JPEG_COLOR_CMYK:
+      if (jpg->ncomp == 3)
+        im_CMYKToRGB(dst, width, y1 - y0, false);
+      break;
+    case IM_JPEG_COLOR_CMYKI:
+      if (jpg->ncomp == 3)
+        im_CMYKToRGB(dst, width, y1 - y0, true);
+      else
+        im_CMYKInvert(dst, (size_t)width * (y1 - y0) * 4);
+      break;
+    default:
+      break;
+  }
+
+  if (row->pix) {
+    jpg_orient_rows(jpg, row->pix, y0, y1 - y0);
+  }
+}
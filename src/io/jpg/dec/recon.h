@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef src_jpg_recon_h
+#define src_jpg_recon_h
+
+#include "../common.h"
+
+IM_HIDE
+bool
+jpg_rows_alloc(ImJpeg * __restrict jpg, uint32_t count);
+
+IM_HIDE
+void
+jpg_rows_free(ImJpeg * __restrict jpg);
+
+/* next frame may have another layout, row buffer is kept for reuse */
+IM_HIDE
+void
+jpg_rows_reset(ImJpeg * __restrict jpg);
+
+/* plane layout for YCbCr output, returns buffer size or 0 if interleaved */
+IM_HIDE
+size_t
+jpg_planar_init(ImJpeg * __restrict jpg, uint32_t width, uint32_t height);
+
+/* decoded size and EXIF orientation to image size and writeout steps */
+IM_HIDE
+void
+jpg_orient_init(ImJpeg * __restrict jpg, uint32_t width, uint32_t height);
+
+IM_HIDE
+void
+jpg_recon_row(ImJpeg    * __restrict jpg,
+              ImJpegRow * __restrict row);
+
+/* next row to fill, single threaded decoding always fills the first one */
+IM_INLINE
+ImJpegRow*
+jpg_row_begin(ImJpeg * __restrict jpg) {
+  if (jpg->unwind)
+    return &jpg->rows[0];
+
+  return &jpg->rows[thread_ring_write_begin(&jpg->ring)];
+}
+
+IM_INLINE
+void
+jpg_row_end(ImJpeg * __restrict jpg, ImJpegRow * __restrict row) {
+  if (jpg->unwind)
+    jpg_recon_row(jpg, row);
+  else
+    thread_ring_write_end(&jpg->ring);
+}
+
+#endif /* src_jpg_recon_h */
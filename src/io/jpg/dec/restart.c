@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "restart.h"
+#include "scan.h"
+#include "recon.h"
+
+/* minimum MCU rows per thread, smaller bands are not worth a thread */
+#define IM_JPEG_RST_MIN_ROWS 8
+
+typedef struct jpg_rst_worker_t {
+  ImJpeg       *jpg;
+  ImComponent **comps;
+  ImByte      **starts;
+  ImJpegRow    *row;
+  ImScan        scan;     /* private bit reader and DC predictors */
+  uint32_t      rowStart;
+  uint32_t      rowEnd;
+  bool          failed;   /* interval overran into a marker or data end */
+} jpg_rst_worker_t;
+
+IM_HIDE
+ImByte*
+jpg_dri(ImByte * __restrict pRaw,
+        ImJpeg * __restrict jpg) {
+  jpg->ri = jpg_get_ui16(&pRaw[2]);
+  return pRaw + jpg_get_ui16(pRaw);
+}
+
+IM_INLINE
+void
+jpg_reset_pred(ImScan * __restrict scan) {
+  uint32_t k;
+
+  for (k = 0; k < scan->Ns; k++)
+    scan->compo.comp[k].pred = 0;
+}
+
+IM_HIDE
+void
+jpg_restart(ImScan * __restrict scan) {
+  ImByte *p;
+
+  p = scan->pRaw;
+
+  /* optional fill bytes before marker */
+  while (p[0] == 0xFF && p[1] == 0xFF)
+    p++;
+
+  /* if marker is missing, keep decoding from here and hope for the best */
+  if (p[0] == 0xFF && (p[1] & 0xF8) == 0xD0)
+    p += 2;
+
+  scan->pRaw   = p;
+  scan->cnt    = 0;
+  scan->eobrun = 0;
+
+  jpg_reset_pred(scan);
+}
+
+/*
+ finds start of each restart interval, returns end of entropy-coded segment or
+ NULL if number of intervals does not match with the frame.
+ */
+static
+ImByte*
+jpg_rst_index(ImByte  * __restrict p,
+              ImByte  * __restrict pEnd,
+              ImByte ** __restrict starts,
+              uint32_t             count) {
+  uint32_t n;
+
+  starts[0] = p;
+  n         = 1;
+
+  while ((p = memchr(p, 0xFF, pEnd - p)) && p + 1 < pEnd) {
+    /* stuffed zero or fill byte */
+    if (p[1] == 0x00 || p[1] == 0xFF) {
+      p++;
+      continue;
+    }
+
+    /* another marker ends the scan */
+    if ((p[1] & 0xF8) != 0xD0)
+      return n == count ? p : NULL;
+
+    if (n == count)
+      return NULL;
+
+    starts[n++] = p += 2;
+  }
+
+  return NULL;
+}
+
+static
+void
+jpg_rst_worker(void *argv) {
+  jpg_rst_worker_t *w;
+  ImJpeg           *jpg;
+  ImScan           *scan;
+  uint32_t          mcux, ri, m, skip, i, j;
+
+  w    = argv;
+  jpg  = w->jpg;
+  scan = &w->scan;
+  ri   = jpg->ri;
+  mcux = (jpg->frm.width + (jpg->frm.hmax * 8) - 1) / (jpg->frm.hmax * 8);
+  m    = w->rowStart * mcux;
+
+  /* band may start inside an interval, decode up to it without output */
+  scan->pRaw = w->starts[m / ri];
+  scan->cnt  = 0;
+  jpg_reset_pred(scan);
+
+  for (skip = m % ri; skip > 0 && !scan->eos; skip--)
+    jpg_scan_mcu(jpg, scan, w->comps, NULL, 0);
+
+  for (i = w->rowStart; i < w->rowEnd; i++) {
+    for (j = 0; j < mcux; j++, m++) {
+      if (m % ri == 0) {
+        scan->pRaw = w->starts[m / ri];
+        scan->cnt  = 0;
+        jpg_reset_pred(scan);
+      }
+
+      jpg_scan_mcu(jpg, scan, w->comps, w->row, j);
+
+      /* corrupt interval, scan thread decodes it again and reports it */
+      if (scan->eos) {
+        w->failed = true;
+        return;
+      }
+    }
+
+    w->row->mcuy = i;
+    jpg_recon_row(jpg, w->row);
+  }
+}
+
+IM_HIDE
+ImByte*
+jpg_scan_rst(ImByte       * __restrict pRaw,
+             ImJpeg       * __restrict jpg,
+             ImScan       * __restrict scan,
+             ImComponent ** __restrict comps) {
+  ImFrm            *frm;
+  ImByte          **starts, *pEnd;
+  jpg_rst_worker_t *workers;
+  th_thread       **threads;
+  uint32_t          mcux, mcuy, nint, nth, band, i;
+  bool              failed;
+
+  frm  = &jpg->frm;
+  mcux = (frm->width  + (frm->hmax * 8) - 1) / (frm->hmax * 8);
+  mcuy = (frm->height + (frm->vmax * 8) - 1) / (frm->vmax * 8);
+  nint = (mcux * mcuy + jpg->ri - 1) / jpg->ri;
+  nth  = im_min_i32(thread_ncpu(), mcuy / IM_JPEG_RST_MIN_ROWS);
+  nth  = im_min_i32(nth, nint);
+
+  /* single threaded decoding stays on caller's thread */
+  if (nth < 2 || !jpg->pRawEnd || jpg->unwind)
+    return NULL;
+
+  /* row buffers may already be sized for the pipeline */
+  if (jpg->rows && jpg->nrows < nth)
+    nth = jpg->nrows;
+
+  if (!jpg->rows && !jpg_rows_alloc(jpg, im_max_i32(nth, jpg->ring.depth)))
+    return NULL;
+
+  if (!(starts = malloc(sizeof(*starts) * nint)))
+    return NULL;
+
+  if (!(pEnd = jpg_rst_index(pRaw, jpg->pRawEnd, starts, nint))) {
+    free(starts);
+    return NULL;
+  }
+
+  workers = calloc(nth, sizeof(*workers));
+  threads = calloc(nth, sizeof(*threads));
+
+  if (!workers || !threads) {
+    free(threads);
+    free(workers);
+    free(starts);
+    return NULL;
+  }
+
+  band = (mcuy + nth - 1) / nth;
+
+  for (i = 0; i < nth; i++) {
+    workers[i].jpg       = jpg;
+    workers[i].comps     = comps;
+    workers[i].starts    = starts;
+    workers[i].row       = &jpg->rows[i];
+    workers[i].scan      = *scan;
+    workers[i].scan.spec = true;
+    workers[i].scan.eos  = false;
+    workers[i].rowStart  = im_min_i32(i * band, mcuy);
+    workers[i].rowEnd    = im_min_i32((i + 1) * band, mcuy);
+  }
+
+  /* workers stop at markers instead of jpg_dec_exit(), only scan thread may
+     end decoding or set result */
+  for (i = 0; i < nth; i++)
+    threads[i] = thread_new(jpg_rst_worker, &workers[i]);
+
+  failed = false;
+  for (i = 0; i < nth; i++) {
+    thread_join(threads[i]);
+    thread_release(threads[i]);
+    failed |= workers[i].failed;
+  }
+
+  free(threads);
+  free(workers);
+  free(starts);
+
+  /* decoded sequentially again, rows written by workers are overwritten */
+  return failed ? NULL : pEnd;
+}
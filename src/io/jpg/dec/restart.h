@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef src_jpg_restart_h
+#define src_jpg_restart_h
+
+#include "../common.h"
+
+IM_HIDE
+ImByte*
+jpg_dri(ImByte * __restrict pRaw,
+        ImJpeg * __restrict jpg);
+
+/* byte-align at the end of a restart interval, skip RSTn, reset predictors */
+IM_HIDE
+void
+jpg_restart(ImScan * __restrict scan);
+
+/*
+ decodes an interleaved scan with restart markers by splitting MCU rows across
+ threads, returns end of scan or NULL if the scan must be decoded sequentially
+ */
+IM_HIDE
+ImByte*
+jpg_scan_rst(ImByte       * __restrict pRaw,
+             ImJpeg       * __restrict jpg,
+             ImScan       * __restrict scan,
+             ImComponent ** __restrict comps);
+
+#endif /* src_jpg_restart_h */
@@ -17,6 +17,9 @@
 #include "scan.h"
 #include "huff.h"
 #include "idct.h"
+#include "recon.h"
+#include "restart.h"
+#include "spec.h"
 #include <stdio.h>
 #include <math.h>
 
@@ -51,7 +54,7 @@ jpg_decode_dc(ImJpeg    * __restrict jpg,
               int16_t   * __restrict zz) {
   int16_t t;
 
-  if ((t = jpg_decode(scan, huff))) {
+  if ((t = jpg_decode(scan, huff) & 15)) {
     zz[0] = jpg_extend(jpg_receive(scan, huff, t), t);
   }
 }
@@ -79,7 +82,9 @@ jpg_decode_ac(ImJpeg    * __restrict jpg,
       continue;
     }
 
-    k += r;
+    if ((k += r) > 63)
+      break;
+
     zz[unzig[k++]] = jpg_extend(jpg_receive(scan, huff, ssss), ssss);
   } while (k < 64);
 }
@@ -156,15 +161,124 @@ jpg_dequant(ImQuantTbl * __restrict qt,
 #endif
 }
 
+IM_INLINE
+void
+jpg_put_block(int16_t  * __restrict blk,
+              ImByte   * __restrict dst,
+              uint32_t              stride) {
+  int32_t i, j;
+
+  for (i = 0; i < 8; i++) {
+    for (j = 0; j < 8; j++)
+      dst[j] = (ImByte)blk[j];
+
+    blk += 8;
+    dst += stride;
+  }
+}
+
+IM_HIDE
+void
+jpg_recon_block(ImQuantTbl * __restrict qt,
+                int16_t    * __restrict data,
+                ImByte     * __restrict dst,
+                uint32_t                stride,
+                uint32_t                n) {
+  jpg_dequant(qt, data);
+
+  if (n == 8) {
+    jpg_idct(data);
+    jpg_put_block(data, dst, stride);
+  } else {
+    jpg_idct_red(data, dst, stride, n);
+  }
+}
+
+IM_HIDE
+void
+jpg_recon_block16(ImQuantTbl * __restrict qt,
+                  int16_t    * __restrict data,
+                  uint16_t   * __restrict dst,
+                  uint32_t                stride) {
+  IM_ALIGN(16) int32_t blk[64];
+  uint32_t             i;
+
+  /* products overflow 16 bits at 12-bit precision */
+  for (i = 0; i < 64; i++)
+    blk[i] = (int32_t)data[i] * qt->qt[i];
+
+  jpg_idct12(blk, dst, stride);
+}
+
+IM_HIDE
+void
+jpg_scan_mcu(ImJpeg       * __restrict jpg,
+             ImScan       * __restrict scan,
+             ImComponent ** __restrict comps,
+             ImJpegRow    * __restrict row,
+             uint32_t                  mcux) {
+  IM_ALIGN(16) int16_t data[64];
+  ImFrm               *frm;
+  int32_t              k, Ns;
+
+  frm = &jpg->frm;
+  Ns  = scan->Ns;
+
+  for (k = 0; k < Ns; k++) {
+    ImQuantTbl     *qt;
+    ImComponentSel *icomp;
+    ImByte         *dst;
+    int32_t         Vi, Hi, h, v, ci;
+    uint32_t        stride, n;
+
+    icomp = &scan->compo.comp[k];
+    Vi    = comps[k]->sf.V;
+    Hi    = comps[k]->sf.H;
+
+    for (v = 0; v < Vi; v++) {
+      for (h = 0; h < Hi; h++) {
+        memset(data, 0, sizeof(data));
+
+        jpg_scan_block(jpg, scan, icomp, data);
+
+        icomp->pred = (data[0] += icomp->pred);
+
+        /* skipping to a position inside a restart interval */
+        if (!row)
+          continue;
+
+        ci     = (int32_t)(comps[k] - frm->compo);
+        qt     = &jpg->dqt[comps[k]->Tq];
+        stride = row->stride[ci];
+        n      = jpg->dctSize;
+
+        if (frm->precision > 8) {
+          jpg_recon_block16(qt,
+                            data,
+                            (uint16_t *)row->comp[ci]
+                              + v * 8 * stride + (mcux * Hi + h) * 8,
+                            stride);
+          continue;
+        }
+
+        dst    = row->comp[ci] + v * n * stride + (mcux * Hi + h) * n;
+
+        jpg_recon_block(qt, data, dst, stride, n);
+      }
+    }
+  }
+}
+
 IM_HIDE
 ImByte*
 jpg_scan_intr(ImByte * __restrict pRaw,
               ImJpeg * __restrict jpg,
               ImScan * __restrict scan) {
-  ImFrm               *frm;
-  ImThreadedBlock     *tb;
-  IM_ALIGN(16) int16_t data[64];
-  int                  mcux, mcuy, i, j, k, hmax, vmax, Ns, X, Y;
+  ImFrm       *frm;
+  ImJpegRow   *row;
+  ImComponent *comps[4];
+  ImByte      *pEnd;
+  uint32_t     mcux, mcuy, i, j, k, hmax, vmax, Ns, ri, nmcu;
 
   frm  = &jpg->frm;
   hmax = frm->hmax;
@@ -172,77 +286,48 @@ jpg_scan_intr(ImByte * __restrict pRaw,
 
   mcux = (frm->width  + (hmax * 8) - 1) / (hmax * 8);
   mcuy = (frm->height + (vmax * 8) - 1) / (vmax * 8);
-  X    = frm->width;
-  Y    = frm->height;
 
   scan->cnt  = 0;
   scan->pRaw = pRaw;
   Ns         = scan->Ns;
-  
-  for (i = 0; i < mcuy; i++) {
-    for (j = 0; j < mcux; j++) {
-      uint32_t Vi, Hi, h, v;
-      
-      tb = &jpg->blkpool[jpg->dec_index];
-      if (!tb->avail) {
-        /* thread_cond_wait(&jpg->dec_cond, &jpg->decmutex); */
-        while (!tb->avail) { }
-      }
-
-      thread_lock(&tb->mutex);
-
-      for (k = 0; k < Ns; k++) {
-        ImQuantTbl     *qt;
-        ImComponentSel *icomp;
-        ImComponent    *comp;
-        int32_t         Csj, Tqi;
-
-        icomp = &scan->compo.comp[k];
-        Csj   = icomp->id;
-        
-        if (!(comp = jpg_component_byid(&jpg->frm, Csj))) {
-          thread_exit();
-          return NULL;
-        }
-
-        Tqi         = comp->Tq;
-        qt          = &jpg->dqt[Tqi];
-        Vi          = comp->sf.V;
-        Hi          = comp->sf.H;
-        tb->sf[k].H = Hi;
-        tb->sf[k].V = Vi;
+  ri         = jpg->ri;
+  nmcu       = 0;
+
+  for (k = 0; k < Ns; k++) {
+    if (!(comps[k] = jpg_component_byid(frm, scan->compo.comp[k].id))
+        || comps[k] - frm->compo >= 4) {
+      jpg->result = IM_JPEG_INVALID;
+      jpg_dec_exit(jpg);
+    }
+  }
 
-        for (v = 0; v < Vi; v++) {
-          for (h = 0; h < Hi; h++) {
-            memset(data, 0, sizeof(data));
+  /* independent restart intervals can be decoded by multiple threads */
+  if (ri && (pEnd = jpg_scan_rst(pRaw, jpg, scan, comps)))
+    return pEnd;
 
-            jpg_scan_block(jpg, scan, icomp, data);
+  /* otherwise try to find MCU boundaries speculatively */
+  if (!ri && (pEnd = jpg_scan_spec(pRaw, jpg, scan, comps)))
+    return pEnd;
 
-            icomp->pred = (data[0] += icomp->pred);
+  if (!jpg->rows && !jpg_rows_alloc(jpg, jpg->ring.depth)) {
+    jpg->result = IM_JPEG_INVALID;
+    jpg_dec_exit(jpg);
+  }
 
-            jpg_dequant(qt, data);
-            jpg_idct(data);
+  for (i = 0; i < mcuy; i++) {
+    row = jpg_row_begin(jpg);
 
-            memcpy(tb->blk[v][h][k].blk, data, sizeof(data));
-          }
-        }
-      }
+    for (j = 0; j < mcux; j++) {
+      if (ri && nmcu && nmcu % ri == 0)
+        jpg_restart(scan);
 
-      tb->mcux = j;
-      tb->mcuy = i;
-      tb->xi   = im_min_i32(X - 8 * j, 8);
-      tb->yi   = im_min_i32(Y - 8 * i, 8);
-      
-      if (++jpg->dec_index > 2)
-        jpg->dec_index = 0;
-
-      tb->avail = false;
-      thread_unlock(&tb->mutex);
-      thread_cond_signal(&jpg->cond);
+      jpg_scan_mcu(jpg, scan, comps, row, j);
+      nmcu++;
     }
-  }
 
-  thread_unlock(&jpg->decmutex);
+    row->mcuy = i;
+    jpg_row_end(jpg, row);
+  }
 
   return scan->pRaw;
 }
@@ -19,6 +19,32 @@
 
 #include "../common.h"
 
+/* dequantize, inverse DCT and store n x n block, data is overwritten */
+IM_HIDE
+void
+jpg_recon_block(ImQuantTbl * __restrict qt,
+                int16_t    * __restrict data,
+                ImByte     * __restrict dst,
+                uint32_t                stride,
+                uint32_t                n);
+
+/* 12-bit precision, 8 x 8 block of uint16_t samples, stride is in samples */
+IM_HIDE
+void
+jpg_recon_block16(ImQuantTbl * __restrict qt,
+                  int16_t    * __restrict data,
+                  uint16_t   * __restrict dst,
+                  uint32_t                stride);
+
+/* decodes one interleaved MCU, row may be NULL to only advance predictors */
+IM_HIDE
+void
+jpg_scan_mcu(ImJpeg       * __restrict jpg,
+             ImScan       * __restrict scan,
+             ImComponent ** __restrict comps,
+             ImJpegRow    * __restrict row,
+             uint32_t                  mcux);
+
 IM_HIDE
 ImByte*
 jpg_scan_intr(ImByte * __restrict pRaw,
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/*
+ Speculative Huffman decoding: the entropy-coded segment is split into byte
+ ranges and each thread starts at the beginning of its range as if an MCU began
+ there. Huffman codes self-synchronize, so after a few MCUs the speculative
+ decoder usually lands on the same bit positions as the true one.
+
+ 1. each thread records the state of its first MCUs
+ 2. each thread decodes its range and keeps going into the next one until it
+    hits a recorded MCU start of its successor, that is the sync point
+ 3. sync points are chained from the first range, which is always correct,
+    giving the absolute MCU index and DC predictors of every range
+ 4. each thread decodes its MCU rows again, this time with reconstruction
+
+ If a thread fails to synchronize, runs into a marker while decoding its rows or
+ the MCU count does not match the frame, the scan is decoded sequentially. Only
+ the scan thread may end decoding, workers never call jpg_dec_exit().
+ */
+
+#include "spec.h"
+#include "scan.h"
+#include "recon.h"
+
+/* minimum MCU rows and bytes per thread */
+#define IM_JPEG_SPEC_MIN_ROWS  8
+#define IM_JPEG_SPEC_MIN_BYTES 65536
+
+/* MCU starts recorded per range, sync must be found within these */
+#define IM_JPEG_SPEC_SYNC_MCUS 64
+
+typedef struct jpg_spec_state_t {
+  ImByte  *pRaw;
+  int32_t  cnt;
+  uint8_t  b;
+  int32_t  pred[4];
+} jpg_spec_state_t;
+
+typedef struct jpg_spec_worker_t {
+  ImJpeg                   *jpg;
+  ImComponent             **comps;
+  struct jpg_spec_worker_t *next;
+  ImJpegRow                *row;
+  ImByte                   *pEnd;     /* end of byte range             */
+  ImScan                    scan;     /* private bit reader            */
+  jpg_spec_state_t          rec[IM_JPEG_SPEC_SYNC_MCUS];
+  jpg_spec_state_t          start;    /* true state at mcuStart        */
+  int32_t                   syncPred[4];
+  uint32_t                  nrec;
+  uint32_t                  nmcu;     /* MCUs decoded from range start */
+  uint32_t                  sync;     /* sync point in next->rec       */
+  uint32_t                  mcuStart;
+  uint32_t                  rowStart;
+  uint32_t                  rowEnd;
+  bool                      ok;
+  bool                      failed;   /* corrupt data in step 4        */
+} jpg_spec_worker_t;
+
+IM_INLINE
+void
+jpg_spec_save(ImScan * __restrict scan, jpg_spec_state_t * __restrict st) {
+  uint32_t k;
+
+  st->pRaw = scan->pRaw;
+  st->cnt  = scan->cnt;
+  st->b    = scan->b;
+
+  for (k = 0; k < scan->Ns; k++)
+    st->pred[k] = scan->compo.comp[k].pred;
+}
+
+IM_INLINE
+void
+jpg_spec_load(ImScan * __restrict scan, jpg_spec_state_t * __restrict st) {
+  uint32_t k;
+
+  scan->pRaw = st->pRaw;
+  scan->cnt  = st->cnt;
+  scan->b    = st->b;
+
+  for (k = 0; k < scan->Ns; k++)
+    scan->compo.comp[k].pred = st->pred[k];
+}
+
+/* position of next bit to read */
+IM_INLINE
+uintptr_t
+jpg_spec_pos(ImByte *pRaw, int32_t cnt) {
+  return (uintptr_t)pRaw * 8 - cnt;
+}
+
+/* finds the marker which ends the scan, NULL if restart markers are found */
+static
+ImByte*
+jpg_spec_end(ImByte * __restrict p, ImByte * __restrict pEnd) {
+  while ((p = memchr(p, 0xFF, pEnd - p)) && p + 1 < pEnd) {
+    if (p[1] == 0x00 || p[1] == 0xFF) {
+      p++;
+      continue;
+    }
+
+    return (p[1] & 0xF8) == 0xD0 ? NULL : p;
+  }
+
+  return NULL;
+}
+
+static
+void
+jpg_spec_record(void *argv) {
+  jpg_spec_worker_t *w;
+  ImScan            *scan;
+
+  w    = argv;
+  scan = &w->scan;
+
+  while (w->nrec < IM_JPEG_SPEC_SYNC_MCUS
+         && !scan->eos
+         && scan->pRaw < w->pEnd) {
+    jpg_spec_save(scan, &w->rec[w->nrec++]);
+    jpg_scan_mcu(w->jpg, scan, w->comps, NULL, 0);
+    w->nmcu++;
+  }
+}
+
+static
+void
+jpg_spec_sync(void *argv) {
+  jpg_spec_worker_t *w, *next;
+  ImScan            *scan;
+  jpg_spec_state_t  *st;
+  uintptr_t          pos;
+  uint32_t           k, c;
+
+  w    = argv;
+  next = w->next;
+  scan = &w->scan;
+
+  while (!scan->eos && scan->pRaw < w->pEnd) {
+    jpg_scan_mcu(w->jpg, scan, w->comps, NULL, 0);
+    w->nmcu++;
+  }
+
+  if (!next) {
+    w->ok = !scan->eos;
+    return;
+  }
+
+  /* keep decoding into next range until an MCU start matches */
+  for (k = 0; !scan->eos; w->nmcu++) {
+    pos = jpg_spec_pos(scan->pRaw, scan->cnt);
+
+    while (k < next->nrec
+           && jpg_spec_pos(next->rec[k].pRaw, next->rec[k].cnt) < pos)
+      k++;
+
+    if (k == next->nrec)
+      return;
+
+    st = &next->rec[k];
+    if (st->pRaw == scan->pRaw && st->cnt == scan->cnt) {
+      for (c = 0; c < scan->Ns; c++)
+        w->syncPred[c] = scan->compo.comp[c].pred;
+
+      w->sync = k;
+      w->ok   = true;
+      return;
+    }
+
+    jpg_scan_mcu(w->jpg, scan, w->comps, NULL, 0);
+  }
+}
+
+static
+void
+jpg_spec_decode(void *argv) {
+  jpg_spec_worker_t *w;
+  ImJpeg            *jpg;
+  ImScan            *scan;
+  uint32_t           mcux, m, i, j;
+
+  w    = argv;
+  jpg  = w->jpg;
+  scan = &w->scan;
+  mcux = (jpg->frm.width + (jpg->frm.hmax * 8) - 1) / (jpg->frm.hmax * 8);
+
+  if (w->rowStart >= w->rowEnd)
+    return;
+
+  scan->eos = false;
+  jpg_spec_load(scan, &w->start);
+
+  /* partial row at the start belongs to the previous range */
+  for (m = w->mcuStart; m < w->rowStart * mcux && !scan->eos; m++)
+    jpg_scan_mcu(jpg, scan, w->comps, NULL, 0);
+
+  for (i = w->rowStart; i < w->rowEnd; i++) {
+    for (j = 0; j < mcux; j++) {
+      jpg_scan_mcu(jpg, scan, w->comps, w->row, j);
+
+      if (scan->eos) {
+        w->failed = true;
+        return;
+      }
+    }
+
+    w->row->mcuy = i;
+    jpg_recon_row(jpg, w->row);
+  }
+}
+
+static
+void
+jpg_spec_run(jpg_spec_worker_t *workers,
+             th_thread        **threads,
+             uint32_t           nth,
+             void             (*func)(void *)) {
+  uint32_t i;
+
+  for (i = 0; i < nth; i++)
+    threads[i] = thread_new(func, &workers[i]);
+
+  for (i = 0; i < nth; i++) {
+    thread_join(threads[i]);
+    thread_release(threads[i]);
+  }
+}
+
+/* chains sync points from the first range, false if any link is missing */
+static
+bool
+jpg_spec_resolve(jpg_spec_worker_t *workers,
+                 uint32_t           nth,
+                 uint32_t           Ns,
+                 uint32_t           mcux,
+                 uint32_t           mcuy) {
+  jpg_spec_worker_t *w;
+  int32_t            pred[4] = {0};
+  uint32_t           i, k, c, m;
+
+  m = k = 0;
+
+  for (i = 0; i < nth; i++) {
+    w = &workers[i];
+
+    if (!w->ok || k >= w->nrec || w->nmcu < k)
+      return false;
+
+    w->start    = w->rec[k];
+    w->mcuStart = m;
+    w->rowStart = (m + mcux - 1) / mcux;
+
+    for (c = 0; c < Ns; c++) {
+      w->start.pred[c] = pred[c];
+      pred[c]         += w->syncPred[c] - w->rec[k].pred[c];
+    }
+
+    m += w->nmcu - k;
+    k  = w->sync;
+
+    if (i > 0)
+      workers[i - 1].rowEnd = im_min_i32(w->rowStart, mcuy);
+  }
+
+  workers[nth - 1].rowEnd = mcuy;
+
+  return m == mcux * mcuy;
+}
+
+IM_HIDE
+ImByte*
+jpg_scan_spec(ImByte       * __restrict pRaw,
+              ImJpeg       * __restrict jpg,
+              ImScan       * __restrict scan,
+              ImComponent ** __restrict comps) {
+  ImFrm             *frm;
+  ImByte            *pEnd, *p;
+  jpg_spec_worker_t *workers;
+  th_thread        **threads;
+  size_t             len;
+  uint32_t           mcux, mcuy, nth, i, k;
+  bool               ok;
+
+  frm  = &jpg->frm;
+  mcux = (frm->width  + (frm->hmax * 8) - 1) / (frm->hmax * 8);
+  mcuy = (frm->height + (frm->vmax * 8) - 1) / (frm->vmax * 8);
+  nth  = im_min_i32(thread_ncpu(), mcuy / IM_JPEG_SPEC_MIN_ROWS);
+
+  if (nth < 2
+      || !jpg->pRawEnd
+      || jpg->unwind
+      || !(pEnd = jpg_spec_end(pRaw, jpg->pRawEnd)))
+    return NULL;
+
+  len = pEnd - pRaw;
+  nth = im_min_i32(nth, len / IM_JPEG_SPEC_MIN_BYTES);
+
+  if (jpg->rows && jpg->nrows < nth)
+    nth = jpg->nrows;
+
+  if (nth < 2)
+    return NULL;
+
+  if (!jpg->rows && !jpg_rows_alloc(jpg, im_max_i32(nth, jpg->ring.depth)))
+    return NULL;
+
+  workers = calloc(nth, sizeof(*workers));
+  threads = calloc(nth, sizeof(*threads));
+
+  if (!workers || !threads) {
+    free(threads);
+    free(workers);
+    return NULL;
+  }
+
+  for (i = 0; i < nth; i++) {
+    /* do not start on a stuffed zero */
+    p = pRaw + len * i / nth;
+    if (i > 0 && p[-1] == 0xFF)
+      p++;
+
+    workers[i].jpg        = jpg;
+    workers[i].comps      = comps;
+    workers[i].row        = &jpg->rows[i];
+    workers[i].next       = i + 1 < nth ? &workers[i + 1] : NULL;
+    workers[i].pEnd       = i + 1 < nth ? pRaw + len * (i + 1) / nth : pEnd;
+    workers[i].scan       = *scan;
+    workers[i].scan.pRaw  = p;
+    workers[i].scan.cnt   = 0;
+    workers[i].scan.spec  = true;
+    workers[i].scan.eos   = false;
+
+    for (k = 0; k < scan->Ns; k++)
+      workers[i].scan.compo.comp[k].pred = 0;
+  }
+
+  jpg_spec_run(workers, threads, nth, jpg_spec_record);
+  jpg_spec_run(workers, threads, nth, jpg_spec_sync);
+
+  if ((ok = jpg_spec_resolve(workers, nth, scan->Ns, mcux, mcuy))) {
+    jpg_spec_run(workers, threads, nth, jpg_spec_decode);
+
+    /* rows written by workers are overwritten by sequential decoding */
+    for (i = 0; i < nth; i++)
+      ok &= !workers[i].failed;
+  }
+
+  free(threads);
+  free(workers);
+
+  return ok ? pEnd : NULL;
+}
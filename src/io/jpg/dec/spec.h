@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef src_jpg_spec_h
+#define src_jpg_spec_h
+
+#include "../common.h"
+
+/*
+ speculative parallel decoding of an interleaved scan without restart markers,
+ returns end of scan or NULL if the scan must be decoded sequentially
+ */
+IM_HIDE
+ImByte*
+jpg_scan_spec(ImByte       * __restrict pRaw,
+              ImJpeg       * __restrict jpg,
+              ImScan       * __restrict scan,
+              ImComponent ** __restrict comps);
+
+#endif /* src_jpg_spec_h */
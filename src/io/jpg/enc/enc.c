@@ -0,0 +1,600 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "enc.h"
+#include "writer.h"
+#include "huff.h"
+#include "marker.h"
+#include "fdct.h"
+#include "../tables.h"
+
+#include <stdlib.h>
+
+#define IM_JPEG_ENC_QUALITY 75
+
+typedef struct ImJpegEnc {
+  const ImByte *pix;
+  ptrdiff_t     stride;      /* bytes per source row, < 0: bottom-up    */
+  uint32_t      bpp;         /* bytes per source pixel                  */
+  uint32_t      ch[3];       /* R, G, B or gray offset in source pixel  */
+  uint32_t      width;
+  uint32_t      height;
+  bool          ycc;         /* source samples are YCbCr already        */
+  ImFrm         frm;
+  uint16_t      qt[2][64];   /* luma, chroma in natural order           */
+  IM_ALIGN(16) float rq[2][64]; /* reciprocals of qt                  */
+  ImHuffEnc     dc[2];
+  ImHuffEnc     ac[2];
+  int16_t      *coef[3];     /* whole frame, for optimized tables only  */
+  ImJpegWriter *out;         /* one writer per restart interval         */
+  uint32_t      mcux;
+  uint32_t      mcuy;
+  uint32_t      rows;        /* MCU rows per restart interval           */
+  uint32_t      nint;        /* number of restart intervals             */
+} ImJpegEnc;
+
+typedef struct jpg_enc_worker_t {
+  ImJpegEnc *enc;
+  float     *plane[3];       /* one MCU row of samples, full resolution */
+  int16_t   *coef[3];        /* one MCU row of blocks                   */
+  uint32_t   dcfreq[2][256];
+  uint32_t   acfreq[2][256];
+  uint32_t   first;          /* intervals first, first + step, ...      */
+  uint32_t   step;
+  bool       count;          /* gather statistics instead of writing    */
+  bool       failed;
+} jpg_enc_worker_t;
+
+/* K.1 / K.2 scaled as IJG does, baseline keeps quantizers in 8 bits */
+static
+void
+jpg_enc_quant(ImJpegEnc * __restrict enc, uint32_t quality) {
+  const uint16_t *base;
+  uint32_t        scale, t, i, q;
+
+  quality = quality ? im_clamp_i32(quality, 1, 100) : IM_JPEG_ENC_QUALITY;
+  scale   = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+  for (t = 0; t < 2; t++) {
+    base = t ? jpg_k2_chroma : jpg_k1_luma;
+
+    for (i = 0; i < 64; i++) {
+      q             = im_clamp_i32((base[i] * scale + 50) / 100, 1, 255);
+      enc->qt[t][i] = (uint16_t)q;
+      enc->rq[t][i] = 1.0f / (float)q;
+    }
+  }
+}
+
+/* converts one MCU row to level shifted samples, edges are replicated */
+static
+void
+jpg_enc_samples(ImJpegEnc        * __restrict enc,
+                jpg_enc_worker_t * __restrict w,
+                uint32_t                      my) {
+  const ImByte *src, *s;
+  float        *y, *cb, *cr;
+  float         R, G, B;
+  uint32_t      nrows, pw, r, sy, x, Nf;
+
+  Nf    = enc->frm.Nf;
+  nrows = enc->frm.vmax * 8;
+  pw    = enc->mcux * enc->frm.hmax * 8;
+
+  for (r = 0; r < nrows; r++) {
+    sy  = im_min_i32(my * nrows + r, enc->height - 1);
+    src = enc->pix + (ptrdiff_t)sy * enc->stride;
+    y   = w->plane[0] + (size_t)r * pw;
+    cb  = w->plane[1] + (size_t)r * pw;
+    cr  = w->plane[2] + (size_t)r * pw;
+
+    for (x = 0, s = src; x < enc->width; x++, s += enc->bpp) {
+      if (Nf == 1) {
+        y[x] = s[enc->ch[0]] - 128.0f;
+        continue;
+      }
+
+      R = s[enc->ch[0]];
+      G = s[enc->ch[1]];
+      B = s[enc->ch[2]];
+
+      if (enc->ycc) {
+        y[x]  = R - 128.0f;
+        cb[x] = G - 128.0f;
+        cr[x] = B - 128.0f;
+        continue;
+      }
+
+      /* JFIF, chroma level shift cancels the +128 */
+      y[x]  =  0.299f    * R + 0.587f    * G + 0.114f    * B - 128.0f;
+      cb[x] = -0.168736f * R - 0.331264f * G + 0.5f      * B;
+      cr[x] =  0.5f      * R - 0.418688f * G - 0.081312f * B;
+    }
+
+    for (; x < pw; x++) {
+      y[x] = y[x - 1];
+      if (Nf > 1) {
+        cb[x] = cb[x - 1];
+        cr[x] = cr[x - 1];
+      }
+    }
+  }
+}
+
+/* samples to quantized blocks, subsampled components are box filtered */
+static
+void
+jpg_enc_blocks(ImJpegEnc        * __restrict enc,
+               jpg_enc_worker_t * __restrict w,
+               int16_t         ** __restrict coef) {
+  IM_ALIGN(16) float blk[64];
+  ImComponent         *c;
+  const float         *p;
+  float                sum, norm;
+  uint32_t             pw, k, bw, bx, by, x, y, fx, fy, i, j;
+
+  pw = enc->mcux * enc->frm.hmax * 8;
+
+  for (k = 0; k < enc->frm.Nf; k++) {
+    c    = &enc->frm.compo[k];
+    bw   = enc->mcux * c->sf.H;
+    fx   = enc->frm.hmax / c->sf.H;
+    fy   = enc->frm.vmax / c->sf.V;
+    norm = 1.0f / (float)(fx * fy);
+
+    for (by = 0; by < (uint32_t)c->sf.V; by++) {
+      for (bx = 0; bx < bw; bx++) {
+        for (y = 0; y < 8; y++) {
+          p = w->plane[k] + (size_t)((by * 8 + y) * fy) * pw + bx * 8 * fx;
+
+          for (x = 0; x < 8; x++, p += fx) {
+            if (fx == 1 && fy == 1) {
+              blk[y * 8 + x] = *p;
+              continue;
+            }
+
+            for (i = 0, sum = 0.0f; i < fy; i++) {
+              for (j = 0; j < fx; j++)
+                sum += p[i * pw + j];
+            }
+
+            blk[y * 8 + x] = sum * norm;
+          }
+        }
+
+        jpg_fdct_quant(blk,
+                       enc->rq[c->Tq],
+                       coef[k] + ((size_t)by * bw + bx) * 64);
+      }
+    }
+  }
+}
+
+/* one MCU row in interleaved order, F.1.2 or statistics only */
+static
+void
+jpg_enc_mcus(ImJpegEnc        * __restrict enc,
+             jpg_enc_worker_t * __restrict w,
+             ImJpegWriter     * __restrict wr,
+             int16_t         ** __restrict coef,
+             int32_t          * __restrict pred) {
+  ImComponent *c;
+  int16_t     *blk;
+  uint32_t     j, k, h, v, bw;
+
+  for (j = 0; j < enc->mcux; j++) {
+    for (k = 0; k < enc->frm.Nf; k++) {
+      c  = &enc->frm.compo[k];
+      bw = enc->mcux * c->sf.H;
+
+      for (v = 0; v < (uint32_t)c->sf.V; v++) {
+        blk = coef[k] + ((size_t)v * bw + j * c->sf.H) * 64;
+
+        for (h = 0; h < (uint32_t)c->sf.H; h++, blk += 64) {
+          if (w->count)
+            jpg_huffenc_freq(blk, &pred[k], w->dcfreq[c->Td], w->acfreq[c->Ta]);
+          else
+            jpg_huffenc_block(wr, blk, &pred[k], &enc->dc[c->Td], &enc->ac[c->Ta]);
+        }
+      }
+    }
+  }
+}
+
+/*
+ restart intervals are independent: predictors start from zero and entropy
+ coded data is byte aligned, so each one is written to its own buffer.
+ */
+static
+void
+jpg_enc_worker(void *argv) {
+  jpg_enc_worker_t *w;
+  ImJpegEnc        *enc;
+  ImJpegWriter     *wr;
+  ImComponent      *c;
+  int16_t          *coef[3];
+  int32_t           pred[3];
+  uint32_t          i, my, y1, k;
+
+  w   = argv;
+  enc = w->enc;
+
+  for (i = w->first; i < enc->nint; i += w->step) {
+    wr = w->count ? NULL : &enc->out[i];
+    y1 = im_min_i32((i + 1) * enc->rows, enc->mcuy);
+
+    memset(pred, 0, sizeof(pred));
+
+    for (my = i * enc->rows; my < y1; my++) {
+      for (k = 0; k < enc->frm.Nf; k++) {
+        c       = &enc->frm.compo[k];
+        coef[k] = enc->coef[k]
+                ? enc->coef[k] + (size_t)my * c->sf.V * enc->mcux * c->sf.H * 64
+                : w->coef[k];
+      }
+
+      /* second pass of optimized tables writes blocks of first pass */
+      if (!enc->coef[0] || w->count) {
+        jpg_enc_samples(enc, w, my);
+        jpg_enc_blocks(enc, w, coef);
+      }
+
+      jpg_enc_mcus(enc, w, wr, coef, pred);
+    }
+
+    if (wr) {
+      jpg_put_align(wr);
+      w->failed |= wr->failed;
+    }
+  }
+}
+
+static
+bool
+jpg_enc_worker_init(ImJpegEnc        * __restrict enc,
+                    jpg_enc_worker_t * __restrict w) {
+  ImComponent *c;
+  size_t       pw, nrows;
+  uint32_t     k;
+
+  pw     = (size_t)enc->mcux * enc->frm.hmax * 8;
+  nrows  = (size_t)enc->frm.vmax * 8;
+  w->enc = enc;
+
+  for (k = 0; k < enc->frm.Nf; k++) {
+    c = &enc->frm.compo[k];
+
+    if (!(w->plane[k] = malloc(sizeof(float) * pw * nrows))
+        || !(w->coef[k] = malloc(sizeof(int16_t) * 64
+                                 * enc->mcux * c->sf.H * c->sf.V)))
+      return false;
+  }
+
+  /* gray rows still go through shared code paths */
+  for (; k < 3; k++)
+    w->plane[k] = w->plane[0];
+
+  return true;
+}
+
+static
+void
+jpg_enc_worker_free(jpg_enc_worker_t * __restrict w, uint32_t Nf) {
+  uint32_t k;
+
+  for (k = 0; k < Nf; k++) {
+    free(w->plane[k]);
+    free(w->coef[k]);
+  }
+}
+
+/* runs workers over all restart intervals, returns false on failure */
+static
+bool
+jpg_enc_run(ImJpegEnc        * __restrict enc,
+            jpg_enc_worker_t * __restrict workers,
+            uint32_t                      nth,
+            bool                          count) {
+  th_thread **threads;
+  uint32_t    i;
+  bool        failed;
+
+  for (i = 0; i < nth; i++) {
+    workers[i].first  = i;
+    workers[i].step   = nth;
+    workers[i].count  = count;
+    workers[i].failed = false;
+  }
+
+  if (nth == 1) {
+    jpg_enc_worker(&workers[0]);
+    return !workers[0].failed;
+  }
+
+  if (!(threads = calloc(nth, sizeof(*threads))))
+    return false;
+
+  for (i = 0; i < nth; i++)
+    threads[i] = thread_new(jpg_enc_worker, &workers[i]);
+
+  for (i = 0, failed = false; i < nth; i++) {
+    thread_join(threads[i]);
+    thread_release(threads[i]);
+    failed |= workers[i].failed;
+  }
+
+  free(threads);
+
+  return !failed;
+}
+
+static
+void
+jpg_enc_tables(ImJpegEnc        * __restrict enc,
+               jpg_enc_worker_t * __restrict workers,
+               uint32_t                      nth,
+               bool                          optimize) {
+  uint32_t dcfreq[256], acfreq[256], t, i, s;
+
+  if (!optimize) {
+    jpg_huffenc_init(&enc->dc[0], jpg_k3_dc_luma_bits,   jpg_k3_dc_luma_vals);
+    jpg_huffenc_init(&enc->ac[0], jpg_k5_ac_luma_bits,   jpg_k5_ac_luma_vals);
+    jpg_huffenc_init(&enc->dc[1], jpg_k4_dc_chroma_bits, jpg_k4_dc_chroma_vals);
+    jpg_huffenc_init(&enc->ac[1], jpg_k6_ac_chroma_bits, jpg_k6_ac_chroma_vals);
+    return;
+  }
+
+  for (t = 0; t < 2; t++) {
+    memset(dcfreq, 0, sizeof(dcfreq));
+    memset(acfreq, 0, sizeof(acfreq));
+
+    for (i = 0; i < nth; i++) {
+      for (s = 0; s < 256; s++) {
+        dcfreq[s] += workers[i].dcfreq[t][s];
+        acfreq[s] += workers[i].acfreq[t][s];
+      }
+    }
+
+    jpg_huffenc_optimal(&enc->dc[t], dcfreq);
+    jpg_huffenc_optimal(&enc->ac[t], acfreq);
+  }
+}
+
+static
+void
+jpg_enc_write(ImJpegEnc * __restrict enc, ImJpegWriter * __restrict w) {
+  ImFrm   *frm;
+  ImByte  *p;
+  uint32_t t, i, nt;
+
+  frm = &enc->frm;
+  nt  = frm->Nf > 1 ? 2 : 1;
+
+  jpg_put_marker(w, JPG_SOI);
+  jpg_put_jfif(w);
+
+  for (t = 0; t < nt; t++)
+    jpg_put_dqt(w, t, enc->qt[t]);
+
+  jpg_put_sof(w, JPG_SOF0, frm);
+
+  for (t = 0; t < nt; t++) {
+    jpg_put_dht(w, 0, t, &enc->dc[t]);
+    jpg_put_dht(w, 1, t, &enc->ac[t]);
+  }
+
+  if (enc->nint > 1)
+    jpg_put_dri(w, (uint16_t)(enc->rows * enc->mcux));
+
+  jpg_put_sos(w, frm->compo, frm->Nf);
+
+  for (i = 0; i < enc->nint; i++) {
+    if (jpg_writer_reserve(w, enc->out[i].len)) {
+      p = w->buf + w->len;
+      memcpy(p, enc->out[i].buf, enc->out[i].len);
+      w->len += enc->out[i].len;
+    }
+
+    if (i + 1 < enc->nint)
+      jpg_put_marker(w, (JPGMarker)(JPG_RST(0) + ((i & 7) << 8)));
+  }
+
+  jpg_put_marker(w, JPG_EOI);
+}
+
+/* pixel layout of source, false if it can't be encoded */
+static
+bool
+jpg_enc_source(ImJpegEnc * __restrict enc, const ImImage * __restrict im) {
+  uint32_t r, g, b;
+
+  switch (im->format) {
+    case IM_FORMAT_GRAY:
+    case IM_FORMAT_GRAY_ALPHA: r = g = b = 0;     break;
+    case IM_FORMAT_RGB:
+    case IM_FORMAT_RGB0:
+    case IM_FORMAT_RGBA:       r = 0; g = 1; b = 2; break;
+    case IM_FORMAT_YCbCr:      r = 0; g = 1; b = 2; enc->ycc = true; break;
+    case IM_FORMAT_BGR:
+    case IM_FORMAT_BGR0:
+    case IM_FORMAT_BGRA:       r = 2; g = 1; b = 0; break;
+    case IM_FORMAT_ARGB:       r = 1; g = 2; b = 3; break;
+    case IM_FORMAT_ABGR:       r = 3; g = 2; b = 1; break;
+    default:                   return false;
+  }
+
+  if (im->planar
+      || !im->data.data
+      || im->bitsPerComponent != 8
+      || im->bytesPerPixel <= b
+      || im->width  == 0 || im->width  > 65535
+      || im->height == 0 || im->height > 65535)
+    return false;
+
+  enc->pix    = im->data.data;
+  enc->bpp    = im->bytesPerPixel;
+  enc->stride = (ptrdiff_t)im->width * im->bytesPerPixel + im->row_pad_last;
+
+  /* views into file e.g. IM_OPTION_TOP_DOWN_ROWS may walk backwards */
+  if (im->rowStride)
+    enc->stride = im->rowStride;
+  enc->width  = im->width;
+  enc->height = im->height;
+  enc->ch[0]  = r;
+  enc->ch[1]  = g;
+  enc->ch[2]  = b;
+
+  return true;
+}
+
+static
+void
+jpg_enc_frame(ImJpegEnc          * __restrict enc,
+              const ImImage      * __restrict im,
+              const ImJpegEncode * __restrict opt) {
+  ImFrm       *frm;
+  ImComponent *c;
+  uint32_t     k;
+
+  frm            = &enc->frm;
+  frm->precision = 8;
+  frm->width     = im->width;
+  frm->height    = im->height;
+  frm->Nf        = im->format == IM_FORMAT_GRAY
+                || im->format == IM_FORMAT_GRAY_ALPHA ? 1 : 3;
+
+  for (k = 0; k < frm->Nf; k++) {
+    c       = &frm->compo[k];
+    c->id   = k + 1;
+    c->sf.H = 1;
+    c->sf.V = 1;
+    c->Tq   = c->Td = c->Ta = k ? 1 : 0;
+  }
+
+  /* chroma stays 1x1, luma carries the sampling */
+  if (frm->Nf == 3) {
+    switch (opt->subsampling) {
+      case IM_JPEG_SUBSAMPLING_420: frm->compo[0].sf.V = 2; /* fall through */
+      case IM_JPEG_SUBSAMPLING_422: frm->compo[0].sf.H = 2; break;
+      default: break;
+    }
+  }
+
+  frm->hmax  = frm->compo[0].sf.H;
+  frm->vmax  = frm->compo[0].sf.V;
+  enc->mcux  = (frm->width  + frm->hmax * 8 - 1) / (frm->hmax * 8);
+  enc->mcuy  = (frm->height + frm->vmax * 8 - 1) / (frm->vmax * 8);
+
+  /* DRI counts MCUs in 16 bits */
+  enc->rows  = opt->restartRows
+             ? im_clamp_i32(opt->restartRows, 1, im_max_i32(65535 / enc->mcux, 1))
+             : enc->mcuy;
+  enc->rows  = im_min_i32(enc->rows, enc->mcuy);
+  enc->nint  = (enc->mcuy + enc->rows - 1) / enc->rows;
+}
+
+IM_HIDE
+ImResult
+jpg_encode_mem(ImByte            ** __restrict dest,
+               size_t             * __restrict destSize,
+               const ImImage      * __restrict im,
+               const ImJpegEncode * __restrict opt) {
+  ImJpegEnc         enc;
+  ImJpegEncode      defopt;
+  ImJpegWriter      w;
+  jpg_enc_worker_t *workers;
+  ImComponent      *c;
+  ImResult          ret;
+  uint32_t          nth, i, k;
+
+  *dest     = NULL;
+  *destSize = 0;
+
+  if (!opt) {
+    memset(&defopt, 0, sizeof(defopt));
+    opt = &defopt;
+  }
+
+  memset(&enc, 0, sizeof(enc));
+  memset(&w,   0, sizeof(w));
+
+  if (!jpg_enc_source(&enc, im))
+    return IM_ERR;
+
+  jpg_enc_frame(&enc, im, opt);
+  jpg_enc_quant(&enc, opt->quality);
+
+  nth     = im_max_i32(im_min_i32(thread_ncpu(), enc.nint), 1);
+  ret     = IM_ENOMEM;
+  workers = calloc(nth, sizeof(*workers));
+  enc.out = calloc(enc.nint, sizeof(*enc.out));
+
+  if (!workers || !enc.out)
+    goto err;
+
+  for (i = 0; i < nth; i++) {
+    if (!jpg_enc_worker_init(&enc, &workers[i]))
+      goto err;
+  }
+
+  /* two passes: blocks and statistics first, then entropy coding */
+  if (opt->optimizeHuffman) {
+    for (k = 0; k < enc.frm.Nf; k++) {
+      c = &enc.frm.compo[k];
+      if (!(enc.coef[k] = malloc(sizeof(int16_t) * 64 * enc.mcux * c->sf.H
+                                 * enc.mcuy * c->sf.V)))
+        goto err;
+    }
+
+    if (!jpg_enc_run(&enc, workers, nth, true))
+      goto err;
+  }
+
+  jpg_enc_tables(&enc, workers, nth, opt->optimizeHuffman);
+
+  if (!jpg_enc_run(&enc, workers, nth, false))
+    goto err;
+
+  jpg_enc_write(&enc, &w);
+
+  if (w.failed) {
+    free(w.buf);
+    goto err;
+  }
+
+  *dest     = w.buf;
+  *destSize = w.len;
+  ret       = IM_OK;
+
+err:
+  if (workers) {
+    for (i = 0; i < nth; i++)
+      jpg_enc_worker_free(&workers[i], enc.frm.Nf);
+    free(workers);
+  }
+
+  if (enc.out) {
+    for (i = 0; i < enc.nint; i++)
+      free(enc.out[i].buf);
+    free(enc.out);
+  }
+
+  for (k = 0; k < 3; k++)
+    free(enc.coef[k]);
+
+  return ret;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "fdct.h"
+
+/* C(u) / 2 * cos((2x + 1) * u * pi / 16), row u, so F = M * f * M' */
+IM_ALIGN(16) static const float jpg_fdct_m[64] = {
+   0.353553391f,  0.353553391f,  0.353553391f,  0.353553391f,
+   0.353553391f,  0.353553391f,  0.353553391f,  0.353553391f,
+   0.490392640f,  0.415734806f,  0.277785117f,  0.097545161f,
+  -0.097545161f, -0.277785117f, -0.415734806f, -0.490392640f,
+   0.461939766f,  0.191341716f, -0.191341716f, -0.461939766f,
+  -0.461939766f, -0.191341716f,  0.191341716f,  0.461939766f,
+   0.415734806f, -0.097545161f, -0.490392640f, -0.277785117f,
+   0.277785117f,  0.490392640f,  0.097545161f, -0.415734806f,
+   0.353553391f, -0.353553391f, -0.353553391f,  0.353553391f,
+   0.353553391f, -0.353553391f, -0.353553391f,  0.353553391f,
+   0.277785117f, -0.490392640f,  0.097545161f,  0.415734806f,
+  -0.415734806f, -0.097545161f,  0.490392640f, -0.277785117f,
+   0.191341716f, -0.461939766f,  0.461939766f, -0.191341716f,
+  -0.191341716f,  0.461939766f, -0.461939766f,  0.191341716f,
+   0.097545161f, -0.277785117f,  0.415734806f, -0.490392640f,
+   0.490392640f, -0.415734806f,  0.277785117f, -0.097545161f
+};
+
+#if defined(__SSE__) || defined(__SSE2__)
+
+/* out = M * in, columns of in are processed 4 at a time */
+IM_INLINE
+void
+jpg_fdct_pass(const float * __restrict in, float * __restrict out) {
+  __m128   a0, a1, c;
+  uint32_t u, x;
+
+  for (u = 0; u < 8; u++) {
+    a0 = _mm_setzero_ps();
+    a1 = _mm_setzero_ps();
+
+    for (x = 0; x < 8; x++) {
+      c  = _mm_set1_ps(jpg_fdct_m[u * 8 + x]);
+      a0 = _mm_add_ps(a0, _mm_mul_ps(c, _mm_load_ps(in + x * 8)));
+      a1 = _mm_add_ps(a1, _mm_mul_ps(c, _mm_load_ps(in + x * 8 + 4)));
+    }
+
+    _mm_store_ps(out + u * 8,     a0);
+    _mm_store_ps(out + u * 8 + 4, a1);
+  }
+}
+
+IM_INLINE
+void
+jpg_fdct_transpose(float * __restrict m) {
+  __m128 r0, r1, r2, r3, r4, r5, r6, r7;
+  __m128 s0, s1, s2, s3, s4, s5, s6, s7;
+
+  r0 = _mm_load_ps(m);      r1 = _mm_load_ps(m + 8);
+  r2 = _mm_load_ps(m + 16); r3 = _mm_load_ps(m + 24);
+  r4 = _mm_load_ps(m + 32); r5 = _mm_load_ps(m + 40);
+  r6 = _mm_load_ps(m + 48); r7 = _mm_load_ps(m + 56);
+  s0 = _mm_load_ps(m + 4);  s1 = _mm_load_ps(m + 12);
+  s2 = _mm_load_ps(m + 20); s3 = _mm_load_ps(m + 28);
+  s4 = _mm_load_ps(m + 36); s5 = _mm_load_ps(m + 44);
+  s6 = _mm_load_ps(m + 52); s7 = _mm_load_ps(m + 60);
+
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _MM_TRANSPOSE4_PS(r4, r5, r6, r7);
+  _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+  _MM_TRANSPOSE4_PS(s4, s5, s6, s7);
+
+  /* [A B; C D]' = [A' C'; B' D'] */
+  _mm_store_ps(m,      r0); _mm_store_ps(m + 4,  r4);
+  _mm_store_ps(m + 8,  r1); _mm_store_ps(m + 12, r5);
+  _mm_store_ps(m + 16, r2); _mm_store_ps(m + 20, r6);
+  _mm_store_ps(m + 24, r3); _mm_store_ps(m + 28, r7);
+  _mm_store_ps(m + 32, s0); _mm_store_ps(m + 36, s4);
+  _mm_store_ps(m + 40, s1); _mm_store_ps(m + 44, s5);
+  _mm_store_ps(m + 48, s2); _mm_store_ps(m + 52, s6);
+  _mm_store_ps(m + 56, s3); _mm_store_ps(m + 60, s7);
+}
+
+IM_HIDE
+void
+jpg_fdct_quant(float         * __restrict blk,
+               const float   * __restrict rq,
+               int16_t       * __restrict out) {
+  IM_ALIGN(16) float tmp[64];
+  __m128i              lo, hi;
+  uint32_t             i;
+
+  /* M * f, then M * (M * f)' = (M * f * M')' */
+  jpg_fdct_pass(blk, tmp);
+  jpg_fdct_transpose(tmp);
+  jpg_fdct_pass(tmp, blk);
+  jpg_fdct_transpose(blk);
+
+  /* round to nearest, saturate to int16 */
+  for (i = 0; i < 64; i += 8) {
+    lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(blk + i),
+                                    _mm_load_ps(rq + i)));
+    hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_load_ps(blk + i + 4),
+                                    _mm_load_ps(rq + i + 4)));
+    _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(lo, hi));
+  }
+}
+
+#else
+
+IM_INLINE
+void
+jpg_fdct_pass(const float * __restrict in, float * __restrict out) {
+  float    a[8];
+  uint32_t u, x, i;
+
+  for (u = 0; u < 8; u++) {
+    for (i = 0; i < 8; i++)
+      a[i] = 0.0f;
+
+    for (x = 0; x < 8; x++) {
+      for (i = 0; i < 8; i++)
+        a[i] += jpg_fdct_m[u * 8 + x] * in[x * 8 + i];
+    }
+
+    for (i = 0; i < 8; i++)
+      out[u * 8 + i] = a[i];
+  }
+}
+
+IM_HIDE
+void
+jpg_fdct_quant(float         * __restrict blk,
+               const float   * __restrict rq,
+               int16_t       * __restrict out) {
+  float    tmp[64], t[64], v;
+  uint32_t i, j;
+
+  jpg_fdct_pass(blk, tmp);
+  for (i = 0; i < 8; i++) {
+    for (j = 0; j < 8; j++)
+      t[j * 8 + i] = tmp[i * 8 + j];
+  }
+
+  jpg_fdct_pass(t, tmp);
+  for (i = 0; i < 8; i++) {
+    for (j = 0; j < 8; j++) {
+      v = tmp[j * 8 + i] * rq[i * 8 + j];
+      v = v < 0.0f ? v - 0.5f : v + 0.5f;
+      out[i * 8 + j] = (int16_t)im_clamp_i32((int32_t)v, -32768, 32767);
+    }
+  }
+}
+
+#endif
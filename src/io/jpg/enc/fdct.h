@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef src_jpg_enc_fdct_h
+#define src_jpg_enc_fdct_h
+
+#include "../common.h"
+
+/*
+ A.3.3 forward DCT of level shifted samples followed by quantization. blk is
+ 8x8 row major and is used as scratch, rq holds 1 / Q in natural order and
+ output coefficients are in natural order as decoder keeps them.
+ */
+IM_HIDE
+void
+jpg_fdct_quant(float         * __restrict blk,
+               const float   * __restrict rq,
+               int16_t       * __restrict out);
+
+#endif /* src_jpg_enc_fdct_h */
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "huff.h"
+
+extern uint32_t unzig[64];
+
+/* number of bits of magnitude, F.1.2.1 SSSS */
+IM_INLINE
+uint32_t
+jpg_nbits(int32_t v) {
+  uint32_t n;
+
+  if (v < 0)
+    v = -v;
+
+  for (n = 0; v; n++)
+    v >>= 1;
+
+  return n;
+}
+
+IM_HIDE
+void
+jpg_huffenc_init(ImHuffEnc     * __restrict enc,
+                 const uint8_t * __restrict bits,
+                 const uint8_t * __restrict vals) {
+  uint32_t code, i, j, k;
+
+  memset(enc->code, 0, sizeof(enc->code));
+  memset(enc->size, 0, sizeof(enc->size));
+  memcpy(enc->bits, bits, 16);
+
+  for (i = 0, k = 0, code = 0; i < 16; i++) {
+    for (j = 0; j < bits[i] && k < 256; j++, k++) {
+      enc->vals[k]         = vals[k];
+      enc->code[vals[k]]   = (uint16_t)code++;
+      enc->size[vals[k]]   = (uint8_t)(i + 1);
+    }
+    code <<= 1;
+  }
+
+  enc->nvals = k;
+}
+
+/* Figure K.1, returns longest code size */
+static
+uint32_t
+jpg_huff_codesizes(const uint32_t * __restrict freq,
+                   uint32_t       * __restrict codesize) {
+  uint32_t f[257], v, maxsize;
+  int32_t  others[257], c1, c2, i;
+
+  for (i = 0; i < 256; i++) {
+    f[i]        = freq[i];
+    others[i]   = -1;
+    codesize[i] = 0;
+  }
+
+  /* reserved symbol so no real code is all 1-bits */
+  f[256]        = 1;
+  others[256]   = -1;
+  codesize[256] = 0;
+
+  for (;;) {
+    c1 = -1;
+    v  = UINT32_MAX;
+    for (i = 0; i <= 256; i++) {
+      if (f[i] && f[i] <= v) {
+        v  = f[i];
+        c1 = i;
+      }
+    }
+
+    c2 = -1;
+    v  = UINT32_MAX;
+    for (i = 0; i <= 256; i++) {
+      if (f[i] && f[i] <= v && i != c1) {
+        v  = f[i];
+        c2 = i;
+      }
+    }
+
+    if (c2 < 0)
+      break;
+
+    f[c1] += f[c2];
+    f[c2]  = 0;
+
+    codesize[c1]++;
+    while (others[c1] >= 0) {
+      c1 = others[c1];
+      codesize[c1]++;
+    }
+
+    others[c1] = c2;
+
+    codesize[c2]++;
+    while (others[c2] >= 0) {
+      c2 = others[c2];
+      codesize[c2]++;
+    }
+  }
+
+  for (i = 0, maxsize = 0; i <= 256; i++)
+    maxsize = im_max_i32(maxsize, codesize[i]);
+
+  return maxsize;
+}
+
+IM_HIDE
+void
+jpg_huffenc_optimal(ImHuffEnc      * __restrict enc,
+                    const uint32_t * __restrict freq) {
+  uint32_t f[256], codesize[257], bits[33], any;
+  uint8_t  outbits[16], vals[256];
+  int32_t  i, j, k;
+
+  for (i = 0, any = 0; i < 256; i++) {
+    f[i] = freq[i];
+    any |= f[i];
+  }
+
+  /* table is never used but must still be valid */
+  if (!any)
+    f[0] = 1;
+
+  /* K.3 needs sizes up to 32, flatten very skewed statistics */
+  while (jpg_huff_codesizes(f, codesize) > 32) {
+    for (i = 0; i < 256; i++) {
+      if (f[i])
+        f[i] = (f[i] >> 1) | 1;
+    }
+  }
+
+  /* Figure K.2 */
+  memset(bits, 0, sizeof(bits));
+  for (i = 0; i <= 256; i++) {
+    if (codesize[i])
+      bits[codesize[i]]++;
+  }
+
+  /* Figure K.3, limit code lengths to 16 bits */
+  for (i = 32; i > 16; i--) {
+    while (bits[i] > 0) {
+      j = i - 2;
+      while (bits[j] == 0)
+        j--;
+
+      bits[i]     -= 2;
+      bits[i - 1] += 1;
+      bits[j + 1] += 2;
+      bits[j]     -= 1;
+    }
+  }
+
+  /* remove reserved symbol from the longest codes */
+  while (bits[i] == 0)
+    i--;
+  bits[i]--;
+
+  for (i = 0; i < 16; i++)
+    outbits[i] = (uint8_t)bits[i + 1];
+
+  /* Figure K.4, symbols sorted by code size */
+  for (k = 0, i = 1; i <= 32; i++) {
+    for (j = 0; j < 256; j++) {
+      if (codesize[j] == (uint32_t)i)
+        vals[k++] = (uint8_t)j;
+    }
+  }
+
+  jpg_huffenc_init(enc, outbits, vals);
+}
+
+IM_HIDE
+bool
+jpg_huffenc_covers(const ImHuffEnc * __restrict enc,
+                   const uint32_t  * __restrict freq) {
+  int i;
+
+  for (i = 0; i < 256; i++) {
+    if (freq[i] && !enc->size[i])
+      return false;
+  }
+
+  return true;
+}
+
+IM_HIDE
+void
+jpg_huffenc_block(ImJpegWriter    * __restrict w,
+                  const int16_t   * __restrict blk,
+                  int32_t         * __restrict pred,
+                  const ImHuffEnc * __restrict dc,
+                  const ImHuffEnc * __restrict ac) {
+  int32_t  diff, v;
+  uint32_t k, r, s, rs;
+
+  diff  = blk[0] - *pred;
+  *pred = blk[0];
+  s     = jpg_nbits(diff);
+
+  jpg_put_bits(w, dc->code[s], dc->size[s]);
+  if (s)
+    jpg_put_bits(w, diff < 0 ? diff - 1 : diff, s);
+
+  for (k = 1, r = 0; k < 64; k++) {
+    if (!(v = blk[unzig[k]])) {
+      r++;
+      continue;
+    }
+
+    /* ZRL */
+    for (; r > 15; r -= 16)
+      jpg_put_bits(w, ac->code[0xF0], ac->size[0xF0]);
+
+    s  = jpg_nbits(v);
+    rs = r << 4 | s;
+
+    jpg_put_bits(w, ac->code[rs], ac->size[rs]);
+    jpg_put_bits(w, v < 0 ? v - 1 : v, s);
+    r  = 0;
+  }
+
+  /* EOB */
+  if (r)
+    jpg_put_bits(w, ac->code[0x00], ac->size[0x00]);
+}
+
+IM_HIDE
+void
+jpg_huffenc_freq(const int16_t * __restrict blk,
+                 int32_t       * __restrict pred,
+                 uint32_t      * __restrict dcfreq,
+                 uint32_t      * __restrict acfreq) {
+  int32_t  v;
+  uint32_t k, r;
+
+  dcfreq[jpg_nbits(blk[0] - *pred)]++;
+  *pred = blk[0];
+
+  for (k = 1, r = 0; k < 64; k++) {
+    if (!(v = blk[unzig[k]])) {
+      r++;
+      continue;
+    }
+
+    for (; r > 15; r -= 16)
+      acfreq[0xF0]++;
+
+    acfreq[r << 4 | jpg_nbits(v)]++;
+    r = 0;
+  }
+
+  if (r)
+    acfreq[0x00]++;
+}
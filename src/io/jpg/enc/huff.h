@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef src_jpg_enc_huff_h
+#define src_jpg_enc_huff_h
+
+#include "../common.h"
+#include "writer.h"
+
+/* Annex C tables in encoder form, BITS / HUFFVAL kept for DHT */
+typedef struct ImHuffEnc {
+  uint16_t code[256];
+  uint8_t  size[256];
+  uint8_t  bits[16];
+  uint8_t  vals[256];
+  uint32_t nvals;
+} ImHuffEnc;
+
+/* C.2, EHUFCO / EHUFSI from BITS and HUFFVAL */
+IM_HIDE
+void
+jpg_huffenc_init(ImHuffEnc     * __restrict enc,
+                 const uint8_t * __restrict bits,
+                 const uint8_t * __restrict vals);
+
+/* K.2, code lengths limited to 16 bits from symbol frequencies */
+IM_HIDE
+void
+jpg_huffenc_optimal(ImHuffEnc      * __restrict enc,
+                    const uint32_t * __restrict freq);
+
+/* true if every symbol with a non-zero frequency has a code */
+IM_HIDE
+bool
+jpg_huffenc_covers(const ImHuffEnc * __restrict enc,
+                   const uint32_t  * __restrict freq);
+
+/* F.1.2, block is quantized and in natural order */
+IM_HIDE
+void
+jpg_huffenc_block(ImJpegWriter    * __restrict w,
+                  const int16_t   * __restrict blk,
+                  int32_t         * __restrict pred,
+                  const ImHuffEnc * __restrict dc,
+                  const ImHuffEnc * __restrict ac);
+
+/* same symbols as jpg_huffenc_block() but only counts them */
+IM_HIDE
+void
+jpg_huffenc_freq(const int16_t * __restrict blk,
+                 int32_t       * __restrict pred,
+                 uint32_t      * __restrict dcfreq,
+                 uint32_t      * __restrict acfreq);
+
+#endif /* src_jpg_enc_huff_h */
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "marker.h"
+
+extern uint32_t unzig[64];
+
+IM_HIDE
+void
+jpg_put_dqt(ImJpegWriter   * __restrict w,
+            uint32_t                    Tq,
+            const uint16_t * __restrict qt) {
+  uint32_t i, Pq;
+
+  for (i = 0, Pq = 0; i < 64; i++) {
+    if (qt[i] > 255)
+      Pq = 1;
+  }
+
+  jpg_put_marker(w, JPG_DQT);
+  jpg_put_u16(w, 2 + 1 + 64 * (Pq + 1));
+  jpg_put_u8(w, (uint8_t)(Pq << 4 | Tq));
+
+  /* zig-zag order in the stream */
+  for (i = 0; i < 64; i++) {
+    if (Pq) jpg_put_u16(w, qt[unzig[i]]);
+    else    jpg_put_u8(w, (uint8_t)qt[unzig[i]]);
+  }
+}
+
+IM_HIDE
+void
+jpg_put_sof(ImJpegWriter * __restrict w,
+            JPGMarker                 mrk,
+            const ImFrm  * __restrict frm) {
+  uint32_t i;
+
+  jpg_put_marker(w, mrk);
+  jpg_put_u16(w, 8 + 3 * frm->Nf);
+  jpg_put_u8(w, frm->precision);
+  jpg_put_u16(w, frm->height);
+  jpg_put_u16(w, frm->width);
+  jpg_put_u8(w, frm->Nf);
+
+  for (i = 0; i < frm->Nf; i++) {
+    jpg_put_u8(w, (uint8_t)frm->compo[i].id);
+    jpg_put_u8(w, (uint8_t)(frm->compo[i].sf.H << 4 | frm->compo[i].sf.V));
+    jpg_put_u8(w, (uint8_t)frm->compo[i].Tq);
+  }
+}
+
+IM_HIDE
+void
+jpg_put_dht(ImJpegWriter    * __restrict w,
+            uint32_t                     Tc,
+            uint32_t                     Th,
+            const ImHuffEnc * __restrict enc) {
+  uint32_t i;
+
+  jpg_put_marker(w, JPG_DHT);
+  jpg_put_u16(w, (uint16_t)(2 + 1 + 16 + enc->nvals));
+  jpg_put_u8(w, (uint8_t)(Tc << 4 | Th));
+
+  for (i = 0; i < 16; i++)
+    jpg_put_u8(w, enc->bits[i]);
+
+  for (i = 0; i < enc->nvals; i++)
+    jpg_put_u8(w, enc->vals[i]);
+}
+
+IM_HIDE
+void
+jpg_put_sos(ImJpegWriter      * __restrict w,
+            const ImComponent * __restrict comps,
+            uint32_t                       Ns) {
+  uint32_t i;
+
+  jpg_put_marker(w, JPG_SOS);
+  jpg_put_u16(w, (uint16_t)(6 + 2 * Ns));
+  jpg_put_u8(w, (uint8_t)Ns);
+
+  for (i = 0; i < Ns; i++) {
+    jpg_put_u8(w, (uint8_t)comps[i].id);
+    jpg_put_u8(w, (uint8_t)(comps[i].Td << 4 | comps[i].Ta));
+  }
+
+  jpg_put_u8(w, 0);  /* Ss      */
+  jpg_put_u8(w, 63); /* Se      */
+  jpg_put_u8(w, 0);  /* Ah | Al */
+}
+
+IM_HIDE
+void
+jpg_put_dri(ImJpegWriter * __restrict w, uint16_t ri) {
+  jpg_put_marker(w, JPG_DRI);
+  jpg_put_u16(w, 4);
+  jpg_put_u16(w, ri);
+}
+
+IM_HIDE
+void
+jpg_put_jfif(ImJpegWriter * __restrict w) {
+  static const ImByte ident[5] = { 'J', 'F', 'I', 'F', 0 };
+  uint32_t i;
+
+  jpg_put_marker(w, JPG_APPn(0));
+  jpg_put_u16(w, 16);
+
+  for (i = 0; i < 5; i++)
+    jpg_put_u8(w, ident[i]);
+
+  jpg_put_u16(w, 0x0101); /* version             */
+  jpg_put_u8(w, 0);       /* units, aspect ratio */
+  jpg_put_u16(w, 1);      /* Xdensity            */
+  jpg_put_u16(w, 1);      /* Ydensity            */
+  jpg_put_u8(w, 0);       /* Xthumbnail          */
+  jpg_put_u8(w, 0);       /* Ythumbnail          */
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef src_jpg_enc_marker_h
+#define src_jpg_enc_marker_h
+
+#include "../common.h"
+#include "writer.h"
+#include "huff.h"
+
+/* qt is in natural order as ImQuantTbl */
+IM_HIDE
+void
+jpg_put_dqt(ImJpegWriter   * __restrict w,
+            uint32_t                    Tq,
+            const uint16_t * __restrict qt);
+
+/* SOF0 or SOF1 for frame and its components */
+IM_HIDE
+void
+jpg_put_sof(ImJpegWriter * __restrict w,
+            JPGMarker                 mrk,
+            const ImFrm  * __restrict frm);
+
+IM_HIDE
+void
+jpg_put_dht(ImJpegWriter    * __restrict w,
+            uint32_t                     Tc,
+            uint32_t                     Th,
+            const ImHuffEnc * __restrict enc);
+
+/* sequential scan of given frame components, Ss = 0, Se = 63, Ah = Al = 0 */
+IM_HIDE
+void
+jpg_put_sos(ImJpegWriter      * __restrict w,
+            const ImComponent * __restrict comps,
+            uint32_t                       Ns);
+
+/* APP0 JFIF 1.01 without thumbnail, tells readers samples are YCbCr */
+IM_HIDE
+void
+jpg_put_jfif(ImJpegWriter * __restrict w);
+
+IM_HIDE
+void
+jpg_put_dri(ImJpegWriter * __restrict w, uint16_t ri);
+
+#endif /* src_jpg_enc_marker_h */
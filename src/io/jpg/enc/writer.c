@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "writer.h"
+
+#include <stdlib.h>
+
+IM_HIDE
+bool
+jpg_writer_grow(ImJpegWriter * __restrict w, size_t need) {
+  ImByte *buf;
+  size_t  cap;
+
+  if (w->failed)
+    return false;
+
+  cap = w->cap ? w->cap : 4096;
+  while (cap < w->len + need)
+    cap <<= 1;
+
+  if (!(buf = realloc(w->buf, cap))) {
+    w->failed = true;
+    return false;
+  }
+
+  w->buf = buf;
+  w->cap = cap;
+
+  return true;
+}
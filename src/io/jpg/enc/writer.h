@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef src_jpg_enc_writer_h
+#define src_jpg_enc_writer_h
+
+#include "../common.h"
+
+/* growable output with entropy coded bit accumulator */
+typedef struct ImJpegWriter {
+  ImByte   *buf;
+  size_t    len;
+  size_t    cap;
+  uint32_t  acc;   /* pending bits, right aligned */
+  uint32_t  nacc;  /* number of pending bits, < 8 */
+  bool      failed;
+} ImJpegWriter;
+
+IM_HIDE
+bool
+jpg_writer_grow(ImJpegWriter * __restrict w, size_t need);
+
+IM_INLINE
+bool
+jpg_writer_reserve(ImJpegWriter * __restrict w, size_t n) {
+  if (likely(w->len + n <= w->cap))
+    return true;
+  return jpg_writer_grow(w, n);
+}
+
+IM_INLINE
+void
+jpg_put_u8(ImJpegWriter * __restrict w, uint8_t val) {
+  if (jpg_writer_reserve(w, 1))
+    w->buf[w->len++] = val;
+}
+
+IM_INLINE
+void
+jpg_put_u16(ImJpegWriter * __restrict w, uint16_t val) {
+  if (jpg_writer_reserve(w, 2)) {
+    w->buf[w->len++] = (ImByte)(val >> 8);
+    w->buf[w->len++] = (ImByte)val;
+  }
+}
+
+/* markers are defined as they appear in memory e.g. 0xD8FF */
+IM_INLINE
+void
+jpg_put_marker(ImJpegWriter * __restrict w, JPGMarker mrk) {
+  if (jpg_writer_reserve(w, 2)) {
+    w->buf[w->len++] = (ImByte)mrk;
+    w->buf[w->len++] = (ImByte)(mrk >> 8);
+  }
+}
+
+/* F.1.2.3, appends up to 16 bits, 0xFF bytes are stuffed with 0x00 */
+IM_INLINE
+void
+jpg_put_bits(ImJpegWriter * __restrict w, uint32_t code, uint32_t size) {
+  ImByte  *p;
+  uint32_t acc, nacc, b;
+
+  /* 3 bytes at most, each may be stuffed */
+  if (!jpg_writer_reserve(w, 6))
+    return;
+
+  acc  = (w->acc << size) | (code & ((1u << size) - 1));
+  nacc = w->nacc + size;
+  p    = w->buf + w->len;
+
+  while (nacc >= 8) {
+    nacc -= 8;
+    b     = (acc >> nacc) & 0xFF;
+    *p++  = (ImByte)b;
+
+    if (b == 0xFF)
+      *p++ = 0;
+  }
+
+  w->acc  = acc & ((1u << nacc) - 1);
+  w->nacc = nacc;
+  w->len  = (size_t)(p - w->buf);
+}
+
+/* pads last byte with 1-bits, F.1.2.3 */
+IM_INLINE
+void
+jpg_put_align(ImJpegWriter * __restrict w) {
+  if (w->nacc)
+    jpg_put_bits(w, 0x7F, 8 - w->nacc);
+}
+
+#endif /* src_jpg_enc_writer_h */
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef src_jpg_tables_h
+#define src_jpg_tables_h
+
+#include "common.h"
+
+/* Annex K typical tables, quantizers are in natural order as ImQuantTbl */
+extern const uint16_t jpg_k1_luma[64];
+extern const uint16_t jpg_k2_chroma[64];
+
+extern const uint8_t  jpg_k3_dc_luma_bits[16];
+extern const uint8_t  jpg_k3_dc_luma_vals[12];
+extern const uint8_t  jpg_k4_dc_chroma_bits[16];
+extern const uint8_t  jpg_k4_dc_chroma_vals[12];
+extern const uint8_t  jpg_k5_ac_luma_bits[16];
+extern const uint8_t  jpg_k5_ac_luma_vals[162];
+extern const uint8_t  jpg_k6_ac_chroma_bits[16];
+extern const uint8_t  jpg_k6_ac_chroma_vals[162];
+
+#endif /* src_jpg_tables_h */
@@ -0,0 +1,447 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trans.h"
+#include "dec/dec.h"
+#include "enc/writer.h"
+#include "enc/huff.h"
+#include "enc/marker.h"
+
+#include <stdlib.h>
+
+typedef struct ImJpegTrans {
+  ImJpeg   *jpg;
+  ImFrm     frm;           /* output frame                           */
+  int16_t  *coef[4];       /* output blocks, padded to whole MCUs    */
+  uint16_t  qt[4][64];     /* output quant tables                    */
+  ImHuffEnc dc[2];
+  ImHuffEnc ac[2];
+  uint32_t  dcfreq[2][256];
+  uint32_t  acfreq[2][256];
+  uint32_t  mcux;
+  uint32_t  mcuy;
+} ImJpegTrans;
+
+IM_INLINE
+bool
+jpg_tr_transposes(ImJpegTransformType t) {
+  return t == IM_JPEG_TRANSFORM_TRANSPOSE
+      || t == IM_JPEG_TRANSFORM_TRANSVERSE
+      || t == IM_JPEG_TRANSFORM_ROT_90
+      || t == IM_JPEG_TRANSFORM_ROT_270;
+}
+
+/* source x / y run backwards, partial edge MCUs can't move so are trimmed */
+IM_INLINE
+bool
+jpg_tr_flipx(ImJpegTransformType t) {
+  return t == IM_JPEG_TRANSFORM_FLIP_H
+      || t == IM_JPEG_TRANSFORM_ROT_180
+      || t == IM_JPEG_TRANSFORM_ROT_270
+      || t == IM_JPEG_TRANSFORM_TRANSVERSE;
+}
+
+IM_INLINE
+bool
+jpg_tr_flipy(ImJpegTransformType t) {
+  return t == IM_JPEG_TRANSFORM_FLIP_V
+      || t == IM_JPEG_TRANSFORM_ROT_180
+      || t == IM_JPEG_TRANSFORM_ROT_90
+      || t == IM_JPEG_TRANSFORM_TRANSVERSE;
+}
+
+/*
+ per coefficient source index and sign. Mirroring a block negates odd
+ frequencies along the mirrored axis, rotations are a transpose plus mirror.
+ */
+static
+void
+jpg_tr_block_map(ImJpegTransformType t, uint8_t idx[64], int8_t sgn[64]) {
+  bool     negu, negv, trans;
+  uint32_t u, v;
+
+  trans = jpg_tr_transposes(t);
+  negu  = t == IM_JPEG_TRANSFORM_FLIP_H
+       || t == IM_JPEG_TRANSFORM_ROT_180
+       || t == IM_JPEG_TRANSFORM_ROT_90
+       || t == IM_JPEG_TRANSFORM_TRANSVERSE;
+  negv  = t == IM_JPEG_TRANSFORM_FLIP_V
+       || t == IM_JPEG_TRANSFORM_ROT_180
+       || t == IM_JPEG_TRANSFORM_ROT_270
+       || t == IM_JPEG_TRANSFORM_TRANSVERSE;
+
+  for (v = 0; v < 8; v++) {
+    for (u = 0; u < 8; u++) {
+      idx[v * 8 + u] = (uint8_t)(trans ? u * 8 + v : v * 8 + u);
+      sgn[v * 8 + u] = ((negu && (u & 1)) ^ (negv && (v & 1))) ? -1 : 1;
+    }
+  }
+}
+
+/* output block (X, Y) of full transformed grid to source block */
+IM_INLINE
+void
+jpg_tr_src_block(ImJpegTransformType t,
+                 int32_t             X,
+                 int32_t             Y,
+                 int32_t             tw,
+                 int32_t             th,
+                 int32_t            *sx,
+                 int32_t            *sy) {
+  switch (t) {
+    case IM_JPEG_TRANSFORM_FLIP_H:     *sx = tw - 1 - X; *sy = Y;          break;
+    case IM_JPEG_TRANSFORM_FLIP_V:     *sx = X;          *sy = th - 1 - Y; break;
+    case IM_JPEG_TRANSFORM_TRANSPOSE:  *sx = Y;          *sy = X;          break;
+    case IM_JPEG_TRANSFORM_TRANSVERSE: *sx = tw - 1 - Y; *sy = th - 1 - X; break;
+    case IM_JPEG_TRANSFORM_ROT_90:     *sx = Y;          *sy = th - 1 - X; break;
+    case IM_JPEG_TRANSFORM_ROT_180:    *sx = tw - 1 - X; *sy = th - 1 - Y; break;
+    case IM_JPEG_TRANSFORM_ROT_270:    *sx = tw - 1 - Y; *sy = X;          break;
+    default:                           *sx = X;          *sy = Y;          break;
+  }
+}
+
+static
+ImResult
+jpg_tr_blocks(ImJpegTrans           * __restrict tj,
+              const ImJpegTransform * __restrict tr) {
+  ImJpeg      *jpg;
+  ImFrm       *sfrm, *ofrm;
+  ImComponent *sc, *oc;
+  int16_t     *src, *dst;
+  uint8_t      idx[64];
+  int8_t       sgn[64];
+  uint32_t     W, H, TW, TH, cx, cy, cw, ch, smw, smh, omw, omh, smcux, smcuy;
+  uint32_t     k, Nf, i, obw, obh, sbw, sbh, bx0, by0, ox, oy;
+  int32_t      tw, th, sx, sy;
+
+  jpg  = tj->jpg;
+  sfrm = &jpg->frm;
+  ofrm = &tj->frm;
+  Nf   = sfrm->Nf;
+
+  smw   = sfrm->hmax * 8;
+  smh   = sfrm->vmax * 8;
+  smcux = (sfrm->width  + smw - 1) / smw;
+  smcuy = (sfrm->height + smh - 1) / smh;
+  W     = sfrm->width;
+  H     = sfrm->height;
+
+  if (jpg_tr_flipx(tr->type)) W = W / smw * smw;
+  if (jpg_tr_flipy(tr->type)) H = H / smh * smh;
+
+  if (!W || !H)
+    return IM_ERR;
+
+  /* output frame, sampling factors follow the transposed axes */
+  *ofrm = *sfrm;
+  if (jpg_tr_transposes(tr->type)) {
+    ofrm->hmax = sfrm->vmax;
+    ofrm->vmax = sfrm->hmax;
+
+    for (k = 0; k < Nf; k++) {
+      ofrm->compo[k].sf.H = sfrm->compo[k].sf.V;
+      ofrm->compo[k].sf.V = sfrm->compo[k].sf.H;
+    }
+
+    TW = H;
+    TH = W;
+  } else {
+    TW = W;
+    TH = H;
+  }
+
+  /* crop is in output space, its origin snaps to MCU boundary */
+  omw = ofrm->hmax * 8;
+  omh = ofrm->vmax * 8;
+  cx  = tr->cropX / omw * omw;
+  cy  = tr->cropY / omh * omh;
+
+  if (cx >= TW || cy >= TH)
+    return IM_ERR;
+
+  cw = tr->cropWidth  ? tr->cropWidth  + (tr->cropX - cx) : TW;
+  ch = tr->cropHeight ? tr->cropHeight + (tr->cropY - cy) : TH;
+  cw = im_min_i32(cw, TW - cx);
+  ch = im_min_i32(ch, TH - cy);
+
+  ofrm->width  = (uint16_t)cw;
+  ofrm->height = (uint16_t)ch;
+  tj->mcux     = (cw + omw - 1) / omw;
+  tj->mcuy     = (ch + omh - 1) / omh;
+
+  jpg_tr_block_map(tr->type, idx, sgn);
+
+  for (k = 0; k < Nf; k++) {
+    sc  = &sfrm->compo[k];
+    oc  = &ofrm->compo[k];
+    sbw = smcux * sc->sf.H;
+    sbh = smcuy * sc->sf.V;
+    tw  = (int32_t)(W / smw * sc->sf.H);
+    th  = (int32_t)(H / smh * sc->sf.V);
+    obw = tj->mcux * oc->sf.H;
+    obh = tj->mcuy * oc->sf.V;
+    bx0 = cx / omw * oc->sf.H;
+    by0 = cy / omh * oc->sf.V;
+
+    if (!(tj->coef[k] = calloc((size_t)obw * obh * 64, sizeof(int16_t))))
+      return IM_ENOMEM;
+
+    for (oy = 0; oy < obh; oy++) {
+      for (ox = 0; ox < obw; ox++) {
+        jpg_tr_src_block(tr->type, ox + bx0, oy + by0, tw, th, &sx, &sy);
+
+        /* MCU padding past the source, left as zero */
+        if (sx < 0 || sy < 0 || (uint32_t)sx >= sbw || (uint32_t)sy >= sbh)
+          continue;
+
+        src = jpg->coef[k] + ((size_t)sy * sbw + sx) * 64;
+        dst = tj->coef[k]  + ((size_t)oy * obw + ox) * 64;
+
+        for (i = 0; i < 64; i++)
+          dst[i] = (int16_t)(src[idx[i]] * sgn[i]);
+      }
+    }
+  }
+
+  /* quantizer of coefficient (u, v) moves with it */
+  for (k = 0; k < 4; k++) {
+    for (i = 0; i < 64; i++)
+      tj->qt[k][i] = jpg->dqt[k].qt[idx[i]];
+  }
+
+  return IM_OK;
+}
+
+/* walks blocks in scan order, encodes them or only gathers statistics */
+static
+void
+jpg_tr_scan(ImJpegTrans * __restrict tj, ImJpegWriter * __restrict w) {
+  ImFrm       *frm;
+  ImComponent *c;
+  int16_t     *blk;
+  int32_t      pred[4];
+  uint32_t     i, j, h, v, k, bw, cw, ch, Td, Ta;
+
+  frm = &tj->frm;
+
+  memset(pred, 0, sizeof(pred));
+
+  /* non-interleaved, MCU is one block and only blocks inside image count */
+  if (frm->Nf == 1) {
+    c  = &frm->compo[0];
+    bw = tj->mcux * c->sf.H;
+    cw = (frm->width  + 7) / 8;
+    ch = (frm->height + 7) / 8;
+
+    for (i = 0; i < ch; i++) {
+      for (j = 0; j < cw; j++) {
+        blk = tj->coef[0] + ((size_t)i * bw + j) * 64;
+
+        if (w)
+          jpg_huffenc_block(w, blk, &pred[0], &tj->dc[c->Td], &tj->ac[c->Ta]);
+        else
+          jpg_huffenc_freq(blk, &pred[0], tj->dcfreq[c->Td], tj->acfreq[c->Ta]);
+      }
+    }
+    return;
+  }
+
+  for (i = 0; i < tj->mcuy; i++) {
+    for (j = 0; j < tj->mcux; j++) {
+      for (k = 0; k < frm->Nf; k++) {
+        c  = &frm->compo[k];
+        bw = tj->mcux * c->sf.H;
+        Td = c->Td;
+        Ta = c->Ta;
+
+        for (v = 0; v < (uint32_t)c->sf.V; v++) {
+          blk = tj->coef[k]
+              + (((size_t)i * c->sf.V + v) * bw + j * c->sf.H) * 64;
+
+          for (h = 0; h < (uint32_t)c->sf.H; h++, blk += 64) {
+            if (w)
+              jpg_huffenc_block(w, blk, &pred[k], &tj->dc[Td], &tj->ac[Ta]);
+            else
+              jpg_huffenc_freq(blk, &pred[k], tj->dcfreq[Td], tj->acfreq[Ta]);
+          }
+        }
+      }
+    }
+  }
+}
+
+static
+void
+jpg_tr_tables(ImJpegTrans           * __restrict tj,
+              const ImJpegTransform * __restrict tr) {
+  ImJpeg      *jpg;
+  ImComponent *comp;
+  uint32_t     t, Nf;
+  bool         reuse;
+
+  jpg   = tj->jpg;
+  Nf    = tj->frm.Nf;
+  reuse = !tr->optimizeHuffman && !jpg->frm.progressive;
+
+  /* source tables can be reused only if they are loaded and slots fit */
+  for (t = 0; reuse && t < Nf; t++) {
+    comp  = &tj->frm.compo[t];
+    reuse = comp->Td < 2 && comp->Ta < 2
+         && jpg->dht[0][comp->Td].valid
+         && jpg->dht[1][comp->Ta].valid;
+  }
+
+  if (!reuse) {
+    for (t = 0; t < Nf; t++) {
+      tj->frm.compo[t].Td = t ? 1 : 0;
+      tj->frm.compo[t].Ta = t ? 1 : 0;
+    }
+  }
+
+  jpg_tr_scan(tj, NULL);
+
+  if (reuse) {
+    for (t = 0; t < 2; t++) {
+      jpg_huffenc_init(&tj->dc[t], jpg->dht[0][t].bits, jpg->dht[0][t].huffval);
+      jpg_huffenc_init(&tj->ac[t], jpg->dht[1][t].bits, jpg->dht[1][t].huffval);
+
+      /* transposed zig-zag runs may need symbols source never used */
+      reuse = reuse
+           && jpg_huffenc_covers(&tj->dc[t], tj->dcfreq[t])
+           && jpg_huffenc_covers(&tj->ac[t], tj->acfreq[t]);
+    }
+
+    if (reuse)
+      return;
+
+    /* statistics are per slot, regather with canonical slot mapping */
+    for (t = 0; t < Nf; t++) {
+      tj->frm.compo[t].Td = t ? 1 : 0;
+      tj->frm.compo[t].Ta = t ? 1 : 0;
+    }
+
+    memset(tj->dcfreq, 0, sizeof(tj->dcfreq));
+    memset(tj->acfreq, 0, sizeof(tj->acfreq));
+
+    jpg_tr_scan(tj, NULL);
+  }
+
+  for (t = 0; t < 2; t++) {
+    jpg_huffenc_optimal(&tj->dc[t], tj->dcfreq[t]);
+    jpg_huffenc_optimal(&tj->ac[t], tj->acfreq[t]);
+  }
+}
+
+static
+void
+jpg_tr_write(ImJpegTrans * __restrict tj, ImJpegWriter * __restrict w) {
+  ImFrm    *frm;
+  uint32_t  k, i, used;
+  bool      ext;
+
+  frm = &tj->frm;
+  ext = false;
+
+  jpg_put_marker(w, JPG_SOI);
+
+  for (k = 0, used = 0; k < frm->Nf; k++) {
+    if (used & (1u << frm->compo[k].Tq))
+      continue;
+
+    used |= 1u << frm->compo[k].Tq;
+    jpg_put_dqt(w, frm->compo[k].Tq, tj->qt[frm->compo[k].Tq]);
+
+    for (i = 0; i < 64; i++)
+      ext |= tj->qt[frm->compo[k].Tq][i] > 255;
+  }
+
+  /* 16-bit quantizers are not allowed in baseline */
+  jpg_put_sof(w, ext ? JPG_SOF1 : JPG_SOF0, frm);
+
+  for (k = 0, used = 0; k < frm->Nf; k++) {
+    used |= 1u << frm->compo[k].Td;
+    used |= 1u << (frm->compo[k].Ta + 2);
+  }
+
+  for (i = 0; i < 2; i++) {
+    if (used & (1u << i))       jpg_put_dht(w, 0, i, &tj->dc[i]);
+    if (used & (1u << (i + 2))) jpg_put_dht(w, 1, i, &tj->ac[i]);
+  }
+
+  jpg_put_sos(w, frm->compo, frm->Nf);
+  jpg_tr_scan(tj, w);
+
+  jpg_put_align(w);
+  jpg_put_marker(w, JPG_EOI);
+}
+
+IM_HIDE
+ImResult
+jpg_transform_mem(ImByte               ** __restrict dest,
+                  size_t                * __restrict destSize,
+                  ImByte                * __restrict raw,
+                  size_t                             size,
+                  const ImJpegTransform * __restrict tr) {
+  im_open_config_t conf;
+  ImJpegTrans     *tj;
+  ImJpegWriter     w;
+  ImResult         ret;
+  uint32_t         k;
+
+  *dest     = NULL;
+  *destSize = 0;
+
+  memset(&conf, 0, sizeof(conf));
+  memset(&w,    0, sizeof(w));
+  conf.openIntent = IM_OPEN_INTENT_READONLY;
+
+  if (!(tj = calloc(1, sizeof(*tj))))
+    return IM_ENOMEM;
+
+  if (!(tj->jpg = jpg_dec_coef(raw, size, &conf))) {
+    free(tj);
+    return IM_ERR;
+  }
+
+  if (tj->jpg->frm.precision != 8 || tj->jpg->frm.Nf > 4) {
+    ret = IM_ERR;
+    goto err;
+  }
+
+  if ((ret = jpg_tr_blocks(tj, tr)) != IM_OK)
+    goto err;
+
+  jpg_tr_tables(tj, tr);
+  jpg_tr_write(tj, &w);
+
+  if (w.failed) {
+    free(w.buf);
+    ret = IM_ENOMEM;
+    goto err;
+  }
+
+  *dest     = w.buf;
+  *destSize = w.len;
+
+err:
+  for (k = 0; k < 4; k++)
+    free(tj->coef[k]);
+
+  jpg_dec_coef_free(tj->jpg);
+  free(tj);
+
+  return ret;
+}
@@ -433,14 +433,37 @@ ImResult
 png_dec(ImImage         ** __restrict dest,
         const char       * __restrict path,
         im_open_config_t * __restrict oconfig) {
+  ImFileResult fres;
+  ImResult     ret;
+
+  fres = im_readfile(path, oconfig->openIntent != IM_OPEN_INTENT_READWRITE);
+  if (fres.ret != IM_OK) {
+    *dest = NULL;
+    return fres.ret;
+  }
+
+  /* pixels are inflated into own buffer, file is not needed after decode */
+  ret = png_dec_mem(dest, fres.raw, fres.size, oconfig);
+
+  if (fres.mmap) im_unmap(fres.raw, fres.size);
+  else           free(fres.raw);
+
+  return ret;
+}
+
+IM_HIDE
+ImResult
+png_dec_mem(ImImage         ** __restrict dest,
+            ImByte           * __restrict raw,
+            size_t                        size,
+            im_open_config_t * __restrict oconfig) {
   infl_stream_t  *imdefl;
   ImImage        *im;
   ImByte         *zipped;
-  ImByte         *p, *p_chk, *row, bitdepth, color, compr, interlace;
+  ImByte         *p, *p_chk, *p_end, *row, bitdepth, color, compr, interlace;
   im_png_filter_t filter;
   size_t          len;
   uint32_t        chk_len, chk_type, pal_len, width, height, bpp, bpc;
-  ImFileResult    fres;
   bool            is_cgbi;
 
   is_cgbi   = false;
@@ -449,15 +472,11 @@ png_dec(ImImage         ** __restrict dest,
   zipped    = NULL;
   imdefl    = NULL;
   interlace = 0;
-  fres      = im_readfile(path, oconfig->openIntent != IM_OPEN_INTENT_READWRITE);
+  p         = raw;
+  p_end     = raw + size;
 
-  if (fres.ret != IM_OK) {
+  if (size < 8 || !(im = calloc(1, sizeof(*im))))
     goto err;
-  }
-
-  /* decode, this process will be optimized after decoding is done */
-  im  = calloc(1, sizeof(*im));
-  p   = fres.raw;
 
   /*
    Magic number types:
@@ -476,7 +495,6 @@ png_dec(ImImage         ** __restrict dest,
   p    += 8;
   color = 0;
 
-  im->file           = fres;
   im->openIntent     = oconfig->openIntent;
   im->byteOrder      = oconfig->byteOrder;
   im->ori            = IM_ORIENTATION_UP;
@@ -485,10 +503,17 @@ png_dec(ImImage         ** __restrict dest,
   bitdepth           = 8;
 
   for (;;) {
+    /* length, type and CRC must be in buffer, IEND may be missing */
+    if (p_end - p < 12)
+      goto err;
+
     chk_len  = u32be(&p);
     chk_type = u32be(&p);
     p_chk    = p;
 
+    if ((size_t)(p_end - p) - 4 < chk_len)
+      goto err;
+
     switch (chk_type) {
       case IM_PNG_TYPE('C','g','B','I'):
         is_cgbi = true;
@@ -826,18 +851,16 @@ af:
       goto err;
   }
 
-  if (fres.mmap) { im_unmap(fres.raw, fres.size); }
-
-  im->file = fres;
-  *dest    = im;
+  *dest = im;
 
   infl_destroy(imdefl);
 
   return IM_OK;
 
 err:
-  if (fres.mmap) { im_unmap(fres.raw, fres.size); }
   if (im) {
+    if (im->data.data)    free(im->data.data);
+    if (im->pal)          { free(im->pal->pal); free(im->pal); }
     if (im->transparency) free(im->transparency);
     if (im->iccProfile)   free(im->iccProfile);
     if (im->timeStamp)    free(im->timeStamp);
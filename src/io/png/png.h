@@ -25,4 +25,12 @@ png_dec(ImImage         ** __restrict dest,
         const char       * __restrict path,
         im_open_config_t * __restrict open_config);
 
+/* decodes PNG in memory, image does not point into raw */
+IM_HIDE
+ImResult
+png_dec_mem(ImImage         ** __restrict dest,
+            ImByte           * __restrict raw,
+            size_t                        size,
+            im_open_config_t * __restrict open_config);
+
 #endif /* src_png_h */
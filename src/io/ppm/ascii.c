@@ -0,0 +1,394 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ References:
+ [0] http://netpbm.sourceforge.net/doc/
+ */
+
+#include "ascii.h"
+#include "bin.h"
+
+/*
+ Plain rasters are read 64 bytes at a time: bytes are classified into digit
+ and space bit masks, digit runs are found with bit scans and up to 8 digits
+ are converted with multiply-adds instead of a loop per character:
+
+   d0..d7 -> (d0 * 10 + d1)...  -> (.. * 100 + ..)  -> (.. * 10000 + ..)
+
+ the run is right aligned in a 64-bit lane so leading bytes are zero. Longer
+ runs (leading zeros) use a scalar loop. Block tail after end of data is
+ zero, so the last run ends there like any other.
+ */
+#define PNM_BLOCK 64
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define PNM_SWAR 1
+#else
+#  define PNM_SWAR 0
+#endif
+
+static
+void
+pnm_classify(const ImByte * __restrict p,
+             uint64_t     * __restrict digit,
+             uint64_t     * __restrict space) {
+  uint64_t d, s;
+  uint32_t i;
+
+  d = s = 0;
+
+#if defined(__SSE2__)
+  {
+    __m128i v, c0, c9, t0, t1, sp, m;
+
+    c0 = _mm_set1_epi8('0' - 1);
+    c9 = _mm_set1_epi8('9' + 1);
+    t0 = _mm_set1_epi8('\t' - 1); /* \t \n \v \f \r */
+    t1 = _mm_set1_epi8('\r' + 1);
+    sp = _mm_set1_epi8(' ');
+
+    for (i = 0; i < PNM_BLOCK; i += 16) {
+      v  = _mm_loadu_si128((const __m128i *)(p + i));
+      m  = _mm_and_si128(_mm_cmpgt_epi8(v, c0), _mm_cmplt_epi8(v, c9));
+      d |= (uint64_t)(uint16_t)_mm_movemask_epi8(m) << i;
+      m  = _mm_or_si128(_mm_cmpeq_epi8(v, sp),
+                        _mm_and_si128(_mm_cmpgt_epi8(v, t0),
+                                      _mm_cmplt_epi8(v, t1)));
+      s |= (uint64_t)(uint16_t)_mm_movemask_epi8(m) << i;
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  {
+    static const uint8_t w[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                  1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t v, m, bw;
+
+    bw = vld1q_u8(w);
+
+#define PNM_MOVEMASK(M)                                                     \
+    ((uint64_t)vaddv_u8(vget_low_u8(vandq_u8(M, bw)))                       \
+     | ((uint64_t)vaddv_u8(vget_high_u8(vandq_u8(M, bw))) << 8))
+
+    for (i = 0; i < PNM_BLOCK; i += 16) {
+      v  = vld1q_u8(p + i);
+      m  = vcleq_u8(vsubq_u8(v, vdupq_n_u8('0')), vdupq_n_u8(9));
+      d |= PNM_MOVEMASK(m) << i;
+      m  = vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+                    vcleq_u8(vsubq_u8(v, vdupq_n_u8('\t')), vdupq_n_u8(4)));
+      s |= PNM_MOVEMASK(m) << i;
+    }
+
+#undef PNM_MOVEMASK
+  }
+#else
+  for (i = 0; i < PNM_BLOCK; i++) {
+    d |= (uint64_t)((ImByte)(p[i] - '0') <= 9) << i;
+    s |= (uint64_t)(p[i] == ' ' || (ImByte)(p[i] - '\t') <= 4) << i;
+  }
+#endif
+
+  *digit = d;
+  *space = s;
+}
+
+/* digits with saturation, for runs that don't fit a lane */
+static
+uint32_t
+pnm_digits(const ImByte * __restrict p, const ImByte * __restrict end) {
+  uint64_t v;
+
+  v = 0;
+  while (p < end && (ImByte)(*p - '0') <= 9) {
+    v = v * 10 + (*p++ - '0');
+    if (v > INT32_MAX)
+      v = INT32_MAX;
+  }
+
+  return (uint32_t)v;
+}
+
+#if PNM_SWAR
+/* len (1 - 8) digits end at p, 8 bytes before p are readable */
+IM_INLINE
+uint64_t
+pnm_lane(const ImByte * __restrict p, uint32_t len) {
+  uint64_t v, m;
+
+  memcpy(&v, p - 8, 8);
+  m = ~0ULL << (8 * (8 - len));
+
+  return (v & m) - (0x3030303030303030ULL & m);
+}
+
+IM_INLINE
+uint32_t
+pnm_lane_u32(uint64_t v) {
+  v = v * 10 + (v >> 8);
+  v = ((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))
+       + ((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))) >> 32;
+
+  return (uint32_t)v;
+}
+#endif
+
+IM_INLINE
+uint32_t
+pnm_token(const ImByte * __restrict p, uint32_t len) {
+#if PNM_SWAR
+  if (len <= 8)
+    return pnm_lane_u32(pnm_lane(p + len, len));
+#endif
+  return pnm_digits(p, p + len);
+}
+
+IM_HIDE
+uint32_t
+pnm_ascii_read(const char * __restrict * __restrict src,
+               const char              * __restrict end,
+               uint32_t                * __restrict dst,
+               uint32_t                             count,
+               bool                                 bits) {
+  ImByte      buf[8 + PNM_BLOCK], *blk;
+  const char *p;
+  uint64_t    digit, space, bad, starts, ends;
+  uint32_t    n, lim, avail, s, e, next;
+  bool        partial;
+
+  p   = *src;
+  n   = 0;
+  blk = buf + 8;
+
+  /* lanes may look before first digit of block, it is masked anyway */
+  memset(buf, '0', 8);
+
+  while (n < count && p < end) {
+    avail = end - p < PNM_BLOCK ? (uint32_t)(end - p) : PNM_BLOCK;
+    memcpy(blk, p, avail);
+    if (avail < PNM_BLOCK)
+      memset(blk + avail, 0, PNM_BLOCK - avail);
+
+    pnm_classify(blk, &digit, &space);
+
+    /* anything else ends the block: comment, garbage or end of data */
+    bad     = ~(digit | space);
+    lim     = bad ? im_bitw_ctz64(bad) : PNM_BLOCK;
+    digit   = lim < PNM_BLOCK ? digit & ((1ULL << lim) - 1) : digit;
+    next    = lim;
+    partial = false;
+
+    if (bits) {
+      while (digit && n < count) {
+        s        = im_bitw_ctz64(digit);
+        dst[n++] = blk[s] != '0';
+        digit   &= digit - 1;
+        next     = n == count ? s + 1 : lim;
+      }
+    } else {
+      starts = digit & ~(digit << 1);
+      ends   = ~digit & (digit << 1);
+
+      /* run goes on in next block, start it from there */
+      if (lim == PNM_BLOCK && (digit >> 63)) {
+        s        = ~digit ? 64 - im_bitw_clz64(~digit) : 0;
+        starts  &= ~(1ULL << s);
+        next     = s;
+        partial  = true;
+      }
+
+      e = 0;
+      while (starts && n < count) {
+        s        = im_bitw_ctz64(starts);
+        e        = im_bitw_ctz64(ends);
+        starts  &= starts - 1;
+        ends    &= ends - 1;
+        dst[n++] = pnm_token(blk + s, e - s);
+      }
+
+      if (n == count) {
+        next    = e;
+        partial = false;
+      }
+
+      /* whole block is one run */
+      if (partial && next == 0) {
+        dst[n++] = pnm_digits((const ImByte *)p, (const ImByte *)end);
+        while (p < end && (ImByte)(*p - '0') <= 9)
+          p++;
+        continue;
+      }
+    }
+
+    p += next;
+
+    if (n == count || (avail < PNM_BLOCK && lim >= avail))
+      break;
+
+    if (partial || lim == PNM_BLOCK)
+      continue;
+
+    if (blk[lim] != '#')
+      break;
+
+    /* comment runs to end of line */
+    while (p < end && *p != '\n' && *p != '\r')
+      p++;
+  }
+
+  *src = p;
+  return n;
+}
+
+/* values over maxval are clamped; digits saturate at INT32_MAX */
+static
+void
+pnm_ascii_clamp(void           * __restrict dst,
+                const uint32_t * __restrict src,
+                uint32_t                    count,
+                uint32_t                    bytesPerCompoment) {
+  ImByte   *d8;
+  uint16_t *d16;
+  uint32_t  i, max;
+
+  i   = 0;
+  d8  = dst;
+  d16 = dst;
+  max = bytesPerCompoment == 2 ? 65535 : 255;
+
+#if defined(__SSE2__)
+  {
+    __m128i a, b, bias;
+
+    /* signed packs saturate correctly, values are under 2^31 */
+    if (bytesPerCompoment == 1) {
+      for (; i + 16 <= count; i += 16) {
+        a = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)(src + i)),
+                            _mm_loadu_si128((const __m128i *)(src + i + 4)));
+        b = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)(src + i + 8)),
+                            _mm_loadu_si128((const __m128i *)(src + i + 12)));
+        _mm_storeu_si128((__m128i *)(d8 + i), _mm_packus_epi16(a, b));
+      }
+    } else {
+      /* unsigned 16-bit saturation without SSE4.1 packus_epi32 */
+      bias = _mm_set1_epi32(0x8000);
+      for (; i + 8 <= count; i += 8) {
+        a = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(src + i)), bias);
+        b = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(src + i + 4)),
+                          bias);
+        _mm_storeu_si128((__m128i *)(d16 + i),
+                         _mm_xor_si128(_mm_packs_epi32(a, b),
+                                       _mm_set1_epi16((short)0x8000)));
+      }
+    }
+  }
+#endif
+
+  if (bytesPerCompoment == 1) {
+    for (; i < count; i++)
+      d8[i] = (ImByte)(src[i] < max ? src[i] : max);
+  } else {
+    for (; i < count; i++)
+      d16[i] = (uint16_t)(src[i] < max ? src[i] : max);
+  }
+}
+
+/* 0 - maxval to 0 - 255 / 65535 with rounding, lut has maxval + 1 entries */
+static
+void
+pnm_ascii_scale(void           * __restrict dst,
+                const uint32_t * __restrict src,
+                uint32_t                    count,
+                uint32_t                    maxval,
+                const uint16_t * __restrict lut,
+                uint32_t                    bytesPerCompoment) {
+  ImByte   *d8;
+  uint16_t *d16;
+  uint32_t  i;
+
+  d8  = dst;
+  d16 = dst;
+
+  if (bytesPerCompoment == 1) {
+    for (i = 0; i < count; i++)
+      d8[i] = (ImByte)lut[src[i] < maxval ? src[i] : maxval];
+  } else {
+    for (i = 0; i < count; i++)
+      d16[i] = lut[src[i] < maxval ? src[i] : maxval];
+  }
+}
+
+IM_HIDE
+void
+pnm_ascii_raster(const im_pnm_header_t * __restrict header,
+                 void                  * __restrict dst,
+                 const char            * __restrict p,
+                 const char            * __restrict end,
+                 uint32_t                           count,
+                 bool                               bits,
+                 bool                               big) {
+  uint32_t  vals[PNM_ASCII_CHUNK], n, got, i, bpc, maxval, maxRef;
+  uint16_t *lut;
+  ImByte   *d;
+  bool      swap;
+
+  d      = dst;
+  n      = 0;
+  lut    = NULL;
+  bpc    = bits ? 1 : header->bytesPerCompoment;
+  maxRef = bpc == 2 ? 65535 : 255;
+  maxval = header->maxval ? header->maxval : maxRef;
+
+  /* samples are written in host order, swapped per chunk while in cache */
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  swap   = bpc == 2 && !big;
+#else
+  swap   = bpc == 2 && big;
+#endif
+
+  /* P1 has no maxval, other depths are scaled through a table */
+  if (!bits && maxval != maxRef && maxval <= 65535) {
+    if (!(lut = malloc((maxval + 1) * sizeof(*lut))))
+      goto fill;
+
+    for (i = 0; i <= maxval; i++)
+      lut[i] = (uint16_t)(((uint64_t)i * maxRef + maxval / 2) / maxval);
+  }
+
+  for (n = 0; n < count; n += got) {
+    got = pnm_ascii_read(&p, end, vals,
+                         im_min_i32(count - n, PNM_ASCII_CHUNK), bits);
+    if (!got)
+      break;
+
+    if (bits) {
+      for (i = 0; i < got; i++)
+        d[n + i] = vals[i] ? 0 : 255;
+    } else if (lut) {
+      pnm_ascii_scale(d + (size_t)n * bpc, vals, got, maxval, lut, bpc);
+    } else {
+      pnm_ascii_clamp(d + (size_t)n * bpc, vals, got, bpc);
+    }
+
+    if (swap)
+      pnm_bswap16(d + (size_t)n * 2, d + (size_t)n * 2, got);
+  }
+
+  free(lut);
+
+fill:
+  /* ensure that unhandled pixels are black. */
+  memset(d + (size_t)n * bpc, 0, (size_t)(count - n) * bpc);
+}
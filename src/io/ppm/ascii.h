@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ References:
+ [0] http://netpbm.sourceforge.net/doc/
+ */
+
+#ifndef pnm_ascii_h
+#define pnm_ascii_h
+
+#include "common.h"
+
+/* values are read and scaled in chunks of this many, on stack */
+#define PNM_ASCII_CHUNK 4096
+
+/*
+ Reads up to count plain (P1 - P3) raster values into dst, returns how many
+ are read. Stops at end, at count or at a byte that is not a digit, space or
+ comment; *src is moved past the last value.
+
+ bits: P1, every '0' / '1' is a value even without spaces between them
+ */
+IM_HIDE
+uint32_t
+pnm_ascii_read(const char * __restrict * __restrict src,
+               const char              * __restrict end,
+               uint32_t                * __restrict dst,
+               uint32_t                             count,
+               bool                                 bits);
+
+/*
+ whole plain raster of count values, rest of image is black on short data.
+ bits: P1, 1 is black, output is 0 / 255 bytes
+ big:  16-bit samples are stored big-endian, otherwise little-endian
+ */
+IM_HIDE
+void
+pnm_ascii_raster(const im_pnm_header_t * __restrict header,
+                 void                  * __restrict dst,
+                 const char            * __restrict p,
+                 const char            * __restrict end,
+                 uint32_t                           count,
+                 bool                               bits,
+                 bool                               big);
+
+#endif /* pnm_ascii_h */
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ References:
+ [0] http://netpbm.sourceforge.net/doc/
+ */
+
+#include "bin.h"
+
+IM_HIDE
+void
+pnm_bswap16(ImByte *dst, const ImByte *src, size_t count) {
+  size_t i;
+  ImByte b;
+
+  i = 0;
+
+#if defined(__SSE2__)
+  {
+    __m128i v;
+
+    for (; i + 8 <= count; i += 8) {
+      v = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+      _mm_storeu_si128((__m128i *)(dst + i * 2), v);
+    }
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 8 <= count; i += 8)
+    vst1q_u8(dst + i * 2, vrev16q_u8(vld1q_u8(src + i * 2)));
+#endif
+
+  for (; i < count; i++) {
+    b              = src[i * 2];
+    dst[i * 2]     = src[i * 2 + 1];
+    dst[i * 2 + 1] = b;
+  }
+}
+
+IM_HIDE
+ImResult
+pnm_bin_raster(ImImage    * __restrict im,
+               const char * __restrict p,
+               const char * __restrict end,
+               uint32_t                count,
+               uint32_t                maxval,
+               ImByteOrder             order,
+               bool       * __restrict zcopy) {
+  const ImByte *s;
+  ImByte       *d;
+  uint16_t     *lut, v;
+  size_t        need, avail, n, i;
+  uint32_t      bpc, maxRef;
+  bool          big;
+
+  *zcopy = false;
+
+  if (maxval == 0 || maxval > 65535)
+    return IM_ERR;
+
+  s      = (const ImByte *)p;
+  bpc    = maxval > 255 ? 2 : 1;
+  maxRef = bpc == 2 ? 65535 : 255;
+
+  /* im_init_data() takes a 32-bit size */
+  if ((uint64_t)count * bpc > UINT32_MAX)
+    return IM_ERR;
+
+  need   = (size_t)count * bpc;
+  avail  = p < end ? (size_t)(end - p) : 0;
+  big    = pnm_order_big(order);
+
+  if (bpc == 2)
+    im->byteOrder = big ? IM_BYTEORDER_BIG : IM_BYTEORDER_LITTLE;
+
+  /* same layout as file, 16-bit samples are used in place only aligned */
+  if (avail >= need
+      && (maxval == 255
+          || (maxval == 65535 && big && !((uintptr_t)p & 1)))) {
+    im->data.data = (void *)p;
+    *zcopy        = true;
+    return IM_OK;
+  }
+
+  if (!(im->data.data = im_init_data(im, (uint32_t)need)))
+    return IM_ERR;
+
+  d = im->data.data;
+  n = avail < need ? avail / bpc : count;
+
+  if (maxval == 255 || (maxval == 65535 && big)) {
+    memcpy(d, s, n * bpc);
+  } else if (maxval == 65535) {
+    pnm_bswap16(d, s, n);
+  } else {
+    if (!(lut = malloc((maxval + 1) * sizeof(*lut))))
+      return IM_ERR;
+
+    for (i = 0; i <= maxval; i++)
+      lut[i] = (uint16_t)(((uint64_t)i * maxRef + maxval / 2) / maxval);
+
+    if (bpc == 1) {
+      for (i = 0; i < n; i++)
+        d[i] = (ImByte)lut[s[i] < maxval ? s[i] : maxval];
+    } else {
+      for (i = 0; i < n; i++) {
+        v            = (uint16_t)((s[i * 2] << 8) | s[i * 2 + 1]);
+        v            = lut[v < maxval ? v : maxval];
+        d[i * 2]     = (ImByte)(big ? v >> 8 : v);
+        d[i * 2 + 1] = (ImByte)(big ? v : v >> 8);
+      }
+    }
+
+    free(lut);
+  }
+
+  /* ensure that unhandled pixels are black. */
+  memset(d + n * bpc, 0, need - n * bpc);
+
+  return IM_OK;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ References:
+ [0] http://netpbm.sourceforge.net/doc/
+ */
+
+#ifndef pnm_bin_h
+#define pnm_bin_h
+
+#include "common.h"
+
+/* 16-bit samples are stored big-endian for this order, ANY keeps file order */
+IM_INLINE
+bool
+pnm_order_big(ImByteOrder order) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return order != IM_BYTEORDER_LITTLE;
+#else
+  return order == IM_BYTEORDER_BIG || order == IM_BYTEORDER_ANY;
+#endif
+}
+
+/* swaps bytes of count 16-bit samples, dst may be src */
+IM_HIDE
+void
+pnm_bswap16(ImByte *dst, const ImByte *src, size_t count);
+
+/*
+ P5, P6, P7 raster of count samples, big-endian 16-bit when maxval > 255.
+ Output is 8 or 16-bit in requested byte order (ANY keeps file order), other
+ maxvals are scaled to 255 / 65535. Samples already in output layout are
+ not copied: data points into file and *zcopy is set, file must be kept.
+ Short rasters are completed with black
+ */
+IM_HIDE
+ImResult
+pnm_bin_raster(ImImage    * __restrict im,
+               const char * __restrict p,
+               const char * __restrict end,
+               uint32_t                count,
+               uint32_t                maxval,
+               ImByteOrder             order,
+               bool       * __restrict zcopy);
+
+#endif /* pnm_bin_h */
@@ -30,6 +30,7 @@ typedef struct im_pnm_header_t {
   uint32_t height;
   uint32_t count;
   uint32_t bytesPerCompoment;
+  uint32_t maxval;
   uint32_t maxRef;
   float    pe;
 } im_pnm_header_t;
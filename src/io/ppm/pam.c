@@ -22,6 +22,7 @@
 #include "pam.h"
 #include "pnm.h"
 #include "ppm.h"
+#include "bin.h"
 #include "../../file.h"
 #include "../../str.h"
 
@@ -34,13 +35,11 @@ pam_dec(ImImage         ** __restrict dest,
   char           *p, *end;
   im_pam_header_t header;
   ImFileResult    fres;
+  bool            zcopy;
 
-  char           *pd;
-  int32_t         count, i, R, maxRef, bytesPerCompoment;
-  float           pe;
-
-  im   = NULL;
-  fres = im_readfile(path, open_config->openIntent != IM_OPEN_INTENT_READWRITE);
+  im    = NULL;
+  zcopy = false;
+  fres  = im_readfile(path, open_config->openIntent != IM_OPEN_INTENT_READWRITE);
 
   if (fres.ret != IM_OK) {
     goto err;
@@ -60,46 +59,38 @@ pam_dec(ImImage         ** __restrict dest,
       goto err;
     }
 
-    i                    = 0;
-    count                = header.count;
-    bytesPerCompoment    = header.bytesPerCompoment;
-    pe                   = header.pe;
-    maxRef               = header.maxRef;
-    pd                   = im->data.data;
-
-    if (pe == 1.0f && maxRef == 255) {
-      im_memcpy(pd, p, count * header.depth);
-    } else {
-      count *= header.depth;
-
-      if (bytesPerCompoment == 1) {
-        do {
-          *pd++ = im_min_i32((int)(*p++ * pe), maxRef);
-        } while (--count > 0);
-      } else if (bytesPerCompoment == 2) {
-        do {
-          memcpy(&R, p, 2);  p += 2;
-          pd[i++] = im_min_i32((int)(R * pe), maxRef);
-        } while (--count > 0);
-      }
-    }
+    if (pnm_bin_raster(im, p, end, header.count * header.depth, header.maxval,
+                       open_config->byteOrder, &zcopy) != IM_OK)
+      goto err;
   } else {
     goto err;
   }
 
   *dest = im;
 
+  /* samples may be used in place, im_free() releases both */
+  if (zcopy) {
+    fres.mustfree = !fres.mmap;
+    im->file      = fres;
+    return IM_OK;
+  }
+
   if (fres.mmap) {
     im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
   }
 
   return IM_OK;
 err:
   if (fres.mmap) {
     im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
   }
 
   if (im) {
+    free(im->data.data);
     free(im);
   }
 
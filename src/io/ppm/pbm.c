@@ -21,16 +21,25 @@
 
 #include "pbm.h"
 #include "pnm.h"
+#include "ascii.h"
 #include "../../file.h"
 #include "../../str.h"
+#include "../../color.h"
 
 IM_HIDE
 ImResult
-pbm_dec_ascii(ImImage * __restrict im, char * __restrict p, const char * __restrict end);
+pbm_dec_ascii(ImImage          * __restrict im,
+              char             * __restrict p,
+              const char       * __restrict end,
+              im_open_config_t * __restrict open_config);
 
 IM_HIDE
 ImResult
-pbm_dec_bin(ImImage * __restrict im, char * __restrict p, const char * __restrict end);
+pbm_dec_bin(ImImage          * __restrict im,
+            char             * __restrict p,
+            const char       * __restrict end,
+            im_open_config_t * __restrict open_config,
+            bool             * __restrict zcopy);
 
 IM_HIDE
 ImResult
@@ -40,9 +49,11 @@ pbm_dec(ImImage         ** __restrict dest,
   ImImage      *im;
   char         *p, *end;
   ImFileResult  fres;
+  bool          zcopy;
   
-  im   = NULL;
-  fres = im_readfile(path, open_config->openIntent != IM_OPEN_INTENT_READWRITE);
+  im    = NULL;
+  zcopy = false;
+  fres  = im_readfile(path, open_config->openIntent != IM_OPEN_INTENT_READWRITE);
   
   if (fres.ret != IM_OK) {
     goto err;
@@ -56,30 +67,44 @@ pbm_dec(ImImage         ** __restrict dest,
   /* PBM ASCII */
   if (p[0] == 'P' && p[1] == '1') {
     p += 2;
-    pbm_dec_ascii(im, p, end);
+    if (pbm_dec_ascii(im, p, end, open_config) != IM_OK)
+      goto err;
   }
   
   /* PBM Binary */
   else if (p[0] == 'P' && p[1] == '4') {
     p += 2;
-    pbm_dec_bin(im, p, end);
+    if (pbm_dec_bin(im, p, end, open_config, &zcopy) != IM_OK)
+      goto err;
   } else {
     goto err;
   }
   
   *dest = im;
+
+  /* packed rows may be used in place, im_free() releases both */
+  if (zcopy) {
+    fres.mustfree = !fres.mmap;
+    im->file      = fres;
+    return IM_OK;
+  }
   
   if (fres.mmap) {
     im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
   }
   
   return IM_OK;
 err:
   if (fres.mmap) {
     im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
   }
   
   if (im) {
+    free(im->data.data);
     free(im);
   }
   
@@ -87,41 +112,90 @@ err:
   return IM_ERR;
 }
 
+/* 1 is black; packed rows are (width + 7) / 8 bytes, as in P4 raster */
+static
+void
+pbm_layout(ImImage * __restrict im, ImBitOrder packed) {
+  im->format               = IM_FORMAT_BLACKWHITE;
+  im->monochrome_colors[0] = 255;
+  im->monochrome_colors[1] = 0;
+
+  if (packed) {
+    im->bitOrder         = packed;
+    im->bytesPerPixel    = 0;
+    im->bitsPerComponent = 1;
+    im->bitsPerPixel     = 1;
+    im->rowStride        = (int32_t)((im->width + 7) >> 3);
+    im->len              = (size_t)im->rowStride * im->height;
+  } else {
+    im->bytesPerPixel    = 1;
+    im->bitsPerPixel     = 8;
+    im->rowStride        = (int32_t)im->width;
+  }
+}
+
 IM_HIDE
 ImResult
-pbm_dec_bin(ImImage * __restrict im, char * __restrict p, const char * __restrict end) {
-  im_pnm_header_t header;
-  ImByte         *pd;
-  uint32_t        i, j, k, bitOff, width, height;
-  ImByte          c;
-
-  i                 = bitOff = 0;
-  header            = pnm_dec_header(im, 1, &p, end, false);
-  im->format        = IM_FORMAT_BLACKWHITE;
-  im->bytesPerPixel = header.bytesPerCompoment;
-  im->bitsPerPixel  = im->bytesPerPixel * 8;
-  width             = header.width;
-  height            = header.height;
-  pd                = im->data.data;
-  c                 = *p;
-  
-  /* parse raster */
-  
-  for (j = 0; j < height; j++) {
-    for (k = 0; k < width; k++) {
-      pd[i++] = (!(c >> 7)) * 255;
-      c     <<= 1;
-
-      if (++bitOff > 7) {
-        bitOff = 0;
-        c      = *++p;
-      }
-    }
+pbm_dec_bin(ImImage          * __restrict im,
+            char             * __restrict p,
+            const char       * __restrict end,
+            im_open_config_t * __restrict open_config,
+            bool             * __restrict zcopy) {
+  ImByte     *pd, *row;
+  size_t      rowb, need, avail, n;
+  uint32_t    y, width, height;
+  ImBitOrder  packed;
 
-    if (bitOff != 0) {
-      c      = *++p;
-      bitOff = 0;
-    }
+  pnm_dec_header(im, 1, &p, end, false);
+
+  packed = (ImBitOrder)open_config->packedBits;
+  width  = im->width;
+  height = im->height;
+  rowb   = (width + 7) >> 3;
+  need   = rowb * height;
+  avail  = p < end ? (size_t)(end - p) : 0;
+  *zcopy = false;
+
+  pbm_layout(im, packed);
+
+  /* raster is already in output layout */
+  if (packed == IM_BITORDER_MSB && avail >= need) {
+    im->data.data = p;
+    *zcopy        = true;
+    return IM_OK;
+  }
+
+  if (!(pd = im->data.data = im_init_data(im, (uint32_t)im->len)))
+    return IM_ERR;
+
+  /* short rasters are completed with white, as a zero bit */
+  n = avail < need ? avail : need;
+
+  if (packed) {
+    if (packed == IM_BITORDER_LSB)
+      im_bits_reverse((ImByte *)p, pd, n);
+    else
+      memcpy(pd, p, n);
+
+    memset(pd + n, 0, need - n);
+    return IM_OK;
+  }
+
+  for (y = 0; y < height && (y + 1) * rowb <= n; y++)
+    im_bits_expand((ImByte *)p + y * rowb, pd + (size_t)y * width, width,
+                   im->monochrome_colors);
+
+  if (y < height) {
+    if (!(row = calloc(1, rowb)))
+      return IM_ERR;
+
+    memcpy(row, p + y * rowb, n - y * rowb);
+    im_bits_expand(row, pd + (size_t)y * width, width, im->monochrome_colors);
+    free(row);
+
+    y++;
+    memset(pd + (size_t)y * width, im->monochrome_colors[0],
+           (size_t)(height - y) * width);
   }
 
   return IM_OK;
@@ -129,32 +203,48 @@ pbm_dec_bin(ImImage * __restrict im, char * __restrict p, const char * __restric
 
 IM_HIDE
 ImResult
-pbm_dec_ascii(ImImage * __restrict im, char * __restrict p, const char * __restrict end) {
+pbm_dec_ascii(ImImage          * __restrict im,
+              char             * __restrict p,
+              const char       * __restrict end,
+              im_open_config_t * __restrict open_config) {
   im_pnm_header_t header;
-  char           *pd;
-  uint32_t        count, i;
-  char            c;
-
-  i                 = 0;
-  header            = pnm_dec_header(im, 1, &p, end, false);
-  count             = header.count;
-  im->format        = IM_FORMAT_BLACKWHITE;
-  im->bytesPerPixel = header.bytesPerCompoment;
-  im->bitsPerPixel  = im->bytesPerPixel * 8;
-  pd                = im->data.data;
-  c                 = *p;
-
-  /* parse raster */
-  do {
-    /* skip spaces */
-    while (IM_ALLSPACES) { c = *++p; }
-
-    pd[i++] = (!(*p - '0')) * 255;
-  } while (p && p[0] != '\0' && (c = *++p) != '\0' && (--count) > 0);
-  
-  /* ensure that unhandled pixels are black. */
-  for (; i < count; i++) {
-    pd[i] = 0;
+  ImByte         *pd, *s, *d;
+  uint32_t        x, y, width, height, rowb;
+  ImBitOrder      packed;
+  ImByte          b;
+
+  header = pnm_dec_header(im, 1, &p, end, false);
+  packed = (ImBitOrder)open_config->packedBits;
+  width  = header.width;
+  height = header.height;
+
+  if (!(pd = im->data.data = im_init_data(im, (uint32_t)im->len)))
+    return IM_ERR;
+
+  /* parse raster, digits need no spaces between them */
+  pnm_ascii_raster(&header, pd, p, end, header.count, true, false);
+  pbm_layout(im, packed);
+
+  if (!packed)
+    return IM_OK;
+
+  /* pack in place, a packed row never passes its source row */
+  rowb = (width + 7) >> 3;
+  for (y = 0; y < height; y++) {
+    s = pd + (size_t)y * width;
+    d = pd + (size_t)y * rowb;
+
+    for (x = 0, b = 0; x < width; x++) {
+      if (packed == IM_BITORDER_LSB)
+        b |= (ImByte)((s[x] == 0) << (x & 7));
+      else
+        b |= (ImByte)((s[x] == 0) << (7 - (x & 7)));
+
+      if ((x & 7) == 7 || x == width - 1) {
+        d[x >> 3] = b;
+        b         = 0;
+      }
+    }
   }
 
   return IM_OK;
@@ -21,16 +21,25 @@
 
 #include "pgm.h"
 #include "pnm.h"
+#include "ascii.h"
+#include "bin.h"
 #include "../../file.h"
 #include "../../str.h"
 
 IM_HIDE
 ImResult
-pgm_dec_ascii(ImImage * __restrict im, char * __restrict p, const char * __restrict end);
+pgm_dec_ascii(ImImage          * __restrict im,
+              char             * __restrict p,
+              const char       * __restrict end,
+              im_open_config_t * __restrict open_config);
 
 IM_HIDE
 ImResult
-pgm_dec_bin(ImImage * __restrict im, char * __restrict p, const char * __restrict end);
+pgm_dec_bin(ImImage          * __restrict im,
+            char             * __restrict p,
+            const char       * __restrict end,
+            im_open_config_t * __restrict open_config,
+            bool             * __restrict zcopy);
 
 IM_HIDE
 ImResult
@@ -40,9 +49,11 @@ pgm_dec(ImImage         ** __restrict dest,
   ImImage      *im;
   char         *p, *end;
   ImFileResult  fres;
+  bool          zcopy;
   
-  im   = NULL;
-  fres = im_readfile(path, open_config->openIntent != IM_OPEN_INTENT_READWRITE);
+  im    = NULL;
+  zcopy = false;
+  fres  = im_readfile(path, open_config->openIntent != IM_OPEN_INTENT_READWRITE);
   
   if (fres.ret != IM_OK) {
     goto err;
@@ -56,30 +67,44 @@ pgm_dec(ImImage         ** __restrict dest,
   /* PGM ASCII */
   if (p[0] == 'P' && p[1] == '2') {
     p += 2;
-    pgm_dec_ascii(im, p, end);
+    if (pgm_dec_ascii(im, p, end, open_config) != IM_OK)
+      goto err;
   }
   
   /* PGM Binary */
   else if (p[0] == 'P' && p[1] == '5') {
     p += 2;
-    pgm_dec_bin(im, p, end);
+    if (pgm_dec_bin(im, p, end, open_config, &zcopy) != IM_OK)
+      goto err;
   } else {
     goto err;
   }
   
   *dest = im;
+
+  /* samples may be used in place, im_free() releases both */
+  if (zcopy) {
+    fres.mustfree = !fres.mmap;
+    im->file      = fres;
+    return IM_OK;
+  }
   
   if (fres.mmap) {
     im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
   }
   
   return IM_OK;
 err:
   if (fres.mmap) {
     im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
   }
   
   if (im) {
+    free(im->data.data);
     free(im);
   }
   
@@ -89,68 +114,45 @@ err:
 
 IM_HIDE
 ImResult
-pgm_dec_bin(ImImage * __restrict im, char * __restrict p, const char * __restrict end) {
+pgm_dec_bin(ImImage          * __restrict im,
+            char             * __restrict p,
+            const char       * __restrict end,
+            im_open_config_t * __restrict open_config,
+            bool             * __restrict zcopy) {
   im_pnm_header_t header;
-  char           *pd;
-  int32_t         count, i, maxRef, bytesPerCompoment, tmp;
-  float           pe;
 
-  i                 = 0;
   header            = pnm_dec_header(im, 1, &p, end, true);
-  count             = header.count;
-  bytesPerCompoment = header.bytesPerCompoment;
   im->format        = IM_FORMAT_GRAY;
   im->bytesPerPixel = header.bytesPerCompoment;
   im->bitsPerPixel  = im->bytesPerPixel * 8;
-  pd                = im->data.data;
-  pe                = header.pe;
-  maxRef            = header.maxRef;
-  
-  if (bytesPerCompoment == 1) {
-    if (pe == 1.0f && maxRef == 255) {
-      im_memcpy(pd, p, count);
-    } else {
-      do {
-        pd[i++] = im_min_i32((uint32_t)(*p++ * pe), maxRef);
-      } while (--count > 0);
-    }
-  } else if (bytesPerCompoment == 2) {
-    do {
-      memcpy(&tmp, p, 2);
-      p      += 2;
-      pd[i++] = im_min_i32((uint32_t)(tmp * pe), maxRef);
-    } while (--count > 0);
-  }
 
-  return IM_OK;
+  return pnm_bin_raster(im, p, end, header.count, header.maxval,
+                        open_config->byteOrder, zcopy);
 }
 
 IM_HIDE
 ImResult
-pgm_dec_ascii(ImImage * __restrict im, char * __restrict p, const char * __restrict end) {
+pgm_dec_ascii(ImImage          * __restrict im,
+              char             * __restrict p,
+              const char       * __restrict end,
+              im_open_config_t * __restrict open_config) {
   im_pnm_header_t header;
-  char           *pd;
-  int32_t         count, i, maxRef;
-  float           pe;
+  bool            big;
 
-  i                 = 0;
   header            = pnm_dec_header(im, 1, &p, end, true);
-  count             = header.count;
+  big               = pnm_order_big(open_config->byteOrder);
   im->format        = IM_FORMAT_GRAY;
   im->bytesPerPixel = header.bytesPerCompoment;
   im->bitsPerPixel  = im->bytesPerPixel * 8;
-  pd                = im->data.data;
-  pe                = header.pe;
-  maxRef            = header.maxRef;
 
-  do {
-    pd[i++] = im_min_i32((uint32_t)(im_getu8_skipspaces(&p, end) * pe), maxRef);
-  } while (p && p[0] != '\0' && *++p != '\0' && (--count) > 0);
+  /* same 16-bit layout as binary rasters, see pnm_bin_raster() */
+  if (header.bytesPerCompoment == 2)
+    im->byteOrder = big ? IM_BYTEORDER_BIG : IM_BYTEORDER_LITTLE;
 
-  /* ensure that unhandled pixels are black. */
-  for (; i < count; i++) {
-    pd[i] = 0;
-  }
+  if (!(im->data.data = im_init_data(im, (uint32_t)im->len)))
+    return IM_ERR;
+
+  pnm_ascii_raster(&header, im->data.data, p, end, header.count, false, big);
 
   return IM_OK;
 }
@@ -37,6 +37,15 @@ im_skip_spaces_and_comments(char * __restrict p, const char * __restrict end) {
   return p;
 }
 
+IM_INLINE
+char*
+pnm_skip_one_space(char * __restrict p, const char * __restrict end) {
+  char c;
+
+  c = p < end ? *p : '\0';
+  return IM_ALLSPACES ? p + 1 : p;
+}
+
 IM_HIDE
 im_pnm_header_t
 pnm_dec_header(ImImage                 * __restrict im,
@@ -73,7 +82,6 @@ pnm_dec_header(ImImage                 * __restrict im,
   bytesPerPixel        = header.bytesPerCompoment * ncomponents;
   header.count         = width * height;
   imlen                = header.count * bytesPerPixel;
-  im->data.data        = im_init_data(im, imlen); /* malloc(imlen); */
   im->format           = IM_FORMAT_GRAY;
   im->len              = imlen;
   im->width            = width;
@@ -83,6 +91,7 @@ pnm_dec_header(ImImage                 * __restrict im,
 
   header.width         = width;
   header.height        = height;
+  header.maxval        = maxval;
 
   if (header.maxRef != maxval) {
     header.pe = ((float)header.maxRef) / ((float)maxval);
@@ -90,7 +99,8 @@ pnm_dec_header(ImImage                 * __restrict im,
     header.pe = 1.0f;
   }
 
-  *start            = im_skip_spaces_and_comments(p, end);
+  /* plain rasters skip spaces themselves, binary ones start after one */
+  *start            = pnm_skip_one_space(p, end);
 
   return header;
 }
@@ -164,6 +174,7 @@ pam_dec_header(ImImage                 * __restrict im,
   maxval            = depth = width = height = 0;
   foundENDHDR       = false;
   header.tupltype   = PAM_TUPLE_TYPE_UNKNOWN;
+  header.failed     = false;
   
   do {
     p = im_skip_spaces_and_comments(p, end);
@@ -236,10 +247,6 @@ pam_dec_header(ImImage                 * __restrict im,
                  && p[7]  == 'L'
                  && p[8]  == 'E') {
         header.tupltype = PAM_TUPLE_TYPE_GRAYSCALE;
-      } else if (   p[0]  == 'R'
-                 && p[1]  == 'G'
-                 && p[2]  == 'B') {
-        header.tupltype = PAM_TUPLE_TYPE_RGB;
       } else if (   p[0]  == 'R'
                  && p[1]  == 'G'
                  && p[2]  == 'B'
@@ -250,6 +257,10 @@ pam_dec_header(ImImage                 * __restrict im,
                  && p[7]  == 'H'
                  && p[8]  == 'A') {
         header.tupltype = PAM_TUPLE_TYPE_RGB_ALPHA;
+      } else if (   p[0]  == 'R'
+                 && p[1]  == 'G'
+                 && p[2]  == 'B') {
+        header.tupltype = PAM_TUPLE_TYPE_RGB;
       }
       NEXT_LINE
     } else if (   p[0] == 'E'
@@ -292,14 +303,13 @@ pam_dec_header(ImImage                 * __restrict im,
   bytesPerPixel        = header.bytesPerCompoment * depth;
   header.count         = width * height;
   imlen                = header.count * bytesPerPixel;
-  im->data.data        = im_init_data(im, imlen); /* malloc(imlen); */
   im->format           = IM_FORMAT_GRAY;
   im->len              = imlen;
   im->width            = width;
   im->height           = height;
   im->bytesPerPixel    = bytesPerPixel;
   im->bitsPerPixel     = bytesPerPixel * 8;
-  im->bitsPerComponent = 8;
+  im->bitsPerComponent = header.bytesPerCompoment * 8;
 
   switch (header.tupltype) {
     case PAM_TUPLE_TYPE_BLACKANDWHITE: im->format = IM_FORMAT_BLACKWHITE; break;
@@ -325,6 +335,7 @@ pam_dec_header(ImImage                 * __restrict im,
 
   header.width      = width;
   header.height     = height;
+  header.depth      = depth;
   
   if (header.maxRef != maxval) {
     header.pe = ((float)header.maxRef) / ((float)maxval);
@@ -332,7 +343,7 @@ pam_dec_header(ImImage                 * __restrict im,
     header.pe = 1.0f;
   }
   
-  *start = im_skip_spaces_and_comments(p, end);
+  *start = pnm_skip_one_space(p, end);
 
   return header;
 
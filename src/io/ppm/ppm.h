@@ -32,6 +32,10 @@ ppm_dec(ImImage         ** __restrict dest,
 
 IM_HIDE
 ImResult
-ppm_dec_bin(ImImage * __restrict im, char * __restrict p, const char * __restrict end);
+ppm_dec_bin(ImImage          * __restrict im,
+            char             * __restrict p,
+            const char       * __restrict end,
+            im_open_config_t * __restrict open_config,
+            bool             * __restrict zcopy);
 
 #endif /* ppm_h */
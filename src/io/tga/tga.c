@@ -54,6 +54,7 @@ tga_dec(ImImage         ** __restrict dest,
   uint8_t            *p, *id;
   ImFileResult        fres;
   uint16_t            pal_first_idx, pal_len, pos_x, pos_y, width, height;
+  uint32_t            rowst;
   uint8_t             idlen, cmap_type, imtype, pal_entry_size, depth, imdesc, ncomp;
   bool                safemem, usemmap;
 
@@ -111,19 +112,19 @@ tga_dec(ImImage         ** __restrict dest,
     
     memcpy(pal->pal, p, pal->len);
 
-    p += pal_len;
+    p += pal->len;
   }
 
-  im->data.data = malloc(width * height * depth);
   im->width     = width;
   im->height    = height;
 
-  switch ((imdesc >> 3) & 0x1) {
+  /* image descriptor: bit 4 right-to-left, bit 5 top-to-bottom */
+  switch ((imdesc >> 4) & 0x1) {
     case 0x0: im->ori = IM_ORIENTATION_LEFT;  break;
     case 0x1: im->ori = IM_ORIENTATION_RIGHT; break;
   }
 
-  switch ((imdesc >> 4) & 0x1) {
+  switch ((imdesc >> 5) & 0x1) {
     case 0x0: im->ori |= IM_ORIENTATION_DOWN; break;
     case 0x1: im->ori |= IM_ORIENTATION_UP;   break;
   }
@@ -135,6 +136,13 @@ tga_dec(ImImage         ** __restrict dest,
   im->bytesPerPixel      = ncomp;
   im->alphaInfo          = IM_ALPHA_NONE; /* TODO: check alpha bits */
 
+  rowst         = (uint32_t)width * ncomp;
+  im->len       = (size_t)rowst * height;
+  im->rowStride = (int32_t)rowst;
+
+  if ((size_t)(p - (uint8_t *)fres.raw) + im->len > fres.size)
+    goto err;
+
   if (likely(open_config->bgr2rgb)) {
     im->data.data = p;
     rgb8_to_bgr8_all(p, width * height);
@@ -142,8 +150,16 @@ tga_dec(ImImage         ** __restrict dest,
     im->data.data = p;
   }
 
-  *dest = im;
-  im->file = fres;
+  /* bottom-up view of file, starts at last row */
+  if (open_config->topDown && (im->ori & IM_ORIENTATION_DOWN) && height) {
+    im->data.data  = p + (size_t)rowst * (height - 1);
+    im->rowStride  = -(int32_t)rowst;
+    im->ori       &= ~IM_ORIENTATION_DOWN;
+  }
+
+  fres.mustfree = !fres.mmap;
+  *dest         = im;
+  im->file      = fres;
 
   if (open_config->releaseFile && fres.mmap) {
     im_unmap(fres.raw, fres.size);
@@ -153,9 +169,15 @@ tga_dec(ImImage         ** __restrict dest,
 err:
   if (fres.mmap) {
     im_unmap(fres.raw, fres.size);
+  } else {
+    free(fres.raw);
   }
 
   if (im) {
+    if (im->pal) {
+      free(im->pal->pal);
+      free(im->pal);
+    }
     free(im);
   }
 
@@ -15,6 +15,7 @@
  */
 
 #include "thread.h"
+#include <unistd.h>
 
 typedef struct th_thread_entry {
   void *arg;
@@ -74,6 +75,15 @@ thread_exit(void) {
   pthread_exit(NULL);
 }
 
+TH_HIDE
+uint32_t
+thread_ncpu(void) {
+  long n;
+
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (uint32_t)n : 1;
+}
+
 TH_HIDE
 void
 thread_cond_init(th_thread_cond *cond) {
@@ -53,6 +53,11 @@ TH_HIDE
 void
 thread_exit(void);
 
+/* number of online logical processors, at least 1 */
+TH_HIDE
+uint32_t
+thread_ncpu(void);
+
 TH_HIDE
 void
 thread_cond_init(th_thread_cond *cond);
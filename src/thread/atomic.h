@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef src_thread_atomic_h
+#define src_thread_atomic_h
+
+#include "common.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#  include <intrin.h>
+
+/* Interlocked* functions are full barriers, so all variants are seq_cst */
+typedef volatile long th_atomic_u32;
+
+static TH_INLINE
+uint32_t
+th_atomic_load(th_atomic_u32 *a) {
+  return (uint32_t)_InterlockedOr(a, 0);
+}
+
+static TH_INLINE
+void
+th_atomic_store(th_atomic_u32 *a, uint32_t val) {
+  _InterlockedExchange(a, (long)val);
+}
+
+#  define th_atomic_load_acq(a)       th_atomic_load(a)
+#  define th_atomic_store_rel(a, val) th_atomic_store(a, val)
+#else
+#  include <stdatomic.h>
+
+typedef _Atomic uint32_t th_atomic_u32;
+
+static TH_INLINE
+uint32_t
+th_atomic_load(th_atomic_u32 *a) {
+  return atomic_load_explicit(a, memory_order_seq_cst);
+}
+
+static TH_INLINE
+void
+th_atomic_store(th_atomic_u32 *a, uint32_t val) {
+  atomic_store_explicit(a, val, memory_order_seq_cst);
+}
+
+static TH_INLINE
+uint32_t
+th_atomic_load_acq(th_atomic_u32 *a) {
+  return atomic_load_explicit(a, memory_order_acquire);
+}
+
+static TH_INLINE
+void
+th_atomic_store_rel(th_atomic_u32 *a, uint32_t val) {
+  atomic_store_explicit(a, val, memory_order_release);
+}
+#endif
+
+/* cpu hint for spin-wait loops */
+static TH_INLINE
+void
+thread_pause(void) {
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+  _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__("pause");
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+#endif /* src_thread_atomic_h */
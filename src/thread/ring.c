@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ring.h"
+
+/* spin rounds before parking, each round pauses 2^round times (capped) */
+#define TH_RING_SPIN_ROUNDS 16
+#define TH_RING_SPIN_SHIFT  6
+
+static
+bool
+ring_can_write(th_ring *ring) {
+  return th_atomic_load(&ring->tail) - th_atomic_load(&ring->head) < ring->depth;
+}
+
+static
+bool
+ring_can_read(th_ring *ring) {
+  return th_atomic_load(&ring->tail) != th_atomic_load(&ring->head)
+         || th_atomic_load(&ring->closed);
+}
+
+static
+bool
+ring_empty(th_ring *ring) {
+  return th_atomic_load(&ring->tail) == th_atomic_load(&ring->head);
+}
+
+static
+void
+ring_wait(th_ring        *ring,
+          bool          (*ready)(th_ring *),
+          th_atomic_u32  *parked,
+          th_thread_cond *cond) {
+  uint32_t round, i;
+
+  for (round = 0; round < TH_RING_SPIN_ROUNDS; round++) {
+    if (ready(ring))
+      return;
+
+    for (i = 0; i < (1u << (round < TH_RING_SPIN_SHIFT ? round : TH_RING_SPIN_SHIFT)); i++)
+      thread_pause();
+  }
+
+  /* park: flag must be visible before re-checking, see ring_wake() */
+  thread_lock(&ring->mutex);
+  th_atomic_store(parked, 1);
+
+  while (!ready(ring))
+    thread_cond_wait(cond, &ring->mutex);
+
+  th_atomic_store(parked, 0);
+  thread_unlock(&ring->mutex);
+}
+
+static
+void
+ring_wake(th_ring        *ring,
+          th_atomic_u32  *parked,
+          th_thread_cond *cond) {
+  if (!th_atomic_load(parked))
+    return;
+
+  thread_lock(&ring->mutex);
+  thread_cond_signal(cond);
+  thread_unlock(&ring->mutex);
+}
+
+TH_HIDE
+void
+thread_ring_init(th_ring *ring, uint32_t depth) {
+  memset(ring, 0, sizeof(*ring));
+
+  ring->depth = depth < 2 ? 2 : depth;
+
+  thread_mutex_init(&ring->mutex);
+  thread_cond_init(&ring->rcond);
+  thread_cond_init(&ring->wcond);
+}
+
+TH_HIDE
+void
+thread_ring_destroy(th_ring *ring) {
+  thread_cond_destroy(&ring->rcond);
+  thread_cond_destroy(&ring->wcond);
+  thread_mutex_destroy(&ring->mutex);
+}
+
+TH_HIDE
+uint32_t
+thread_ring_write_begin(th_ring *ring) {
+  if (!ring_can_write(ring))
+    ring_wait(ring, ring_can_write, &ring->wparked, &ring->wcond);
+
+  return th_atomic_load_acq(&ring->tail) % ring->depth;
+}
+
+TH_HIDE
+void
+thread_ring_write_end(th_ring *ring) {
+  th_atomic_store(&ring->tail, th_atomic_load_acq(&ring->tail) + 1);
+  ring_wake(ring, &ring->rparked, &ring->rcond);
+}
+
+TH_HIDE
+int32_t
+thread_ring_read_begin(th_ring *ring) {
+  uint32_t head;
+
+  if (!ring_can_read(ring))
+    ring_wait(ring, ring_can_read, &ring->rparked, &ring->rcond);
+
+  /* closed and drained; tail is published before closed */
+  head = th_atomic_load_acq(&ring->head);
+  if (th_atomic_load_acq(&ring->tail) == head)
+    return -1;
+
+  return (int32_t)(head % ring->depth);
+}
+
+TH_HIDE
+void
+thread_ring_read_end(th_ring *ring) {
+  th_atomic_store(&ring->head, th_atomic_load_acq(&ring->head) + 1);
+  ring_wake(ring, &ring->wparked, &ring->wcond);
+}
+
+TH_HIDE
+void
+thread_ring_flush(th_ring *ring) {
+  if (!ring_empty(ring))
+    ring_wait(ring, ring_empty, &ring->wparked, &ring->wcond);
+}
+
+TH_HIDE
+void
+thread_ring_close(th_ring *ring) {
+  th_atomic_store(&ring->closed, 1);
+
+  thread_lock(&ring->mutex);
+  thread_cond_signal(&ring->rcond);
+  thread_unlock(&ring->mutex);
+}
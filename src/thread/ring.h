@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 Recep Aslantas
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef src_thread_ring_h
+#define src_thread_ring_h
+
+#include "thread.h"
+#include "atomic.h"
+
+/*
+ Single-producer / single-consumer ring of slot indices. Slot storage is owned
+ by the caller, the ring only hands out which slot may be written or read.
+
+ Both sides spin with backoff for a short while, then park on their own
+ condition variable. The other side only takes the lock to wake a parked peer,
+ so the common path does not touch the mutex at all.
+ */
+typedef struct th_ring {
+  TH_ALIGN(64) th_atomic_u32 head;    /* next slot to read,  consumer owned */
+  TH_ALIGN(64) th_atomic_u32 tail;    /* next slot to write, producer owned */
+  TH_ALIGN(64) th_atomic_u32 rparked; /* consumer waits on rcond            */
+  th_atomic_u32              wparked; /* producer waits on wcond            */
+  th_atomic_u32              closed;
+  uint32_t                   depth;
+  th_thread_mutex            mutex;
+  th_thread_cond             rcond;
+  th_thread_cond             wcond;
+} th_ring;
+
+TH_HIDE
+void
+thread_ring_init(th_ring *ring, uint32_t depth);
+
+TH_HIDE
+void
+thread_ring_destroy(th_ring *ring);
+
+/* returns slot index to fill, blocks while ring is full */
+TH_HIDE
+uint32_t
+thread_ring_write_begin(th_ring *ring);
+
+TH_HIDE
+void
+thread_ring_write_end(th_ring *ring);
+
+/* returns slot index to consume or -1 if ring is closed and drained */
+TH_HIDE
+int32_t
+thread_ring_read_begin(th_ring *ring);
+
+TH_HIDE
+void
+thread_ring_read_end(th_ring *ring);
+
+/* blocks until consumer has released every written slot */
+TH_HIDE
+void
+thread_ring_flush(th_ring *ring);
+
+/* no more writes, wakes up the consumer */
+TH_HIDE
+void
+thread_ring_close(th_ring *ring);
+
+#endif /* src_thread_ring_h */
@@ -77,6 +77,15 @@ thread_exit(void) {
   TerminateThread(GetCurrentThread(), 0);
 }
 
+TH_HIDE
+uint32_t
+thread_ncpu(void) {
+  SYSTEM_INFO info;
+
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
 TH_HIDE
 void
 thread_cond_init(th_thread_cond *cond) {